@@ -8,6 +8,7 @@
 #include <reshade.hpp>
 #include "config.hpp"
 #include "crc32_hash.hpp"
+#include "pixel_conversion.hpp"
 #include <vector>
 #include <filesystem>
 #include <stb_image_write.h>
@@ -123,6 +124,8 @@ bool save_texture_image(const resource_desc &desc, const subresource_data &data)
 	uint8_t *data_p = static_cast<uint8_t *>(data.data);
 	// Add sufficient padding for block compressed textures that are not a multiple of 4 in all dimensions
 	std::vector<uint8_t> rgba_pixel_data((block_count_x * 4) * (block_count_y * 4) * 4);
+	// Number of channels in the pixel data, which is only less than four for formats without alpha channel that were packed to RGB
+	int comp = 4;
 
 	switch (desc.texture.format)
 	{
@@ -208,43 +211,31 @@ bool save_texture_image(const resource_desc &desc, const subresource_data &data)
 	case format::r8g8b8a8_typeless:
 	case format::r8g8b8a8_unorm:
 	case format::r8g8b8a8_unorm_srgb:
-	case format::r8g8b8x8_unorm:
-	case format::r8g8b8x8_unorm_srgb:
-		for (size_t y = 0; y < desc.texture.height; ++y, data_p += data.row_pitch)
-		{
-			for (size_t x = 0; x < desc.texture.width; ++x)
-			{
-				const uint8_t *const src = data_p + x * 4;
-				uint8_t *const dst = rgba_pixel_data.data() + (y * desc.texture.width + x) * 4;
-
-				dst[0] = src[0];
-				dst[1] = src[1];
-				dst[2] = src[2];
-				dst[3] = src[3];
-			}
-		}
-		break;
 	case format::b8g8r8a8_typeless:
 	case format::b8g8r8a8_unorm:
 	case format::b8g8r8a8_unorm_srgb:
+	{
+		// Swaps red and blue channel for BGRA formats
+		const reshade::utils::convert_row_func convert_row = reshade::utils::find_convert_row_to_rgba8(format_to_default_typed(desc.texture.format, 0));
+
+		for (size_t y = 0; y < desc.texture.height; ++y, data_p += data.row_pitch)
+			convert_row(data_p, rgba_pixel_data.data() + y * desc.texture.width * 4, desc.texture.width);
+		break;
+	}
+	case format::r8g8b8x8_unorm:
+	case format::r8g8b8x8_unorm_srgb:
 	case format::b8g8r8x8_typeless:
 	case format::b8g8r8x8_unorm:
 	case format::b8g8r8x8_unorm_srgb:
-		for (size_t y = 0; y < desc.texture.height; ++y, data_p += data.row_pitch)
-		{
-			for (size_t x = 0; x < desc.texture.width; ++x)
-			{
-				const uint8_t *const src = data_p + x * 4;
-				uint8_t *const dst = rgba_pixel_data.data() + (y * desc.texture.width + x) * 4;
+	{
+		// The fourth channel of these formats is unused, so pack them to RGB (swapping red and blue channel for BGRX formats)
+		const reshade::utils::convert_row_func pack_row = reshade::utils::find_pack_row_to_rgb8(format_to_default_typed(desc.texture.format, 0));
 
-				// Swap red and blue channel
-				dst[0] = src[2];
-				dst[1] = src[1];
-				dst[2] = src[0];
-				dst[3] = src[3];
-			}
-		}
+		comp = 3;
+		for (size_t y = 0; y < desc.texture.height; ++y, data_p += data.row_pitch)
+			pack_row(data_p, rgba_pixel_data.data() + y * desc.texture.width * 3, desc.texture.width);
 		break;
+	}
 	case format::bc1_typeless:
 	case format::bc1_unorm:
 	case format::bc1_unorm_srgb:
@@ -422,9 +413,9 @@ bool save_texture_image(const resource_desc &desc, const subresource_data &data)
 	dump_path += RESHADE_ADDON_TEXTURE_SAVE_FORMAT;
 
 	if (dump_path.extension() == L".bmp")
-		return stbi_write_bmp(dump_path.u8string().c_str(), desc.texture.width, desc.texture.height, 4, rgba_pixel_data.data()) != 0;
+		return stbi_write_bmp(dump_path.u8string().c_str(), desc.texture.width, desc.texture.height, comp, rgba_pixel_data.data()) != 0;
 	else if (dump_path.extension() == L".png")
-		return stbi_write_png(dump_path.u8string().c_str(), desc.texture.width, desc.texture.height, 4, rgba_pixel_data.data(), desc.texture.width * 4) != 0;
+		return stbi_write_png(dump_path.u8string().c_str(), desc.texture.width, desc.texture.height, comp, rgba_pixel_data.data(), desc.texture.width * comp) != 0;
 	else
 		return false;
 }
@@ -799,5 +799,25 @@ namespace reshade { namespace api
 		/// </summary>
 		/// <param name="variable">Opaque handle to the uniform variable.</param>
 		virtual void reset_uniform_value(effect_uniform_variable variable) = 0;
+
+		/// <summary>
+		/// Gets the average time it took to render a pass of a <paramref name="technique"/> over the last frames, in nanoseconds.
+		/// GPU timings are only gathered for a while after this was called, so they are zero until queried for a few frames.
+		/// </summary>
+		/// <param name="technique">Opaque handle to the technique.</param>
+		/// <param name="pass_index">Index of the pass in the technique, or <c>SIZE_MAX</c> to get the timings of the entire technique.</param>
+		/// <param name="out_cpu_duration">Optional pointer to a variable that is set to the average CPU time spent recording the pass.</param>
+		/// <param name="out_gpu_duration">Optional pointer to a variable that is set to the average GPU time spent executing the draw or dispatch of the pass.</param>
+		/// <param name="out_gpu_transition_duration">Optional pointer to a variable that is set to the average GPU time spent on copies, barriers and mipmap generation before the pass (or after the last pass for the entire technique).</param>
+		/// <returns><see langword="true"/> if the technique has a pass at the specified index, <see langword="false"/> otherwise.</returns>
+		virtual bool get_technique_pass_timings(effect_technique technique, size_t pass_index, uint64_t *out_cpu_duration, uint64_t *out_gpu_duration, uint64_t *out_gpu_transition_duration = nullptr) = 0;
+
+		/// <summary>
+		/// Records the CPU and GPU timings of all techniques and passes over the next frames and saves them to a file.
+		/// </summary>
+		/// <param name="frame_count">Number of frames to capture.</param>
+		/// <param name="path">File path to save the capture to, relative to the ReShade base path. Saved as CSV if the extension is ".csv", as Chrome trace event JSON otherwise.</param>
+		/// <returns><see langword="true"/> if the capture was started, <see langword="false"/> if another capture is still in progress.</returns>
+		virtual bool capture_technique_timings(uint32_t frame_count, const char *path) = 0;
 	};
 } }
@@ -14,6 +14,9 @@
 
 void ReShadeLogMessage([[maybe_unused]] HMODULE module, int level, const char *message)
 {
+	if (!reshade::log::is_enabled(static_cast<reshade::log::level>(level)))
+		return;
+
 	std::string prefix;
 #if RESHADE_ADDON
 	if (module != nullptr)
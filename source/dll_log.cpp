@@ -4,6 +4,12 @@
  */
 
 #include "dll_log.hpp"
+#include "dll_log_format.hpp"
+#include <atomic>
+#include <deque>
+#include <cstring> // std::memcpy
+#include <algorithm> // std::min
+#include <unordered_map>
 #include <Windows.h>
 
 struct scoped_file_handle
@@ -26,6 +32,227 @@ private:
 };
 
 static scoped_file_handle s_file_handle;
+static std::atomic<int> s_max_level = static_cast<int>(reshade::log::level::debug);
+// Set when the open log file receives binary records instead of text lines
+static std::atomic<bool> s_binary = false;
+
+// Strings that were already written to the open binary log file, so that further messages only have to refer to them by identifier
+static SRWLOCK s_string_table_lock = SRWLOCK_INIT;
+static std::deque<std::string> s_string_table_storage;
+static std::unordered_map<std::string_view, uint32_t> s_string_table;
+
+// Bounded multi-producer single-consumer queue of formatted lines, so that logging threads never wait on file IO
+// Each slot has a sequence number that tells producers and the consumer whether it is free or holds a line for the current lap around the ring (see https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue)
+static struct log_queue
+{
+	static constexpr size_t SIZE = 4096;
+
+	log_queue()
+	{
+		for (size_t i = 0; i < SIZE; ++i)
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	struct slot
+	{
+		std::atomic<size_t> sequence;
+		std::string line;
+	} slots[SIZE];
+
+	std::atomic<size_t> enqueue_pos = 0;
+	std::atomic<size_t> dequeue_pos = 0;
+} s_log_queue;
+
+// Set while a thread is writing queued lines, since the queue only supports a single consumer at a time
+static std::atomic<bool> s_log_writing = false;
+// Set while a thread pool callback to write queued lines is pending, so that only the first line after it ran has to submit a new one
+static std::atomic<bool> s_log_write_scheduled = false;
+
+static bool enqueue_line(std::string &line)
+{
+	size_t pos = s_log_queue.enqueue_pos.load(std::memory_order_relaxed);
+	log_queue::slot *slot;
+
+	while (true)
+	{
+		slot = &s_log_queue.slots[pos % log_queue::SIZE];
+
+		const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		if (sequence == pos)
+		{
+			if (s_log_queue.enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (static_cast<ptrdiff_t>(sequence - pos) < 0)
+		{
+			return false; // Queue is full
+		}
+		else
+		{
+			pos = s_log_queue.enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->line = std::move(line);
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+static bool dequeue_line(std::string &line)
+{
+	const size_t pos = s_log_queue.dequeue_pos.load(std::memory_order_relaxed);
+	log_queue::slot *const slot = &s_log_queue.slots[pos % log_queue::SIZE];
+
+	// Stop at slots that were claimed, but not yet filled by a producer
+	if (slot->sequence.load(std::memory_order_acquire) != pos + 1)
+		return false;
+
+	line = std::move(slot->line);
+	slot->sequence.store(pos + log_queue::SIZE, std::memory_order_release);
+	s_log_queue.dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+	return true;
+}
+static bool has_queued_lines()
+{
+	const size_t pos = s_log_queue.dequeue_pos.load(std::memory_order_relaxed);
+	return s_log_queue.slots[pos % log_queue::SIZE].sequence.load(std::memory_order_acquire) == pos + 1;
+}
+
+// Must only be called by the thread that set 's_log_writing'
+static void write_queued_lines()
+{
+	std::string line, buffer;
+
+	const auto write_buffer = [&buffer]() {
+		if (buffer.empty())
+			return;
+
+		// Write lines to the log file in batches, to reduce the number of system calls
+		if (s_file_handle != INVALID_HANDLE_VALUE)
+		{
+			DWORD written = 0;
+			WriteFile(s_file_handle, buffer.data(), static_cast<DWORD>(buffer.size()), &written, nullptr);
+			assert(written == buffer.size());
+		}
+
+		buffer.clear();
+	};
+
+	while (dequeue_line(line))
+	{
+		// Binary records are written as is
+		if (s_binary.load(std::memory_order_relaxed))
+		{
+			buffer += line;
+
+			if (buffer.size() >= 64 * 1024)
+				write_buffer();
+			continue;
+		}
+
+		const size_t line_offset = buffer.size();
+
+		// Replace all LF with CRLF and terminate line with line feed
+		for (const char c : line)
+		{
+			if (c == '\n')
+				buffer += '\r';
+			buffer += c;
+		}
+		buffer += "\r\n";
+
+#ifndef NDEBUG
+		// Write line to the debug output
+		OutputDebugStringA(buffer.c_str() + line_offset);
+#endif
+
+		if (buffer.size() >= 64 * 1024)
+			write_buffer();
+	}
+
+	write_buffer();
+}
+
+static bool try_begin_write()
+{
+	return !s_log_writing.exchange(true, std::memory_order_acquire);
+}
+static void begin_write()
+{
+	while (!try_begin_write())
+		SwitchToThread();
+}
+static void end_write()
+{
+	s_log_writing.store(false, std::memory_order_release);
+}
+
+static void CALLBACK write_queued_lines_callback(PTP_CALLBACK_INSTANCE, PVOID)
+{
+	do
+	{
+		s_log_write_scheduled.store(false, std::memory_order_relaxed);
+
+		begin_write();
+		write_queued_lines();
+		end_write();
+	}
+	// Lines may have been queued after the last check by producers that saw the callback as still scheduled, so look again before returning
+	while (has_queued_lines() && !s_log_write_scheduled.exchange(true, std::memory_order_relaxed));
+}
+
+static void schedule_write()
+{
+	if (s_log_write_scheduled.exchange(true, std::memory_order_acq_rel))
+		return;
+
+	static TP_CALLBACK_ENVIRON environment = []() {
+		TP_CALLBACK_ENVIRON result;
+		InitializeThreadpoolEnvironment(&result);
+
+		// Keep this module loaded while a callback is still running
+		HMODULE module_handle = nullptr;
+		if (GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, reinterpret_cast<LPCWSTR>(&write_queued_lines_callback), &module_handle))
+			SetThreadpoolCallbackLibrary(&result, module_handle);
+		return result;
+	}();
+
+	if (!TrySubmitThreadpoolCallback(&write_queued_lines_callback, nullptr, &environment))
+	{
+		// Fall back to writing on the calling thread if no callback could be submitted
+		s_log_write_scheduled.store(false, std::memory_order_relaxed);
+
+		begin_write();
+		write_queued_lines();
+		end_write();
+	}
+}
+
+static void append_number(char *&p, unsigned long value, int min_digits)
+{
+	char digits[10];
+	int num_digits = 0;
+	do
+	{
+		digits[num_digits++] = '0' + static_cast<char>(value % 10);
+		value /= 10;
+	} while (value != 0 && num_digits < static_cast<int>(std::size(digits)));
+
+	for (int i = num_digits; i < min_digits; ++i)
+		*p++ = '0';
+	while (num_digits > 0)
+		*p++ = digits[--num_digits];
+}
+
+template <typename T>
+static void append_binary_data(std::string &record, const T &value)
+{
+	record.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+static void append_binary_argument(std::string &record, reshade::log::binary_format::argument_type type, uint8_t width)
+{
+	record += static_cast<char>(type);
+	record += static_cast<char>(width);
+}
 
 reshade::log::message::message(level level)
 {
@@ -36,52 +263,181 @@ reshade::log::message::message(level level)
 	if (static_cast<size_t>(level) > std::size(level_names))
 		level = level::debug;
 
-	SYSTEMTIME time;
-	GetLocalTime(&time);
-
 	// Set default line stream settings
 	_line_stream.setf(std::ios::left);
 	_line_stream.setf(std::ios::showbase);
 
+	if (s_binary.load(std::memory_order_relaxed))
+	{
+		_binary = true;
+
+		FILETIME time, local_time;
+		GetSystemTimeAsFileTime(&time);
+		FileTimeToLocalFileTime(&time, &local_time);
+
+		binary_format::message_header header;
+		header.size = 0; // Filled in when the message is complete
+		header.timestamp = (static_cast<uint64_t>(local_time.dwHighDateTime) << 32) | local_time.dwLowDateTime;
+		header.thread_id = GetCurrentThreadId();
+		header.level = static_cast<uint8_t>(level);
+
+		_binary_record.reserve(128);
+		append_binary_data(_binary_record, header);
+		return;
+	}
+
+	SYSTEMTIME time;
+	GetLocalTime(&time);
+
 	// Start a new line
-	_line_stream << std::right << std::setfill('0')
+	// Format the header by hand, since stream manipulators are comparatively slow
+	char header[64];
+	char *p = header;
 #if RESHADE_VERBOSE_LOG
-		<< std::setw(4) << time.wYear << '-'
-		<< std::setw(2) << time.wMonth << '-'
-		<< std::setw(2) << time.wDay << 'T'
+	append_number(p, time.wYear, 4); *p++ = '-';
+	append_number(p, time.wMonth, 2); *p++ = '-';
+	append_number(p, time.wDay, 2); *p++ = 'T';
 #endif
-		<< std::setw(2) << time.wHour << ':'
-		<< std::setw(2) << time.wMinute << ':'
-		<< std::setw(2) << time.wSecond << ':'
-		<< std::setw(3) << time.wMilliseconds << ' '
-		<< '[' << std::setw(5) << GetCurrentThreadId() << ']' << std::setfill(' ') << " | "
-		<< level_names[static_cast<size_t>(level) - 1] << " | " << std::left;
+	append_number(p, time.wHour, 2); *p++ = ':';
+	append_number(p, time.wMinute, 2); *p++ = ':';
+	append_number(p, time.wSecond, 2); *p++ = ':';
+	append_number(p, time.wMilliseconds, 3); *p++ = ' ';
+	*p++ = '[';
+	append_number(p, GetCurrentThreadId(), 5);
+	*p++ = ']';
+	std::memcpy(p, " | ", 3); p += 3;
+	std::memcpy(p, level_names[static_cast<size_t>(level) - 1], 5); p += 5;
+	std::memcpy(p, " | ", 3); p += 3;
+
+	_line_stream.write(header, p - header);
 }
 reshade::log::message::~message()
 {
-	std::string line_string = _line_stream.str();
-	line_string += '\n'; // Terminate line with line feed
+	std::string line_string;
+	if (_binary)
+	{
+		append_binary_text();
 
-	// Replace all LF with CRLF
-	for (size_t offset = 0; (offset = line_string.find('\n', offset)) != std::string::npos; offset += 2)
-		line_string.replace(offset, 1, "\r\n", 2);
+		const uint32_t size = static_cast<uint32_t>(_binary_record.size() - sizeof(binary_format::message_header));
+		std::memcpy(_binary_record.data() + offsetof(binary_format::message_header, size), &size, sizeof(size));
 
-	// Write line to the log file
-	if (s_file_handle != INVALID_HANDLE_VALUE)
+		line_string = std::move(_binary_record);
+	}
+	else
 	{
-		DWORD written = 0;
-		WriteFile(s_file_handle, line_string.data(), static_cast<DWORD>(line_string.size()), &written, nullptr);
-		assert(written == line_string.size());
+		line_string = _line_stream.str();
 	}
 
-#ifndef NDEBUG
-	// Write line to the debug output
-	OutputDebugStringA(line_string.c_str());
-#endif
+	// Queue line to be written to the log file, so that the calling thread (which may be a render thread) does not have to wait on the write
+	while (!enqueue_line(line_string))
+	{
+		// Queue is full, so write the queued lines on this thread to make room
+		begin_write();
+		write_queued_lines();
+		end_write();
+	}
+
+	schedule_write();
+}
+
+void reshade::log::message::append_binary_text()
+{
+	// Values without a binary representation were formatted into the line stream, so add that text as a string argument before anything else
+	if (_line_stream.tellp() <= 0)
+		return;
+
+	const std::string text = _line_stream.str();
+	_line_stream.str(std::string());
+
+	append_binary_argument(_binary_record, binary_format::argument_type::string, 0);
+	append_binary_data(_binary_record, static_cast<uint32_t>(text.size()));
+	_binary_record += text;
+}
+void reshade::log::message::append_binary_string(std::string_view value)
+{
+	append_binary_text();
+
+	const uint8_t width = static_cast<uint8_t>(std::min<std::streamsize>(_line_stream.width(0), 255));
+
+	// Only intern short strings, since long ones (like compiler output) are usually unique and would just grow the table
+	if (value.size() <= 256)
+	{
+		uint32_t id = 0;
+		bool defined = false;
+
+		AcquireSRWLockShared(&s_string_table_lock);
+		if (const auto it = s_string_table.find(value); it != s_string_table.end())
+			id = it->second, defined = true;
+		ReleaseSRWLockShared(&s_string_table_lock);
+
+		if (defined)
+		{
+			append_binary_argument(_binary_record, binary_format::argument_type::string_reference, width);
+			append_binary_data(_binary_record, id);
+			return;
+		}
+
+		AcquireSRWLockExclusive(&s_string_table_lock);
+		// Another thread may have added the string in the meantime, in which case it also wrote the definition
+		if (const auto it = s_string_table.find(value); it != s_string_table.end())
+		{
+			id = it->second;
+		}
+		else
+		{
+			id = static_cast<uint32_t>(s_string_table_storage.size());
+			s_string_table.emplace(s_string_table_storage.emplace_back(value), id);
+			defined = true;
+		}
+		ReleaseSRWLockExclusive(&s_string_table_lock);
+
+		append_binary_argument(_binary_record, defined ? binary_format::argument_type::string_definition : binary_format::argument_type::string_reference, width);
+		append_binary_data(_binary_record, id);
+		if (!defined)
+			return;
+	}
+	else
+	{
+		append_binary_argument(_binary_record, binary_format::argument_type::string, width);
+	}
+
+	append_binary_data(_binary_record, static_cast<uint32_t>(value.size()));
+	_binary_record += value;
 }
+void reshade::log::message::append_binary_integer(uint64_t value, size_t size, bool is_signed)
+{
+	append_binary_text();
+
+	const uint8_t width = static_cast<uint8_t>(std::min<std::streamsize>(_line_stream.width(0), 255));
+
+	uint8_t flags = static_cast<uint8_t>(size) & binary_format::integer_size_mask;
+	if (is_signed)
+		flags |= binary_format::integer_signed;
+	if ((_line_stream.flags() & std::ios::basefield) == std::ios::hex)
+		flags |= binary_format::integer_hex;
+	if (_line_stream.flags() & std::ios::showbase)
+		flags |= binary_format::integer_showbase;
 
-bool reshade::log::open_log_file(const std::filesystem::path &path, std::error_code &ec)
+	append_binary_argument(_binary_record, binary_format::argument_type::integer, width);
+	append_binary_data(_binary_record, flags);
+	append_binary_data(_binary_record, value);
+}
+void reshade::log::message::append_binary_float(double value)
 {
+	append_binary_text();
+
+	const uint8_t width = static_cast<uint8_t>(std::min<std::streamsize>(_line_stream.width(0), 255));
+
+	append_binary_argument(_binary_record, binary_format::argument_type::floating_point, width);
+	append_binary_data(_binary_record, value);
+}
+
+bool reshade::log::open_log_file(const std::filesystem::path &path, std::error_code &ec, bool binary)
+{
+	// Write lines queued so far to the previous file and prevent writes while the file is replaced
+	begin_write();
+	write_queued_lines();
+
 	// Close the previous file first
 	// Do this here, instead of in 'scoped_file_handle::operator=', so that the old handle is closed before the new handle is created
 	if (s_file_handle != INVALID_HANDLE_VALUE)
@@ -90,6 +446,24 @@ bool reshade::log::open_log_file(const std::filesystem::path &path, std::error_c
 	// Open the log file for writing (and flush on each write) and clear previous contents
 	s_file_handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, NULL);
 
+	s_binary.store(binary, std::memory_order_relaxed);
+
+	// Strings have to be defined again in the new file
+	AcquireSRWLockExclusive(&s_string_table_lock);
+	s_string_table.clear();
+	s_string_table_storage.clear();
+	ReleaseSRWLockExclusive(&s_string_table_lock);
+
+	if (binary && s_file_handle != INVALID_HANDLE_VALUE)
+	{
+		const uint32_t file_header[2] = { binary_format::magic, binary_format::version };
+
+		DWORD written = 0;
+		WriteFile(s_file_handle, file_header, sizeof(file_header), &written, nullptr);
+	}
+
+	end_write();
+
 	if (s_file_handle != INVALID_HANDLE_VALUE)
 	{
 		// Last error may be ERROR_ALREADY_EXISTS if an existing file was overwritten, which can be ignored
@@ -102,3 +476,41 @@ bool reshade::log::open_log_file(const std::filesystem::path &path, std::error_c
 		return false;
 	}
 }
+
+bool reshade::log::is_binary()
+{
+	return s_binary.load(std::memory_order_relaxed);
+}
+
+void reshade::log::set_max_level(level level)
+{
+	s_max_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+bool reshade::log::is_enabled(level level)
+{
+#ifdef NDEBUG
+	// Without a log file there is nowhere to write to in release builds
+	if (s_file_handle == INVALID_HANDLE_VALUE)
+		return false;
+#endif
+
+	return std::min(static_cast<int>(level), static_cast<int>(level::debug)) <= s_max_level.load(std::memory_order_relaxed);
+}
+
+void reshade::log::flush()
+{
+	// Wait only a limited amount of time for a write in progress, since the thread doing it may have been terminated already during process exit
+	for (int i = 0; i < 100; ++i)
+	{
+		if (try_begin_write())
+		{
+			write_queued_lines();
+			end_write();
+			return;
+		}
+
+		Sleep(1);
+	}
+
+	// Give up if the write flag could not be acquired, since draining the queue concurrently with its owner would corrupt it
+}
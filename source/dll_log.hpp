@@ -6,9 +6,12 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
 #include <iomanip>
 #include <sstream>
 #include <filesystem>
+#include <string_view>
+#include <type_traits>
 #include <utf8/unchecked.h>
 
 #undef INFO
@@ -16,11 +19,12 @@
 #undef WARN
 #undef DEBUG
 
+// Check the level before constructing the message, so that the arguments are not formatted (or even evaluated) when the message would be discarded anyway
 #define LOG(LEVEL) LOG_##LEVEL()
-#define LOG_INFO() reshade::log::message(reshade::log::level::info)
-#define LOG_ERROR() reshade::log::message(reshade::log::level::error)
-#define LOG_WARN() reshade::log::message(reshade::log::level::warning)
-#define LOG_DEBUG() reshade::log::message(reshade::log::level::debug)
+#define LOG_INFO() if (!reshade::log::is_enabled(reshade::log::level::info)) {} else reshade::log::message(reshade::log::level::info)
+#define LOG_ERROR() if (!reshade::log::is_enabled(reshade::log::level::error)) {} else reshade::log::message(reshade::log::level::error)
+#define LOG_WARN() if (!reshade::log::is_enabled(reshade::log::level::warning)) {} else reshade::log::message(reshade::log::level::warning)
+#define LOG_DEBUG() if (!reshade::log::is_enabled(reshade::log::level::debug)) {} else reshade::log::message(reshade::log::level::debug)
 
 namespace reshade::log
 {
@@ -36,10 +40,30 @@ namespace reshade::log
 	/// Opens a log file for writing.
 	/// </summary>
 	/// <param name="path">Path to the log file.</param>
-	bool open_log_file(const std::filesystem::path &path, std::error_code &ec);
+	/// <param name="binary">Set to <see langword="true"/> to write compact binary records instead of text, which can be converted back to text with the "logconv" tool.</param>
+	bool open_log_file(const std::filesystem::path &path, std::error_code &ec, bool binary = false);
 
 	/// <summary>
-	/// Constructs a single log message including current time and level and writes it to the open log file.
+	/// Checks whether the open log file receives binary records instead of text.
+	/// </summary>
+	bool is_binary();
+
+	/// <summary>
+	/// Sets the most verbose level of messages that are written to the log. Messages above it are discarded before they are formatted.
+	/// </summary>
+	void set_max_level(level level);
+	/// <summary>
+	/// Checks whether messages of the specified <paramref name="level"/> are currently written anywhere.
+	/// </summary>
+	bool is_enabled(level level);
+
+	/// <summary>
+	/// Writes all messages that were queued so far to the open log file, waiting only a limited amount of time for a write that is already in progress.
+	/// </summary>
+	void flush();
+
+	/// <summary>
+	/// Constructs a single log message including current time and level and queues it to be written to the open log file on a background thread.
 	/// </summary>
 	struct message
 	{
@@ -49,10 +73,35 @@ namespace reshade::log
 		template <typename T>
 		message &operator<<(const T &value)
 		{
+			// Binary records store numbers as is, so that they only have to be formatted when converting the log to text
+			// Character types (which includes 'int8_t' and 'uint8_t') go through the text path instead, so that they are formatted the same as in text logs
+			if constexpr (std::is_arithmetic_v<T> &&
+				!std::is_same_v<T, char> && !std::is_same_v<T, signed char> && !std::is_same_v<T, unsigned char> && !std::is_same_v<T, wchar_t>)
+			{
+				if (_binary)
+				{
+					if constexpr (std::is_floating_point_v<T>)
+						append_binary_float(static_cast<double>(value));
+					else
+						append_binary_integer(static_cast<uint64_t>(value), sizeof(T), std::is_signed_v<T>);
+					return *this;
+				}
+			}
+
 			_line_stream << value;
 			return *this;
 		}
 
+		template <>
+		message &operator<<(const std::string &message)
+		{
+			if (_binary)
+				append_binary_string(message);
+			else
+				_line_stream << message;
+			return *this;
+		}
+
 #if defined(_REFIID_DEFINED) && defined(_COMBASEAPI_H_)
 		template <>
 		message &operator<<(REFIID riid)
@@ -131,7 +180,10 @@ namespace reshade::log
 		inline message &operator<<(const char *message)
 		{
 			assert(message != nullptr);
-			_line_stream << message;
+			if (_binary)
+				append_binary_string(message);
+			else
+				_line_stream << message;
 			return *this;
 		}
 
@@ -147,6 +199,13 @@ namespace reshade::log
 		}
 
 	private:
+		void append_binary_text();
+		void append_binary_string(std::string_view value);
+		void append_binary_integer(uint64_t value, size_t size, bool is_signed);
+		void append_binary_float(double value);
+
+		bool _binary = false;
+		std::string _binary_record;
 		std::ostringstream _line_stream;
 	};
 }
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2014 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause OR MIT
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Layout of binary log files, shared between the log writer and the "logconv" tool that converts them back to text
+namespace reshade::log::binary_format
+{
+	// Binary log files start with this magic and version, followed by a sequence of message records
+	constexpr uint32_t magic = 0x474F4C52; // "RLOG"
+	constexpr uint32_t version = 1;
+
+#pragma pack(push, 1)
+	// Each message record starts with this header, followed by its arguments
+	struct message_header
+	{
+		uint32_t size; // Size of the arguments following this header in bytes
+		uint64_t timestamp; // Local time in 100-nanosecond intervals since January 1, 1601 (see 'FILETIME')
+		uint32_t thread_id;
+		uint8_t level;
+	};
+#pragma pack(pop)
+
+	// Each argument starts with its type and the minimum field width it is padded to, followed by data depending on the type
+	enum class argument_type : uint8_t
+	{
+		// Followed by a 32-bit identifier, 32-bit length and the characters of a string, which other arguments may refer to by that identifier
+		// Since messages are written by multiple threads, a reference may appear in the file before the definition of the string it refers to
+		string_definition = 1,
+		// Followed by a 32-bit identifier of a string defined elsewhere in the file
+		string_reference = 2,
+		// Followed by a 32-bit length and the characters of a string that was not interned
+		string = 3,
+		// Followed by 8-bit integer flags and a 64-bit value
+		integer = 4,
+		// Followed by a 64-bit floating-point value
+		floating_point = 5,
+	};
+
+	enum integer_flags : uint8_t
+	{
+		integer_size_mask = 0xF, // Size of the original integer type in bytes
+		integer_signed = 0x10,
+		integer_hex = 0x20,
+		integer_showbase = 0x40,
+	};
+}
@@ -163,18 +163,22 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID)
 
 			if (config.get("INSTALL", "Logging") || (!config.has("INSTALL", "Logging") && !GetEnvironmentVariableW(L"RESHADE_DISABLE_LOGGING", nullptr, 0)))
 			{
+				// Write compact binary records instead of text when requested, which can be converted back to text with the "logconv" tool
+				const bool binary_log = config.get("INSTALL", "BinaryLog");
+				const std::wstring log_extension = binary_log ? L".rslog" : L".log";
+
 				std::filesystem::path log_path = config.path();
-				log_path.replace_extension(L".log");
+				log_path.replace_extension(log_extension);
 
 				std::error_code ec;
-				if (!reshade::log::open_log_file(log_path, ec))
+				if (!reshade::log::open_log_file(log_path, ec, binary_log))
 				{
 					// Try a different file if the default failed to open (e.g. because currently in use by another ReShade instance)
 					for (int log_index = 0; log_index < 10 && std::filesystem::exists(log_path, ec); ++log_index)
 					{
-						log_path.replace_extension(L".log" + std::to_wstring(log_index + 1));
+						log_path.replace_extension(log_extension + std::to_wstring(log_index + 1));
 
-						if (reshade::log::open_log_file(log_path, ec))
+						if (reshade::log::open_log_file(log_path, ec, binary_log))
 							break;
 					}
 
@@ -183,6 +187,10 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID)
 						LOG(ERROR) << "Opening the ReShade log file" << " failed with error code " << ec.value() << '.';
 #endif
 				}
+
+				// Allow reducing the amount of messages written to the log (1 = errors only, 2 = warnings, 3 = information, 4 = everything)
+				if (unsigned int log_level = 0; config.get("INSTALL", "LogLevel", log_level) && log_level != 0)
+					reshade::log::set_max_level(static_cast<reshade::log::level>(log_level));
 			}
 
 			LOG(INFO) << "Initializing crosire's ReShade version '" VERSION_STRING_FILE "' "
@@ -228,6 +236,9 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID)
 						((code ^ 0xE24C4A00) <= 0xFF) /* LuaJIT exception */)
 						goto continue_search;
 
+					// Make sure everything logged up to this point ends up in the log file, in case the application is about to terminate
+					reshade::log::flush();
+
 					// Create dump with exception information for the first 100 occurrences
 					if (static unsigned int dump_index = 0; dump_index < 100)
 					{
@@ -365,7 +376,13 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID)
 				RemoveVectoredExceptionHandler(s_exception_handler_handle);
 #endif
 
+			// Write configuration and preset files that are still queued, since the background writer may already have been terminated when the process is exiting
+			ini_file::flush_pending_writes();
+
 			LOG(INFO) << "Finished exiting.";
+
+			// Write remaining messages, since the thread pool may not get to them anymore when the process is exiting
+			reshade::log::flush();
 			break;
 		}
 	}
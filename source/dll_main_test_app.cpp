@@ -837,6 +837,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int nCmdShow
 
 	reshade::hooks::uninstall();
 
+	reshade::log::flush();
+
 	return static_cast<int>(msg.wParam);
 }
 
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2014 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "effect_module.hpp"
+#include <cstring> // std::memcpy
+#include <type_traits>
+
+using namespace reshadefx;
+
+static constexpr uint32_t s_module_format_magic = 0x4D584652; // 'RFXM'
+// Increase this whenever any of the structures in 'effect_module.hpp' change, so that old serialized data is rejected
+static constexpr uint32_t s_module_format_version = 1;
+
+namespace
+{
+	class module_writer
+	{
+	public:
+		explicit module_writer(std::string &data) : _data(data) {}
+
+		template <typename... T>
+		void operator()(const T &... values) { (write(values), ...); }
+
+	private:
+		template <typename T>
+		void write(const T &value)
+		{
+			if constexpr (std::is_trivially_copyable_v<T>)
+				_data.append(reinterpret_cast<const char *>(&value), sizeof(value));
+			else
+				serialize(*this, const_cast<T &>(value)); // Writing does not modify the value
+		}
+		template <typename T, size_t N>
+		void write(const T (&values)[N])
+		{
+			for (const T &value : values)
+				write(value);
+		}
+		template <typename T>
+		void write(const std::vector<T> &values)
+		{
+			write(static_cast<uint32_t>(values.size()));
+
+			if constexpr (std::is_trivially_copyable_v<T>)
+				_data.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+			else
+				for (const T &value : values)
+					write(value);
+		}
+		void write(const std::string &value)
+		{
+			write(static_cast<uint32_t>(value.size()));
+			_data.append(value);
+		}
+
+		std::string &_data;
+	};
+
+	class module_reader
+	{
+	public:
+		module_reader(const std::string &data, size_t offset) : _data(data), _offset(offset) {}
+
+		template <typename... T>
+		void operator()(T &... values) { (read(values), ...); }
+
+		size_t offset() const { return _offset; }
+		bool failed() const { return _failed; }
+
+	private:
+		bool check_remaining(size_t size)
+		{
+			if (_failed || size > _data.size() - _offset)
+				_failed = true;
+			return !_failed;
+		}
+
+		template <typename T>
+		void read(T &value)
+		{
+			if constexpr (std::is_trivially_copyable_v<T>)
+			{
+				if (!check_remaining(sizeof(value)))
+					return;
+				std::memcpy(&value, _data.data() + _offset, sizeof(value));
+				_offset += sizeof(value);
+			}
+			else
+			{
+				serialize(*this, value);
+			}
+		}
+		template <typename T, size_t N>
+		void read(T (&values)[N])
+		{
+			for (T &value : values)
+				read(value);
+		}
+		template <typename T>
+		void read(std::vector<T> &values)
+		{
+			uint32_t size = 0;
+			read(size);
+			// Every element takes up at least one byte, so this also protects against huge allocations from corrupted data
+			if (!check_remaining(size))
+				return;
+
+			values.resize(size);
+
+			if constexpr (std::is_trivially_copyable_v<T>)
+			{
+				if (!check_remaining(values.size() * sizeof(T)))
+					return;
+				std::memcpy(values.data(), _data.data() + _offset, values.size() * sizeof(T));
+				_offset += values.size() * sizeof(T);
+			}
+			else
+			{
+				for (T &value : values)
+					read(value);
+			}
+		}
+		void read(std::string &value)
+		{
+			uint32_t size = 0;
+			read(size);
+			if (!check_remaining(size))
+				return;
+
+			value.assign(_data.data() + _offset, size);
+			_offset += size;
+		}
+
+		const std::string &_data;
+		size_t _offset;
+		bool _failed = false;
+	};
+
+	template <typename archive, typename first_type, typename second_type>
+	void serialize(archive &ar, std::pair<first_type, second_type> &value)
+	{
+		ar(value.first, value.second);
+	}
+
+	template <typename archive>
+	void serialize(archive &ar, constant &value)
+	{
+		ar(value.as_uint, value.string_data, value.array_data);
+	}
+
+	template <typename archive>
+	void serialize(archive &ar, annotation &value)
+	{
+		ar(value.type, value.name, value.value);
+	}
+
+	template <typename archive>
+	void serialize(archive &ar, texture_info &value)
+	{
+		ar(value.id, value.binding, value.name, value.semantic, value.unique_name, value.annotations,
+			value.width, value.height, value.depth, value.levels, value.type, value.format, value.render_target, value.storage_access);
+	}
+
+	template <typename archive>
+	void serialize(archive &ar, sampler_info &value)
+	{
+		ar(value.id, value.binding, value.texture_binding, value.type, value.name, value.unique_name, value.texture_name, value.annotations,
+			value.filter, value.address_u, value.address_v, value.address_w, value.min_lod, value.max_lod, value.lod_bias, value.srgb);
+	}
+
+	template <typename archive>
+	void serialize(archive &ar, storage_info &value)
+	{
+		ar(value.id, value.binding, value.level, value.type, value.name, value.unique_name, value.texture_name);
+	}
+
+	template <typename archive>
+	void serialize(archive &ar, uniform_info &value)
+	{
+		ar(value.type, value.name, value.size, value.offset, value.annotations, value.has_initializer_value, value.initializer_value);
+	}
+
+	template <typename archive>
+	void serialize(archive &ar, pass_info &value)
+	{
+		ar(value.name, value.render_target_names, value.vs_entry_point, value.ps_entry_point, value.cs_entry_point,
+			value.generate_mipmaps, value.clear_render_targets,
+			value.blend_enable, value.blend_op, value.blend_op_alpha, value.src_blend, value.dest_blend, value.src_blend_alpha, value.dest_blend_alpha,
+			value.srgb_write_enable, value.color_write_mask,
+			value.stencil_enable, value.stencil_read_mask, value.stencil_write_mask, value.stencil_comparison_func, value.stencil_op_pass, value.stencil_op_fail, value.stencil_op_depth_fail,
+			value.topology, value.stencil_reference_value, value.num_vertices, value.viewport_width, value.viewport_height, value.viewport_dispatch_z,
+			value.samplers, value.storages);
+	}
+
+	template <typename archive>
+	void serialize(archive &ar, technique_info &value)
+	{
+		ar(value.name, value.passes, value.annotations);
+	}
+
+	template <typename archive>
+	void serialize(archive &ar, effect_module &value)
+	{
+		ar(value.code, value.entry_points, value.textures, value.samplers, value.storages, value.uniforms, value.spec_constants, value.techniques,
+			value.total_uniform_size, value.num_texture_bindings, value.num_sampler_bindings, value.num_storage_bindings);
+	}
+}
+
+void reshadefx::serialize_module(const effect_module &module, std::string &data)
+{
+	module_writer writer(data);
+	writer(s_module_format_magic, s_module_format_version, module);
+}
+
+bool reshadefx::deserialize_module(effect_module &module, const std::string &data, size_t &offset)
+{
+	module_reader reader(data, offset);
+
+	uint32_t magic = 0, version = 0;
+	reader(magic, version);
+	if (reader.failed() || magic != s_module_format_magic || version != s_module_format_version)
+		return false;
+
+	effect_module result;
+	reader(result);
+	if (reader.failed())
+		return false;
+
+	module = std::move(result);
+	offset = reader.offset();
+	return true;
+}
@@ -345,4 +345,19 @@ namespace reshadefx
 		uint32_t num_sampler_bindings = 0;
 		uint32_t num_storage_bindings = 0;
 	};
+
+	/// <summary>
+	/// Appends a binary representation of the specified effect <paramref name="module"/> to <paramref name="data"/>, so that it can later be restored without parsing the effect again.
+	/// </summary>
+	/// <param name="module">The effect module to serialize.</param>
+	/// <param name="data">The binary data to append to.</param>
+	void serialize_module(const effect_module &module, std::string &data);
+	/// <summary>
+	/// Restores an effect module from a binary representation previously created with <see cref="serialize_module"/>.
+	/// </summary>
+	/// <param name="module">The effect module to overwrite on success.</param>
+	/// <param name="data">The binary data to read from.</param>
+	/// <param name="offset">Offset into <paramref name="data"/> to start reading at, which is advanced past the module on success.</param>
+	/// <returns><see langword="true"/> if the module was read successfully, <see langword="false"/> if the data was truncated or written by an incompatible version.</returns>
+	bool deserialize_module(effect_module &module, const std::string &data, size_t &offset);
 }
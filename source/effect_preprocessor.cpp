@@ -469,6 +469,9 @@ void reshadefx::preprocessor::parse_def()
 
 	create_macro_replacement_list(m);
 
+	// A predefined macro with the same name would cause a redefinition error, so keep track of this one too
+	_referenced_macros.insert(macro_name);
+
 	if (!add_macro_definition(macro_name, m))
 		return error(location, "redefinition of '" + macro_name + "'");
 }
@@ -525,7 +528,10 @@ void reshadefx::preprocessor::parse_ifdef()
 
 		// Only add to used macro list if this #ifdef is active and the macro was not defined before
 		if (const auto it = _macros.find(_token.literal_as_string); it == _macros.end() || it->second.is_predefined)
+		{
 			_used_macros.emplace(_token.literal_as_string);
+			_referenced_macros.insert(_token.literal_as_string);
+		}
 	}
 
 	_if_stack.push_back(std::move(level));
@@ -552,7 +558,10 @@ void reshadefx::preprocessor::parse_ifndef()
 
 		// Only add to used macro list if this #ifndef is active and the macro was not defined before
 		if (const auto it = _macros.find(_token.literal_as_string); it == _macros.end() || it->second.is_predefined)
+		{
 			_used_macros.emplace(_token.literal_as_string);
+			_referenced_macros.insert(_token.literal_as_string);
+		}
 	}
 
 	_if_stack.push_back(std::move(level));
@@ -923,11 +932,15 @@ bool reshadefx::preprocessor::evaluate_expression()
 				if (has_parentheses && !expect(tokenid::parenthesis_close))
 					return false;
 
+				if (const auto it = _macros.find(macro_name); it == _macros.end() || it->second.is_predefined)
+					_referenced_macros.insert(macro_name);
+
 				rpn[rpn_index++] = { is_defined(macro_name) ? 1 : 0, false };
 				continue;
 			}
 
-			// An identifier that cannot be replaced with a number becomes zero
+			// An identifier that cannot be replaced with a number becomes zero (unless a definition for it is added)
+			_referenced_macros.insert(_token.literal_as_string);
 			rpn[rpn_index++] = { 0, false };
 			break;
 		case tokenid::int_literal:
@@ -1113,6 +1126,9 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 	if (it == _macros.end())
 		return false;
 
+	if (it->second.is_predefined)
+		_referenced_macros.insert(it->first);
+
 	if (!_input_stack.empty())
 	{
 		const std::unordered_set<std::string> &hidden_macros = _input_stack[_current_input_index].hidden_macros;
@@ -88,6 +88,11 @@ namespace reshadefx
 		/// Gets a list of all defines that were used in #ifdef and #ifndef lines.
 		/// </summary>
 		std::vector<std::pair<std::string, std::string>> used_macro_definitions() const;
+		/// <summary>
+		/// Gets a list of all macro names that a definition added via <see cref="add_macro_definition"/> could affect the output through.
+		/// This includes predefined macros that were expanded, names tested in #if, #ifdef and #ifndef lines and names defined in the source.
+		/// </summary>
+		std::vector<std::string> referenced_macros() const { return std::vector<std::string>(_referenced_macros.begin(), _referenced_macros.end()); }
 
 		/// <summary>
 		/// Gets a list of pragma directives that occured.
@@ -156,6 +161,7 @@ namespace reshadefx
 
 		unsigned short _recursion_count = 0;
 		std::unordered_set<std::string> _used_macros;
+		std::unordered_set<std::string> _referenced_macros;
 		std::unordered_map<std::string, macro> _macros;
 
 		std::vector<std::filesystem::path> _include_paths;
@@ -5,14 +5,190 @@
 
 #include "ini_file.hpp"
 #include <fstream>
-#include <sstream>
+#include <mutex>
 #include <shared_mutex>
 #include <cctype> // std::toupper
 #include <cassert>
 #include <algorithm> // std::min, std::sort, std::transform
+#include <Windows.h>
 
 static std::shared_mutex s_ini_cache_mutex;
 static std::unordered_map<std::wstring, std::unique_ptr<ini_file>> s_ini_cache;
+// Maps paths passed to 'load_cache' to their canonical form, to avoid resolving them again on every access
+static std::unordered_map<std::wstring, std::filesystem::path> s_ini_canonical_paths;
+
+// Change notifications for the directories containing cached INI files, so that file times do not have to be checked on every access
+struct ini_directory_watch
+{
+	std::filesystem::path directory;
+	HANDLE handle = INVALID_HANDLE_VALUE;
+	HANDLE event = nullptr;
+	OVERLAPPED overlapped = {};
+	// Receives the names of changed files, so that only those are reloaded (and not all files in the directory whenever e.g. the log file is written)
+	alignas(DWORD) BYTE buffer[4096];
+};
+
+// Watches are allocated individually, since the system writes to their overlapped structure and buffer while a read is pending
+static std::vector<std::unique_ptr<ini_directory_watch>> s_ini_directory_watches;
+static std::vector<HANDLE> s_ini_directory_watch_handles;
+
+static bool read_directory_changes(ini_directory_watch &watch)
+{
+	watch.overlapped = {};
+	watch.overlapped.hEvent = watch.event;
+
+	// Changes that happen while no read is pending are buffered by the system and reported by the next read, so none are missed in between
+	return ReadDirectoryChangesW(watch.handle, watch.buffer, sizeof(watch.buffer), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE, nullptr, &watch.overlapped, nullptr) != FALSE;
+}
+
+static void close_directory_watch(ini_directory_watch &watch)
+{
+	if (watch.handle != INVALID_HANDLE_VALUE)
+	{
+		// Wait for the pending read to be canceled, since the system may otherwise still write to the buffer after it was freed
+		DWORD size = 0;
+		if (CancelIoEx(watch.handle, &watch.overlapped))
+			GetOverlappedResult(watch.handle, &watch.overlapped, &size, TRUE);
+
+		CloseHandle(watch.handle);
+		watch.handle = INVALID_HANDLE_VALUE;
+	}
+
+	if (watch.event != nullptr)
+	{
+		s_ini_directory_watch_handles.erase(std::remove(s_ini_directory_watch_handles.begin(), s_ini_directory_watch_handles.end(), watch.event), s_ini_directory_watch_handles.end());
+
+		CloseHandle(watch.event);
+		watch.event = nullptr;
+	}
+}
+
+std::atomic<bool> ini_file::s_has_modified_files = false;
+
+// Files waiting to be written by the background writer thread, with only the latest data kept per file
+struct pending_ini_write
+{
+	std::string data;
+	std::filesystem::file_time_type modified_at;
+};
+
+static std::mutex s_ini_write_queue_mutex;
+static std::unordered_map<std::wstring, pending_ini_write> s_ini_write_queue;
+static bool s_ini_writer_running = false;
+static std::atomic<bool> s_ini_writer_failed = false;
+// Held while writing a file, so that synchronous and background writes of the same file cannot overtake each other
+static std::mutex s_ini_write_mutex;
+
+static bool write_file_atomic(const std::filesystem::path &path, const std::string &data, std::filesystem::file_time_type modified_at)
+{
+	std::filesystem::path temp_path = path;
+	temp_path += L".tmp";
+
+	{
+		std::ofstream file(temp_path);
+		if (!file)
+			return false;
+
+		file.imbue(std::locale("en-us.UTF-8"));
+
+		// Flush stream to disk before replacing the file
+		if (!(file.write(data.data(), data.size()) && file.flush()))
+		{
+			file.close();
+
+			std::error_code ec;
+			std::filesystem::remove(temp_path, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	// Stamp the file with the time the data was serialized at, so that 'load' does not consider it an outside modification
+	std::filesystem::last_write_time(temp_path, modified_at, ec);
+
+	// Replace the existing file in a single step, so that a crash can never leave a truncated file behind
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temp_path, ec);
+		return false;
+	}
+
+	return true;
+}
+static DWORD WINAPI ini_writer_thread(LPVOID module)
+{
+	while (true)
+	{
+		const std::unique_lock<std::mutex> write_lock(s_ini_write_mutex);
+
+		std::wstring path;
+		pending_ini_write write;
+		{
+			const std::unique_lock<std::mutex> queue_lock(s_ini_write_queue_mutex);
+
+			if (s_ini_write_queue.empty())
+			{
+				s_ini_writer_running = false;
+				break;
+			}
+
+			auto node = s_ini_write_queue.extract(s_ini_write_queue.begin());
+			path = std::move(node.key());
+			write = std::move(node.mapped());
+		}
+
+		if (!write_file_atomic(path, write.data, write.modified_at))
+			s_ini_writer_failed.store(true, std::memory_order_relaxed);
+	}
+
+	// Release the reference to this module that kept it loaded while writing, which may unload it, so cannot return into it afterwards
+	FreeLibraryAndExitThread(static_cast<HMODULE>(module), 0);
+}
+
+static void queue_file_write(const std::filesystem::path &path, std::string &&data, std::filesystem::file_time_type modified_at)
+{
+	const std::unique_lock<std::mutex> lock(s_ini_write_queue_mutex);
+
+	// Coalesce with a write of the same file that is still pending
+	s_ini_write_queue[path.native()] = { std::move(data), modified_at };
+
+	if (s_ini_writer_running)
+		return;
+
+	// The writer thread exits again once the queue is empty
+	// It holds a reference to this module while running, so that the module cannot be unloaded before all queued files were written
+	HMODULE module = nullptr;
+	if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, reinterpret_cast<LPCWSTR>(&ini_writer_thread), &module))
+		return; // Leave the file queued, so that it is written by a later 'save' or 'flush_pending_writes' instead
+
+	if (const HANDLE thread = CreateThread(nullptr, 0, &ini_writer_thread, module, 0, nullptr))
+	{
+		CloseHandle(thread);
+		s_ini_writer_running = true;
+	}
+	else
+	{
+		FreeLibrary(module);
+	}
+}
+static bool write_pending_file(const std::filesystem::path &path)
+{
+	// Has to be called with 's_ini_write_mutex' held, so that the background writer cannot be writing the same file at the same time
+	pending_ini_write write;
+	{
+		const std::unique_lock<std::mutex> queue_lock(s_ini_write_queue_mutex);
+
+		const auto it = s_ini_write_queue.find(path.native());
+		if (it == s_ini_write_queue.end())
+			return true;
+
+		write = std::move(it->second);
+		s_ini_write_queue.erase(it);
+	}
+
+	return write_file_atomic(path, write.data, write.modified_at);
+}
 
 ini_file &reshade::global_config()
 {
@@ -33,6 +209,7 @@ bool ini_file::load()
 
 	// Clear when file does not exist too
 	_sections.clear();
+	_version++;
 
 	std::ifstream file(_path);
 	if (!file)
@@ -110,125 +287,173 @@ bool ini_file::load()
 
 	return true;
 }
-bool ini_file::save()
+std::string ini_file::serialize() const
 {
-	if (!_modified)
-		return true;
-
-	// Reset state even on failure to avoid 'flush_cache' repeatedly trying and failing to save
-	_modified = false;
-
-	std::error_code ec;
-	const std::filesystem::file_time_type modified_at = std::filesystem::last_write_time(_path, ec);
-	if (!ec && (modified_at - _modified_at) > std::chrono::seconds(2))
-		return false; // File exists and was modified on disk and therefore may have different data, so cannot save
+	// Fold the names to upper case once up front, instead of in every comparison while sorting
+	const auto fold_case = [](const std::string &name) {
+		std::string folded_name = name;
+		std::transform(folded_name.begin(), folded_name.end(), folded_name.begin(), [](std::string::value_type c) { return static_cast<std::string::value_type>(std::toupper(c)); });
+		return folded_name;
+	};
+	const auto compare_folded_names = [](const auto &a, const auto &b) { return a.first < b.first; };
 
-	std::stringstream data;
-	std::vector<std::string> section_names, key_names;
+	std::string data;
+	std::vector<std::pair<std::string, const std::string *>> section_names, key_names;
 
 	section_names.reserve(_sections.size());
 	for (const std::pair<const std::string, section_type> &section : _sections)
-		section_names.push_back(section.first);
+		section_names.emplace_back(fold_case(section.first), &section.first);
 
 	// Sort sections to generate consistent files
-	std::sort(section_names.begin(), section_names.end(),
-		[](std::string a, std::string b) {
-			std::transform(a.begin(), a.end(), a.begin(), [](std::string::value_type c) { return static_cast<std::string::value_type>(std::toupper(c)); });
-			std::transform(b.begin(), b.end(), b.begin(), [](std::string::value_type c) { return static_cast<std::string::value_type>(std::toupper(c)); });
-			return a < b;
-		});
-
-	for (const std::string &section_name : section_names)
+	std::sort(section_names.begin(), section_names.end(), compare_folded_names);
+
+	for (const std::pair<std::string, const std::string *> &section_name : section_names)
 	{
-		if (const section_type &keys = _sections.at(section_name); !keys.empty())
+		if (const section_type &keys = _sections.at(*section_name.second); !keys.empty())
 		{
 			key_names.clear();
 			key_names.reserve(keys.size());
 			for (const std::pair<const std::string, value_type> &key : keys)
-				key_names.push_back(key.first);
+				key_names.emplace_back(fold_case(key.first), &key.first);
 
-			std::sort(key_names.begin(), key_names.end(),
-				[](std::string a, std::string b) {
-					std::transform(a.begin(), a.end(), a.begin(), [](std::string::value_type c) { return static_cast<std::string::value_type>(std::toupper(c)); });
-					std::transform(b.begin(), b.end(), b.begin(), [](std::string::value_type c) { return static_cast<std::string::value_type>(std::toupper(c)); });
-					return a < b;
-				});
+			std::sort(key_names.begin(), key_names.end(), compare_folded_names);
 
 			// Empty section should have been sorted to the top, so do not need to append it before keys
-			if (!section_name.empty())
-				data << '[' << section_name << ']' << '\n';
+			if (!section_name.second->empty())
+				data += '[' + *section_name.second + ']' + '\n';
 
-			for (const std::string &key_name : key_names)
+			for (const std::pair<std::string, const std::string *> &key_name : key_names)
 			{
-				data << key_name << '=';
+				data += *key_name.second;
+				data += '=';
 
-				if (const ini_file::value_type &elements = keys.at(key_name); !elements.empty())
+				if (const ini_file::value_type &elements = keys.at(*key_name.second); !elements.empty())
 				{
-					std::string value;
+					const size_t value_offset = data.size();
+
 					for (const std::string &element : elements)
 					{
 						// Empty elements mess with escaped commas, so simply skip them
 						if (element.empty())
 							continue;
 
-						value.reserve(value.size() + element.size() + 1);
 						for (const char c : element)
-							value.append(c == ',' ? 2 : 1, c);
-						value += ','; // Separate multiple values with a comma
+							data.append(c == ',' ? 2 : 1, c);
+						data += ','; // Separate multiple values with a comma
 					}
 
 					// Remove the last comma
-					if (!value.empty())
+					if (data.size() != value_offset)
 					{
-						assert(value.back() == ',');
-						value.pop_back();
+						assert(data.back() == ',');
+						data.pop_back();
 					}
-
-					data << value;
 				}
 
-				data << '\n';
+				data += '\n';
 			}
 
-			data << '\n';
+			data += '\n';
 		}
 	}
 
-	std::ofstream file(_path);
-	if (!file)
-		return false;
+	return data;
+}
 
-	file.imbue(std::locale("en-us.UTF-8"));
+bool ini_file::save()
+{
+	// Wait for a background write that may be in progress to finish
+	const std::unique_lock<std::mutex> write_lock(s_ini_write_mutex);
 
-	const std::string str = data.str();
+	// Changes may have been queued for the background writer already, so write those right away to have the file complete on disk when this returns
+	if (!_modified)
+		return write_pending_file(_path);
 
-	// Flush stream to disk before updating last write time
-	const bool fail = !(file.write(str.data(), str.size()) && file.flush());
-	file.close();
-	if (fail)
-		return false;
+	// Reset state even on failure to avoid 'flush_cache' repeatedly trying and failing to save
+	_modified = false;
 
-	_modified_at = std::filesystem::last_write_time(_path, ec);
+	std::error_code ec;
+	const std::filesystem::file_time_type modified_at = std::filesystem::last_write_time(_path, ec);
+	if (!ec && (modified_at - _modified_at) > std::chrono::seconds(2))
+		return false; // File exists and was modified on disk and therefore may have different data, so cannot save
+
+	const std::string data = serialize();
+	_modified_at = std::filesystem::file_time_type::clock::now();
+
+	// Drop any pending background write of this file, since it would contain older data
+	{
+		const std::unique_lock<std::mutex> queue_lock(s_ini_write_queue_mutex);
+		s_ini_write_queue.erase(_path.native());
+	}
 
-	assert(!ec && std::filesystem::file_size(_path, ec) > 0);
+	return write_file_atomic(_path, data, _modified_at);
+}
+bool ini_file::save_async()
+{
+	// Reset state even on failure to avoid 'flush_cache' repeatedly trying and failing to save
+	_modified = false;
+
+	std::error_code ec;
+	const std::filesystem::file_time_type modified_at = std::filesystem::last_write_time(_path, ec);
+	if (!ec && (modified_at - _modified_at) > std::chrono::seconds(2))
+		return false; // File exists and was modified on disk and therefore may have different data, so cannot save
+
+	std::string data = serialize();
+	_modified_at = std::filesystem::file_time_type::clock::now();
+
+	queue_file_write(_path, std::move(data), _modified_at);
 
 	return true;
 }
 
 bool ini_file::flush_cache()
 {
-	bool success = true;
+	poll_directory_changes();
+
+	// Report failures of previous background writes
+	bool success = !s_ini_writer_failed.exchange(false, std::memory_order_relaxed);
+
+	if (!s_has_modified_files.load(std::memory_order_relaxed))
+		return success;
 
 	const std::shared_lock<std::shared_mutex> lock(s_ini_cache_mutex);
 
+	s_has_modified_files.store(false, std::memory_order_relaxed);
+
 	// Save all files that were modified in one second intervals
 	for (auto &file : s_ini_cache)
-		// Check modified status before requesting file time, since the latter is costly and therefore should be avoided when not necessary
-		if (file.second->_modified && (std::filesystem::file_time_type::clock::now() - file.second->_modified_at) > std::chrono::seconds(1))
-			success &= file.second->save();
+	{
+		if (!file.second->_modified)
+			continue;
+
+		if ((std::filesystem::file_time_type::clock::now() - file.second->_modified_at) > std::chrono::seconds(1))
+			success &= file.second->save_async();
+		else
+			s_has_modified_files.store(true, std::memory_order_relaxed); // Check this file again next time
+	}
 
 	return success;
 }
+void ini_file::flush_pending_writes()
+{
+	// This is called during shutdown, where the writer thread may have been terminated while holding a lock, so do not wait on it
+	const std::unique_lock<std::mutex> write_lock(s_ini_write_mutex, std::try_to_lock);
+	if (!write_lock.owns_lock())
+		return;
+
+	std::unordered_map<std::wstring, pending_ini_write> queue;
+	{
+		const std::unique_lock<std::mutex> queue_lock(s_ini_write_queue_mutex, std::try_to_lock);
+		if (!queue_lock.owns_lock())
+			return;
+
+		queue.swap(s_ini_write_queue);
+	}
+
+	for (const auto &[path, write] : queue)
+		write_file_atomic(path, write.data, write.modified_at);
+}
+
 bool ini_file::flush_cache(std::filesystem::path path)
 {
 	std::error_code ec;
@@ -246,6 +471,12 @@ void ini_file::clear_cache()
 	const std::unique_lock<std::shared_mutex> lock(s_ini_cache_mutex);
 
 	s_ini_cache.clear();
+	s_ini_canonical_paths.clear();
+
+	for (const std::unique_ptr<ini_directory_watch> &watch : s_ini_directory_watches)
+		close_directory_watch(*watch);
+	s_ini_directory_watches.clear();
+	s_ini_directory_watch_handles.clear();
 }
 void ini_file::clear_cache(std::filesystem::path path)
 {
@@ -256,27 +487,155 @@ void ini_file::clear_cache(std::filesystem::path path)
 	const std::unique_lock<std::shared_mutex> lock(s_ini_cache_mutex);
 
 	s_ini_cache.erase(path);
+
+	for (auto it = s_ini_canonical_paths.begin(); it != s_ini_canonical_paths.end();)
+	{
+		if (it->second == path)
+			it = s_ini_canonical_paths.erase(it);
+		else
+			++it;
+	}
+}
+
+static bool watch_directory(const std::filesystem::path &directory)
+{
+	if (const auto it = std::find_if(s_ini_directory_watches.begin(), s_ini_directory_watches.end(),
+			[&directory](const std::unique_ptr<ini_directory_watch> &watch) { return watch->directory == directory; });
+		it != s_ini_directory_watches.end())
+		return (*it)->handle != INVALID_HANDLE_VALUE;
+
+	ini_directory_watch &watch = *s_ini_directory_watches.emplace_back(std::make_unique<ini_directory_watch>());
+	watch.directory = directory;
+
+	// Can only wait on a limited number of handles at once, so fall back to checking file times for any directories beyond that
+	// Change notifications may also not be available (e.g. on some network drives), in which case the same fallback applies
+	if (s_ini_directory_watch_handles.size() >= MAXIMUM_WAIT_OBJECTS)
+		return false;
+
+	watch.handle = CreateFileW(directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+	if (watch.handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	watch.event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	if (watch.event == nullptr || !read_directory_changes(watch))
+	{
+		close_directory_watch(watch);
+		return false;
+	}
+
+	s_ini_directory_watch_handles.push_back(watch.event);
+	return true;
+}
+
+void ini_file::poll_directory_changes()
+{
+	// Check all directories with a single call, since usually none of them changed
+	{
+		const std::shared_lock<std::shared_mutex> lock(s_ini_cache_mutex);
+
+		if (s_ini_directory_watch_handles.empty())
+			return;
+
+		const DWORD result = WaitForMultipleObjects(static_cast<DWORD>(s_ini_directory_watch_handles.size()), s_ini_directory_watch_handles.data(), FALSE, 0);
+		if (result - WAIT_OBJECT_0 >= s_ini_directory_watch_handles.size())
+			return;
+	}
+
+	// Reading the changes and issuing the next read modifies the watches, so need exclusive access
+	const std::unique_lock<std::shared_mutex> lock(s_ini_cache_mutex);
+
+	for (const std::unique_ptr<ini_directory_watch> &watch : s_ini_directory_watches)
+	{
+		if (watch->handle == INVALID_HANDLE_VALUE || WaitForSingleObject(watch->event, 0) != WAIT_OBJECT_0)
+			continue;
+
+		// A read that completes without any data means the system buffer overflowed, so do not know which files changed
+		DWORD size = 0;
+		const bool all_changed = !GetOverlappedResult(watch->handle, &watch->overlapped, &size, FALSE) || size == 0;
+
+		std::vector<std::wstring_view> changed_file_names;
+		if (!all_changed)
+		{
+			for (const BYTE *entry = watch->buffer;;)
+			{
+				const auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(entry);
+				changed_file_names.emplace_back(info->FileName, info->FileNameLength / sizeof(WCHAR));
+
+				if (info->NextEntryOffset == 0)
+					break;
+				entry += info->NextEntryOffset;
+			}
+		}
+
+		for (const auto &file : s_ini_cache)
+		{
+			if (file.second->_path.parent_path() != watch->directory)
+				continue;
+
+			// File names are case-insensitive
+			const std::wstring file_name = file.second->_path.filename().native();
+			if (all_changed || std::any_of(changed_file_names.begin(), changed_file_names.end(),
+					[&file_name](std::wstring_view changed_file_name) {
+						return CompareStringOrdinal(file_name.c_str(), static_cast<int>(file_name.size()), changed_file_name.data(), static_cast<int>(changed_file_name.size()), TRUE) == CSTR_EQUAL;
+					}))
+				file.second->_stale.store(true, std::memory_order_relaxed);
+		}
+
+		// Fall back to checking file times for files in this directory if the next read cannot be issued
+		if (!read_directory_changes(*watch))
+		{
+			close_directory_watch(*watch);
+
+			for (const auto &file : s_ini_cache)
+				if (file.second->_path.parent_path() == watch->directory)
+					file.second->_stale.store(true, std::memory_order_relaxed);
+		}
+	}
 }
 
 ini_file &ini_file::load_cache(std::filesystem::path path)
 {
 	assert(!path.empty());
 
+	// Fast path for files that were already loaded and did not change since, which does not need to access the file system
+	{
+		const std::shared_lock<std::shared_mutex> lock(s_ini_cache_mutex);
+
+		if (const auto canonical_it = s_ini_canonical_paths.find(path); canonical_it != s_ini_canonical_paths.end())
+			if (const auto it = s_ini_cache.find(canonical_it->second); it != s_ini_cache.end() && !it->second->_stale.load(std::memory_order_relaxed))
+				return *it->second;
+	}
+
+	std::filesystem::path canonical_path = path;
 	std::error_code ec;
 	if (std::filesystem::path resolved = std::filesystem::weakly_canonical(path, ec); !ec)
-		path = std::move(resolved);
+		canonical_path = std::move(resolved);
 
 	const std::unique_lock<std::shared_mutex> lock(s_ini_cache_mutex);
 
-	const auto insert = s_ini_cache.try_emplace(path);
+	s_ini_canonical_paths.insert_or_assign(path, canonical_path);
+
+	const auto insert = s_ini_cache.try_emplace(canonical_path);
 	const auto it = insert.first;
 
+	// Files in directories that cannot be watched stay stale, so that their file time is checked on every access instead
+	const bool watched = watch_directory(canonical_path.parent_path());
+
 	// Only construct when actually adding a new entry to the cache, since the 'ini_file' constructor performs a costly load of the file
 	if (insert.second)
-		it->second = std::make_unique<ini_file>(path);
-	// Don't reload file when it was just loaded or there are still modifications pending
-	else if (!it->second->_modified)
-		it->second->load();
+	{
+		it->second = std::make_unique<ini_file>(canonical_path);
+		it->second->_stale.store(!watched, std::memory_order_relaxed);
+	}
+	else
+	{
+		// Reset before loading, so that a change notification arriving during the load marks the file stale again
+		it->second->_stale.store(!watched, std::memory_order_relaxed);
+
+		// Don't reload file when there are still modifications pending
+		if (!it->second->_modified)
+			it->second->load();
+	}
 
 	return *it->second;
 }
@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <filesystem>
@@ -35,6 +37,11 @@ public:
 	/// </summary>
 	const std::filesystem::path &path() const { return _path; }
 
+	/// <summary>
+	/// Gets a number that changes whenever the contents of this INI file change, either through modification or by reloading it from disk.
+	/// </summary>
+	uint64_t version() const { return _version; }
+
 	/// <summary>
 	/// Checks whether the specified <paramref name="section"/> and <paramref name="key"/> currently exist in the INI.
 	/// </summary>
@@ -144,16 +151,14 @@ public:
 	{
 		auto &v = _sections[section][key];
 		v.assign(1, value);
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 	void set(const std::string &section, const std::string &key, std::string &&value)
 	{
 		auto &v = _sections[section][key];
 		v.resize(1);
 		v[0] = std::forward<std::string>(value);
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 	template <>
 	void set(const std::string &section, const std::string &key, const std::filesystem::path &value)
@@ -167,8 +172,7 @@ public:
 		v.resize(size);
 		for (size_t i = 0; i < size; ++i)
 			v[i] = std::to_string(values[i]);
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 	template <typename T>
 	void set(const std::string &section, const std::string &key, const std::vector<T> &values)
@@ -177,23 +181,20 @@ public:
 		v.resize(values.size());
 		for (size_t i = 0; i < values.size(); ++i)
 			v[i] = std::to_string(values[i]);
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 	template <>
 	void set(const std::string &section, const std::string &key, const std::vector<std::string> &values)
 	{
 		auto &v = _sections[section][key];
 		v = values;
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 	void set(const std::string &section, const std::string &key, std::vector<std::string> &&values)
 	{
 		auto &v = _sections[section][key];
 		v = std::forward<std::vector<std::string>>(values);
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 	template <>
 	void set(const std::string &section, const std::string &key, const std::vector<std::pair<std::string, std::string>> &values)
@@ -207,8 +208,7 @@ public:
 			if (!value.second.empty())
 				v[i] += '=' + value.second;
 		}
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 	template <>
 	void set(const std::string &section, const std::string &key, const std::vector<std::filesystem::path> &values)
@@ -217,8 +217,7 @@ public:
 		v.resize(values.size());
 		for (size_t i = 0; i < values.size(); ++i)
 			v[i] = values[i].u8string();
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 
 	/// <summary>
@@ -227,8 +226,7 @@ public:
 	void clear()
 	{
 		_sections.clear();
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 
 	/// <summary>
@@ -243,8 +241,7 @@ public:
 		if (it2 == it1->second.end())
 			return;
 		it1->second.erase(it2);
-		_modified = true;
-		_modified_at = std::filesystem::file_time_type::clock::now();
+		mark_modified();
 	}
 
 	/// <summary>
@@ -253,14 +250,23 @@ public:
 	bool load();
 	/// <summary>
 	/// Saves all changes to this INI file to disk.
+	/// The file is replaced atomically, so that it is never left truncated.
 	/// </summary>
 	bool save();
 
 	/// <summary>
 	/// Saves all changes to INI files that were loaded through <see cref="load_cache"/> to disk.
+	/// Files are written on a background thread, so this only reports failures of previous writes.
 	/// </summary>
 	static bool flush_cache();
+	/// <summary>
+	/// Saves all changes to the specified INI file that was loaded through <see cref="load_cache"/> to disk and waits for that to finish.
+	/// </summary>
 	static bool flush_cache(std::filesystem::path path);
+	/// <summary>
+	/// Writes all files that are still queued for the background writer on the calling thread, so that they are not lost when the process exits.
+	/// </summary>
+	static void flush_pending_writes();
 
 	/// <summary>
 	/// Removes all INI files from cache, without saving changes.
@@ -276,6 +282,17 @@ public:
 	static ini_file &load_cache(std::filesystem::path path);
 
 private:
+	void mark_modified()
+	{
+		_version++;
+		_modified = true;
+		_modified_at = std::filesystem::file_time_type::clock::now();
+		s_has_modified_files.store(true, std::memory_order_relaxed);
+	}
+
+	bool save_async();
+	std::string serialize() const;
+
 	template <typename T>
 	static const T convert(const std::vector<std::string> &values, size_t i) = delete;
 	template <>
@@ -345,8 +362,16 @@ private:
 
 	const std::filesystem::path _path;
 	std::unordered_map<std::string, section_type> _sections;
+	uint64_t _version = 0;
 	bool _modified = false;
 	std::filesystem::file_time_type _modified_at;
+	// Set when the directory containing this file changed, so that 'load_cache' has to check whether it needs to be reloaded
+	std::atomic<bool> _stale = true;
+
+	static void poll_directory_changes();
+
+	// Set whenever any INI file is modified, so that 'flush_cache' can return early without looking at every file
+	static std::atomic<bool> s_has_modified_files;
 };
 
 namespace reshade
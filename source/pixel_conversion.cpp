@@ -0,0 +1,688 @@
+/*
+ * Copyright (C) 2014 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "pixel_conversion.hpp"
+#include <cmath> // std::pow
+#include <cstring> // std::memcpy, std::memmove
+#include <vector>
+#include <thread>
+#include <algorithm> // std::min, std::max, std::swap
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	#define RESHADE_PIXEL_CONVERSION_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define RESHADE_PIXEL_CONVERSION_SSE2 0
+#endif
+
+using namespace reshade;
+
+// Linear to sRGB encoding of 12-bit quantized values, used for floating-point formats
+static const struct srgb_table
+{
+	srgb_table()
+	{
+		for (int i = 0; i < 4096; ++i)
+		{
+			const float c = i / 4095.0f;
+			const float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+			values[i] = static_cast<uint8_t>(s * 255.0f + 0.5f);
+		}
+	}
+
+	uint8_t values[4096];
+} s_linear_to_srgb;
+
+static inline float half_to_float(uint16_t value)
+{
+	// Negative values are clamped to zero anyway, so can ignore the sign
+	if (value & 0x8000)
+		return 0.0f;
+
+	// Shift exponent and mantissa into place and rebias the exponent by multiplying with 2^112, which also handles denormals correctly
+	// Infinity and NaN end up as large finite values, which are clamped to one below
+	const uint32_t bits = static_cast<uint32_t>(value & 0x7FFF) << 13;
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result * 0x1p112f;
+}
+static inline float saturate(float value)
+{
+	return value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+}
+
+static void convert_row_r8_unorm(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+	{
+		dst[x * 4 + 0] = src[x];
+		dst[x * 4 + 1] = 0;
+		dst[x * 4 + 2] = 0;
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+static void convert_row_r8g8_unorm(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+	{
+		dst[x * 4 + 0] = src[x * 2 + 0];
+		dst[x * 4 + 1] = src[x * 2 + 1];
+		dst[x * 4 + 2] = 0;
+		dst[x * 4 + 3] = 0xFF;
+	}
+}
+static void convert_row_r8g8b8a8_unorm(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	std::memcpy(dst, src, width * 4);
+}
+static void convert_row_r8g8b8x8_unorm(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	std::memcpy(dst, src, width * 4);
+	for (size_t x = 0; x < width; ++x)
+		dst[x * 4 + 3] = 0xFF;
+}
+static void convert_row_b8g8r8a8_unorm(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	std::memcpy(dst, src, width * 4);
+	// Format is BGRA, but output should be RGBA, so flip channels
+	for (size_t x = 0; x < width; ++x)
+		std::swap(dst[x * 4 + 0], dst[x * 4 + 2]);
+}
+static void convert_row_b8g8r8x8_unorm(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	convert_row_b8g8r8a8_unorm(src, dst, width);
+	for (size_t x = 0; x < width; ++x)
+		dst[x * 4 + 3] = 0xFF;
+}
+static void convert_row_r10g10b10a2_unorm(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+	{
+		uint32_t rgba;
+		std::memcpy(&rgba, src + x * 4, sizeof(rgba));
+		// Divide by 4 to get 10-bit range (0-1023) into 8-bit range (0-255)
+		dst[x * 4 + 0] = (( rgba & 0x000003FF)        /  4) & 0xFF;
+		dst[x * 4 + 1] = (((rgba & 0x000FFC00) >> 10) /  4) & 0xFF;
+		dst[x * 4 + 2] = (((rgba & 0x3FF00000) >> 20) /  4) & 0xFF;
+		dst[x * 4 + 3] = (((rgba & 0xC0000000) >> 30) * 85) & 0xFF;
+	}
+}
+static void convert_row_b10g10r10a2_unorm(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	convert_row_r10g10b10a2_unorm(src, dst, width);
+	for (size_t x = 0; x < width; ++x)
+		std::swap(dst[x * 4 + 0], dst[x * 4 + 2]);
+}
+static void convert_row_r16g16b16a16_unorm(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	for (size_t x = 0; x < width * 4; ++x)
+	{
+		uint16_t value;
+		std::memcpy(&value, src + x * 2, sizeof(value));
+		dst[x] = static_cast<uint8_t>(value >> 8);
+	}
+}
+static void convert_row_r16g16b16a16_float(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	for (size_t x = 0; x < width * 4; ++x)
+	{
+		uint16_t value;
+		std::memcpy(&value, src + x * 2, sizeof(value));
+		const float c = saturate(half_to_float(value));
+		dst[x] = (x % 4) == 3 ?
+			static_cast<uint8_t>(static_cast<int>(c * 255.0f + 0.5f)) :
+			s_linear_to_srgb.values[static_cast<int>(c * 4095.0f + 0.5f)];
+	}
+}
+
+static inline float half_to_float_exact(uint16_t value)
+{
+	// Same as 'half_to_float' above, but keeps the sign and maps infinity and NaN to their single-precision equivalents
+	uint32_t bits = static_cast<uint32_t>(value & 0x7FFF) << 13;
+	if ((value & 0x7C00) == 0x7C00)
+	{
+		bits |= 0x7F800000;
+	}
+	else
+	{
+		float result;
+		std::memcpy(&result, &bits, sizeof(result));
+		result *= 0x1p112f;
+		std::memcpy(&bits, &result, sizeof(bits));
+	}
+	bits |= static_cast<uint32_t>(value & 0x8000) << 16;
+
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+static void convert_row_r8_unorm_to_float(const uint8_t *src, float *dst, size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+	{
+		dst[x * 4 + 0] = src[x] * (1.0f / 255.0f);
+		dst[x * 4 + 1] = 0.0f;
+		dst[x * 4 + 2] = 0.0f;
+		dst[x * 4 + 3] = 1.0f;
+	}
+}
+static void convert_row_r8g8_unorm_to_float(const uint8_t *src, float *dst, size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+	{
+		dst[x * 4 + 0] = src[x * 2 + 0] * (1.0f / 255.0f);
+		dst[x * 4 + 1] = src[x * 2 + 1] * (1.0f / 255.0f);
+		dst[x * 4 + 2] = 0.0f;
+		dst[x * 4 + 3] = 1.0f;
+	}
+}
+template <bool swap_rb, bool fill_alpha>
+static void convert_row_r8g8b8a8_unorm_to_float(const uint8_t *src, float *dst, size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+	{
+		dst[x * 4 + 0] = src[x * 4 + (swap_rb ? 2 : 0)] * (1.0f / 255.0f);
+		dst[x * 4 + 1] = src[x * 4 + 1] * (1.0f / 255.0f);
+		dst[x * 4 + 2] = src[x * 4 + (swap_rb ? 0 : 2)] * (1.0f / 255.0f);
+		dst[x * 4 + 3] = fill_alpha ? 1.0f : src[x * 4 + 3] * (1.0f / 255.0f);
+	}
+}
+template <bool swap_rb>
+static void convert_row_r10g10b10a2_unorm_to_float(const uint8_t *src, float *dst, size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+	{
+		uint32_t rgba;
+		std::memcpy(&rgba, src + x * 4, sizeof(rgba));
+		const float c0 = static_cast<float>( rgba        & 0x3FF) * (1.0f / 1023.0f);
+		const float c1 = static_cast<float>((rgba >> 10) & 0x3FF) * (1.0f / 1023.0f);
+		const float c2 = static_cast<float>((rgba >> 20) & 0x3FF) * (1.0f / 1023.0f);
+		dst[x * 4 + 0] = swap_rb ? c2 : c0;
+		dst[x * 4 + 1] = c1;
+		dst[x * 4 + 2] = swap_rb ? c0 : c2;
+		dst[x * 4 + 3] = static_cast<float>(rgba >> 30) * (1.0f / 3.0f);
+	}
+}
+static void convert_row_r16g16b16a16_unorm_to_float(const uint8_t *src, float *dst, size_t width)
+{
+	for (size_t x = 0; x < width * 4; ++x)
+	{
+		uint16_t value;
+		std::memcpy(&value, src + x * 2, sizeof(value));
+		dst[x] = static_cast<float>(value) * (1.0f / 65535.0f);
+	}
+}
+static void convert_row_r16g16b16a16_float_to_float(const uint8_t *src, float *dst, size_t width)
+{
+	for (size_t x = 0; x < width * 4; ++x)
+	{
+		uint16_t value;
+		std::memcpy(&value, src + x * 2, sizeof(value));
+		dst[x] = half_to_float_exact(value);
+	}
+}
+
+template <bool swap_rb>
+static void pack_row_r8g8b8a8_unorm_to_rgb(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+	{
+		// Read the whole pixel before writing, since the destination may overlap the source when packing in place
+		const uint8_t r = src[x * 4 + (swap_rb ? 2 : 0)];
+		const uint8_t g = src[x * 4 + 1];
+		const uint8_t b = src[x * 4 + (swap_rb ? 0 : 2)];
+		dst[x * 3 + 0] = r;
+		dst[x * 3 + 1] = g;
+		dst[x * 3 + 2] = b;
+	}
+}
+
+#if RESHADE_PIXEL_CONVERSION_SSE2
+
+// The vectorized variants below produce the exact same output as the scalar ones above, which are also used to convert the remaining pixels at the end of each row
+
+static void convert_row_r8_unorm_sse2(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha = _mm_set1_epi16(static_cast<short>(0xFF00));
+
+	size_t x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+		// Zero-extend to 16-bit, then interleave with 0x00 0xFF to get R 0 0 A
+		const __m128i r_lo = _mm_unpacklo_epi8(r, zero);
+		const __m128i r_hi = _mm_unpackhi_epi8(r, zero);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4 +  0), _mm_unpacklo_epi16(r_lo, alpha));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4 + 16), _mm_unpackhi_epi16(r_lo, alpha));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4 + 32), _mm_unpacklo_epi16(r_hi, alpha));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4 + 48), _mm_unpackhi_epi16(r_hi, alpha));
+	}
+
+	convert_row_r8_unorm(src + x, dst + x * 4, width - x);
+}
+static void convert_row_r8g8_unorm_sse2(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	const __m128i alpha = _mm_set1_epi16(static_cast<short>(0xFF00));
+
+	size_t x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		const __m128i rg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4 +  0), _mm_unpacklo_epi16(rg, alpha));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4 + 16), _mm_unpackhi_epi16(rg, alpha));
+	}
+
+	convert_row_r8g8_unorm(src + x * 2, dst + x * 4, width - x);
+}
+static void convert_row_r8g8b8x8_unorm_sse2(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+	size_t x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		const __m128i rgbx = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm_or_si128(rgbx, alpha));
+	}
+
+	convert_row_r8g8b8x8_unorm(src + x * 4, dst + x * 4, width - x);
+}
+template <bool fill_alpha>
+static void convert_row_b8g8r8a8_unorm_sse2(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	const __m128i mask_rb = _mm_set1_epi32(0x00FF00FF);
+	const __m128i mask_ga = _mm_set1_epi32(fill_alpha ? 0x0000FF00 : static_cast<int>(0xFF00FF00));
+	const __m128i alpha = _mm_set1_epi32(fill_alpha ? static_cast<int>(0xFF000000) : 0);
+
+	size_t x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		const __m128i bgra = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+		// Swap the blue and red bytes in each pixel by shifting them past each other
+		const __m128i rb = _mm_and_si128(bgra, mask_rb);
+		const __m128i br = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm_or_si128(_mm_or_si128(br, _mm_and_si128(bgra, mask_ga)), alpha));
+	}
+
+	if constexpr (fill_alpha)
+		convert_row_b8g8r8x8_unorm(src + x * 4, dst + x * 4, width - x);
+	else
+		convert_row_b8g8r8a8_unorm(src + x * 4, dst + x * 4, width - x);
+}
+template <bool swap_rb>
+static void convert_row_r10g10b10a2_unorm_sse2(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i alpha_scale = _mm_set1_epi32(85);
+
+	size_t x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		const __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+		// Drop the two least significant bits of each 10-bit channel to get into 8-bit range
+		const __m128i c0 = _mm_and_si128(_mm_srli_epi32(rgba,  2), mask);
+		const __m128i c1 = _mm_and_si128(_mm_srli_epi32(rgba, 12), mask);
+		const __m128i c2 = _mm_and_si128(_mm_srli_epi32(rgba, 22), mask);
+		// Alpha is in range 0-3, so a 16-bit multiplication is sufficient
+		const __m128i a = _mm_mullo_epi16(_mm_srli_epi32(rgba, 30), alpha_scale);
+		const __m128i r = swap_rb ? c2 : c0;
+		const __m128i b = swap_rb ? c0 : c2;
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm_or_si128(
+			_mm_or_si128(r, _mm_slli_epi32(c1, 8)),
+			_mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24))));
+	}
+
+	if constexpr (swap_rb)
+		convert_row_b10g10r10a2_unorm(src + x * 4, dst + x * 4, width - x);
+	else
+		convert_row_r10g10b10a2_unorm(src + x * 4, dst + x * 4, width - x);
+}
+static void convert_row_r16g16b16a16_unorm_sse2(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	size_t x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		const __m128i rgba0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 8 +  0));
+		const __m128i rgba1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 8 + 16));
+		// Keep the most significant byte of each channel
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm_packus_epi16(_mm_srli_epi16(rgba0, 8), _mm_srli_epi16(rgba1, 8)));
+	}
+
+	convert_row_r16g16b16a16_unorm(src + x * 8, dst + x * 4, width - x);
+}
+static void convert_row_r16g16b16a16_float_sse2(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i sign_mask = _mm_set1_epi32(0x8000);
+	const __m128i value_mask = _mm_set1_epi32(0x7FFF);
+	const __m128 exponent_rebias = _mm_set1_ps(0x1p112f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	// Color channels are quantized to index into the sRGB table, alpha is quantized to 8-bit directly
+	const __m128 scale = _mm_set_ps(255.0f, 4095.0f, 4095.0f, 4095.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	alignas(16) int32_t indices[8];
+
+	size_t x = 0;
+	for (; x + 2 <= width; x += 2)
+	{
+		const __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 8));
+
+		for (int i = 0; i < 2; ++i)
+		{
+			const __m128i h = (i == 0) ? _mm_unpacklo_epi16(rgba, zero) : _mm_unpackhi_epi16(rgba, zero);
+
+			// See 'half_to_float' above
+			__m128 c = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, value_mask), 13)), exponent_rebias);
+			c = _mm_and_ps(c, _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(h, sign_mask), zero)));
+			c = _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), one);
+
+			_mm_store_si128(reinterpret_cast<__m128i *>(indices + i * 4), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, scale), half)));
+		}
+
+		for (int i = 0; i < 8; ++i)
+			dst[x * 4 + i] = (i % 4) == 3 ? static_cast<uint8_t>(indices[i]) : s_linear_to_srgb.values[indices[i]];
+	}
+
+	convert_row_r16g16b16a16_float(src + x * 8, dst + x * 4, width - x);
+}
+
+
+template <bool swap_rb>
+static void convert_row_r10g10b10a2_unorm_to_float_sse2(const uint8_t *src, float *dst, size_t width)
+{
+	const __m128i mask = _mm_set1_epi32(0x3FF);
+	const __m128 color_scale = _mm_set1_ps(1.0f / 1023.0f);
+	const __m128 alpha_scale = _mm_set1_ps(1.0f / 3.0f);
+
+	size_t x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		const __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+		// Channels of four pixels each, which are then transposed into four pixels
+		__m128 c0 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(rgba, mask)), color_scale);
+		__m128 c1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(rgba, 10), mask)), color_scale);
+		__m128 c2 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(rgba, 20), mask)), color_scale);
+		__m128 a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(rgba, 30)), alpha_scale);
+		if constexpr (swap_rb)
+			std::swap(c0, c2);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, a);
+		_mm_storeu_ps(dst + x * 4 +  0, c0);
+		_mm_storeu_ps(dst + x * 4 +  4, c1);
+		_mm_storeu_ps(dst + x * 4 +  8, c2);
+		_mm_storeu_ps(dst + x * 4 + 12, a);
+	}
+
+	convert_row_r10g10b10a2_unorm_to_float<swap_rb>(src + x * 4, dst + x * 4, width - x);
+}
+static void convert_row_r16g16b16a16_unorm_to_float_sse2(const uint8_t *src, float *dst, size_t width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(1.0f / 65535.0f);
+
+	size_t x = 0;
+	for (; x + 2 <= width; x += 2)
+	{
+		const __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 8));
+		_mm_storeu_ps(dst + x * 4 + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(rgba, zero)), scale));
+		_mm_storeu_ps(dst + x * 4 + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(rgba, zero)), scale));
+	}
+
+	convert_row_r16g16b16a16_unorm_to_float(src + x * 8, dst + x * 4, width - x);
+}
+static inline __m128 half_to_float_exact_sse2(__m128i h)
+{
+	// See 'half_to_float_exact' above
+	const __m128i exponent_mask = _mm_set1_epi32(0x7C00);
+	const __m128i value = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7FFF)), 13);
+	const __m128i finite = _mm_castps_si128(_mm_mul_ps(_mm_castsi128_ps(value), _mm_set1_ps(0x1p112f)));
+	const __m128i infinite = _mm_or_si128(value, _mm_set1_epi32(0x7F800000));
+	const __m128i is_infinite = _mm_cmpeq_epi32(_mm_and_si128(h, exponent_mask), exponent_mask);
+	const __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+	return _mm_castsi128_ps(_mm_or_si128(_mm_or_si128(_mm_andnot_si128(is_infinite, finite), _mm_and_si128(is_infinite, infinite)), sign));
+}
+static void convert_row_r16g16b16a16_float_to_float_sse2(const uint8_t *src, float *dst, size_t width)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	size_t x = 0;
+	for (; x + 2 <= width; x += 2)
+	{
+		const __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 8));
+		_mm_storeu_ps(dst + x * 4 + 0, half_to_float_exact_sse2(_mm_unpacklo_epi16(rgba, zero)));
+		_mm_storeu_ps(dst + x * 4 + 4, half_to_float_exact_sse2(_mm_unpackhi_epi16(rgba, zero)));
+	}
+
+	convert_row_r16g16b16a16_float_to_float(src + x * 8, dst + x * 4, width - x);
+}
+
+template <bool swap_rb>
+static void pack_row_r8g8b8a8_unorm_to_rgb_sse2(const uint8_t *src, uint8_t *dst, size_t width)
+{
+	const __m128i mask_rb = _mm_set1_epi32(0x00FF00FF);
+	const __m128i mask_g = _mm_set1_epi32(0x0000FF00);
+	const __m128i mask_even = _mm_set1_epi64x(0x0000000000FFFFFF);
+	const __m128i mask_odd = _mm_set1_epi64x(0x0000FFFFFF000000);
+	const __m128i mask_lo = _mm_set_epi64x(0, 0x0000FFFFFFFFFFFF);
+	const __m128i mask_hi = _mm_set_epi64x(0x00000000FFFFFFFF, static_cast<int64_t>(0xFFFF000000000000));
+
+	// Each iteration stores 16 bytes, of which only the first 12 are valid, so stop early enough to not write past the end of the row
+	// Stores never reach source pixels that were not loaded yet, so this also works in place
+	size_t x = 0;
+	for (; x + 6 <= width; x += 4)
+	{
+		__m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+		if constexpr (swap_rb)
+		{
+			const __m128i rb = _mm_and_si128(rgba, mask_rb);
+			rgba = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16)), _mm_and_si128(rgba, mask_g));
+		}
+
+		// Move the odd pixel of each 64-bit half next to the even one, dropping alpha, so that each half has six bytes of RGB data
+		const __m128i rgb_halves = _mm_or_si128(_mm_and_si128(rgba, mask_even), _mm_and_si128(_mm_srli_epi64(rgba, 8), mask_odd));
+		// Then move the upper half next to the lower one
+		const __m128i rgb = _mm_or_si128(_mm_and_si128(rgb_halves, mask_lo), _mm_and_si128(_mm_srli_si128(rgb_halves, 2), mask_hi));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 3), rgb);
+	}
+
+	pack_row_r8g8b8a8_unorm_to_rgb<swap_rb>(src + x * 4, dst + x * 3, width - x);
+}
+
+#endif
+
+utils::convert_row_func utils::find_convert_row_to_rgba8(api::format format, bool allow_simd)
+{
+#if RESHADE_PIXEL_CONVERSION_SSE2
+	if (allow_simd)
+	{
+		switch (format)
+		{
+		case api::format::r8_unorm:
+			return convert_row_r8_unorm_sse2;
+		case api::format::r8g8_unorm:
+			return convert_row_r8g8_unorm_sse2;
+		case api::format::r8g8b8a8_unorm:
+			return convert_row_r8g8b8a8_unorm; // Already a plain copy
+		case api::format::r8g8b8x8_unorm:
+			return convert_row_r8g8b8x8_unorm_sse2;
+		case api::format::b8g8r8a8_unorm:
+			return convert_row_b8g8r8a8_unorm_sse2<false>;
+		case api::format::b8g8r8x8_unorm:
+			return convert_row_b8g8r8a8_unorm_sse2<true>;
+		case api::format::r10g10b10a2_unorm:
+			return convert_row_r10g10b10a2_unorm_sse2<false>;
+		case api::format::b10g10r10a2_unorm:
+			return convert_row_r10g10b10a2_unorm_sse2<true>;
+		case api::format::r16g16b16a16_unorm:
+			return convert_row_r16g16b16a16_unorm_sse2;
+		case api::format::r16g16b16a16_float:
+			return convert_row_r16g16b16a16_float_sse2;
+		default:
+			return nullptr;
+		}
+	}
+#else
+	(void)allow_simd;
+#endif
+
+	switch (format)
+	{
+	case api::format::r8_unorm:
+		return convert_row_r8_unorm;
+	case api::format::r8g8_unorm:
+		return convert_row_r8g8_unorm;
+	case api::format::r8g8b8a8_unorm:
+		return convert_row_r8g8b8a8_unorm;
+	case api::format::r8g8b8x8_unorm:
+		return convert_row_r8g8b8x8_unorm;
+	case api::format::b8g8r8a8_unorm:
+		return convert_row_b8g8r8a8_unorm;
+	case api::format::b8g8r8x8_unorm:
+		return convert_row_b8g8r8x8_unorm;
+	case api::format::r10g10b10a2_unorm:
+		return convert_row_r10g10b10a2_unorm;
+	case api::format::b10g10r10a2_unorm:
+		return convert_row_b10g10r10a2_unorm;
+	case api::format::r16g16b16a16_unorm:
+		return convert_row_r16g16b16a16_unorm;
+	case api::format::r16g16b16a16_float:
+		return convert_row_r16g16b16a16_float;
+	default:
+		return nullptr;
+	}
+}
+
+utils::convert_row_float_func utils::find_convert_row_to_rgba32f(api::format format, bool allow_simd)
+{
+#if RESHADE_PIXEL_CONVERSION_SSE2
+	if (allow_simd)
+	{
+		// Only the formats used for high dynamic range content have vectorized variants
+		switch (format)
+		{
+		case api::format::r10g10b10a2_unorm:
+			return convert_row_r10g10b10a2_unorm_to_float_sse2<false>;
+		case api::format::b10g10r10a2_unorm:
+			return convert_row_r10g10b10a2_unorm_to_float_sse2<true>;
+		case api::format::r16g16b16a16_unorm:
+			return convert_row_r16g16b16a16_unorm_to_float_sse2;
+		case api::format::r16g16b16a16_float:
+			return convert_row_r16g16b16a16_float_to_float_sse2;
+		default:
+			break;
+		}
+	}
+#else
+	(void)allow_simd;
+#endif
+
+	switch (format)
+	{
+	case api::format::r8_unorm:
+		return convert_row_r8_unorm_to_float;
+	case api::format::r8g8_unorm:
+		return convert_row_r8g8_unorm_to_float;
+	case api::format::r8g8b8a8_unorm:
+		return convert_row_r8g8b8a8_unorm_to_float<false, false>;
+	case api::format::r8g8b8x8_unorm:
+		return convert_row_r8g8b8a8_unorm_to_float<false, true>;
+	case api::format::b8g8r8a8_unorm:
+		return convert_row_r8g8b8a8_unorm_to_float<true, false>;
+	case api::format::b8g8r8x8_unorm:
+		return convert_row_r8g8b8a8_unorm_to_float<true, true>;
+	case api::format::r10g10b10a2_unorm:
+		return convert_row_r10g10b10a2_unorm_to_float<false>;
+	case api::format::b10g10r10a2_unorm:
+		return convert_row_r10g10b10a2_unorm_to_float<true>;
+	case api::format::r16g16b16a16_unorm:
+		return convert_row_r16g16b16a16_unorm_to_float;
+	case api::format::r16g16b16a16_float:
+		return convert_row_r16g16b16a16_float_to_float;
+	default:
+		return nullptr;
+	}
+}
+
+utils::convert_row_func utils::find_pack_row_to_rgb8(api::format format, bool allow_simd)
+{
+#if RESHADE_PIXEL_CONVERSION_SSE2
+	if (allow_simd)
+	{
+		switch (format)
+		{
+		case api::format::r8g8b8a8_unorm:
+		case api::format::r8g8b8x8_unorm:
+			return pack_row_r8g8b8a8_unorm_to_rgb_sse2<false>;
+		case api::format::b8g8r8a8_unorm:
+		case api::format::b8g8r8x8_unorm:
+			return pack_row_r8g8b8a8_unorm_to_rgb_sse2<true>;
+		default:
+			return nullptr;
+		}
+	}
+#else
+	(void)allow_simd;
+#endif
+
+	switch (format)
+	{
+	case api::format::r8g8b8a8_unorm:
+	case api::format::r8g8b8x8_unorm:
+		return pack_row_r8g8b8a8_unorm_to_rgb<false>;
+	case api::format::b8g8r8a8_unorm:
+	case api::format::b8g8r8x8_unorm:
+		return pack_row_r8g8b8a8_unorm_to_rgb<true>;
+	default:
+		return nullptr;
+	}
+}
+
+void utils::pack_rgba8_to_rgb8(uint8_t *pixels, size_t width, size_t height)
+{
+	const convert_row_func pack_row = find_pack_row_to_rgb8(api::format::r8g8b8a8_unorm);
+
+	// Only split large images, since starting threads costs more than packing a few rows
+	constexpr size_t min_pixels_per_split = 1 << 20;
+	const size_t num_splits = std::max<size_t>(1, std::min({ height, static_cast<size_t>(std::thread::hardware_concurrency()), (width * height) / min_pixels_per_split }));
+
+	// Each batch of rows is packed in place to the start of its own memory range first, so that batches never touch each other's pixels
+	const auto pack_batch = [pixels, width, height, num_splits, pack_row](size_t n) {
+		const size_t first_row = height * n / num_splits;
+		const size_t last_row = height * (n + 1) / num_splits;
+
+		uint8_t *const batch_start = pixels + first_row * width * 4;
+		for (size_t y = first_row; y < last_row; ++y)
+			pack_row(pixels + y * width * 4, batch_start + (y - first_row) * width * 3, width);
+	};
+
+	if (num_splits > 1)
+	{
+		std::vector<std::thread> pack_threads;
+		pack_threads.reserve(num_splits - 1);
+		for (size_t n = 1; n < num_splits; ++n)
+			pack_threads.emplace_back(pack_batch, n);
+
+		// Make use of this thread as well while waiting for the others
+		pack_batch(0);
+
+		for (std::thread &thread : pack_threads)
+			thread.join();
+
+		// Then move the packed batches next to each other, in order, so that a move only overwrites memory of batches that were already moved
+		for (size_t n = 1; n < num_splits; ++n)
+		{
+			const size_t first_row = height * n / num_splits;
+			const size_t last_row = height * (n + 1) / num_splits;
+
+			std::memmove(pixels + first_row * width * 3, pixels + first_row * width * 4, (last_row - first_row) * width * 3);
+		}
+	}
+	else
+	{
+		pack_batch(0);
+	}
+}
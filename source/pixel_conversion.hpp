@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2014 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "reshade_api_format.hpp"
+#include <cstddef>
+
+namespace reshade::utils
+{
+	/// <summary>
+	/// Function that converts a row of <paramref name="width"/> pixels from <paramref name="src"/> to 8-bit RGBA (or RGB) in <paramref name="dst"/>.
+	/// </summary>
+	using convert_row_func = void(*)(const uint8_t *src, uint8_t *dst, size_t width);
+
+	/// <summary>
+	/// Gets the function that converts rows of pixels in the specified format to 8-bit RGBA, or <see langword="nullptr"/> if conversion from that format is not supported.
+	/// Floating-point formats are treated as linear and are encoded to sRGB, with values outside [0, 1] clamped.
+	/// </summary>
+	/// <param name="format">Format of the source pixels.</param>
+	/// <param name="allow_simd">Set to <see langword="false"/> to get the scalar reference implementation.</param>
+	convert_row_func find_convert_row_to_rgba8(api::format format, bool allow_simd = true);
+
+	/// <summary>
+	/// Function that converts a row of <paramref name="width"/> pixels from <paramref name="src"/> to 32-bit floating-point RGBA in <paramref name="dst"/>.
+	/// </summary>
+	using convert_row_float_func = void(*)(const uint8_t *src, float *dst, size_t width);
+
+	/// <summary>
+	/// Gets the function that converts rows of pixels in the specified format to 32-bit floating-point RGBA, or <see langword="nullptr"/> if conversion from that format is not supported.
+	/// Values are preserved as stored, i.e. normalized formats are mapped to [0, 1] and floating-point formats keep their full range (including negative values, infinity and NaN).
+	/// </summary>
+	/// <param name="format">Format of the source pixels.</param>
+	/// <param name="allow_simd">Set to <see langword="false"/> to get the scalar reference implementation.</param>
+	convert_row_float_func find_convert_row_to_rgba32f(api::format format, bool allow_simd = true);
+
+	/// <summary>
+	/// Gets the function that packs rows of pixels in the specified format to tightly packed 8-bit RGB by dropping the alpha channel, or <see langword="nullptr"/> if packing from that format is not supported.
+	/// The destination may be the same as the source, or start before it, to pack a row in place.
+	/// </summary>
+	/// <param name="format">Format of the source pixels, which has to have four 8-bit channels.</param>
+	/// <param name="allow_simd">Set to <see langword="false"/> to get the scalar reference implementation.</param>
+	convert_row_func find_pack_row_to_rgb8(api::format format, bool allow_simd = true);
+
+	/// <summary>
+	/// Packs an image of tightly packed 8-bit RGBA pixels to tightly packed 8-bit RGB pixels in place, splitting the work across multiple threads for large images.
+	/// </summary>
+	/// <param name="pixels">Pixel data of the image, which afterwards starts with the <paramref name="width"/> * <paramref name="height"/> * 3 bytes of RGB data.</param>
+	void pack_rgba8_to_rgb8(uint8_t *pixels, size_t width, size_t height);
+}
@@ -17,6 +17,7 @@
 #include "input_gamepad.hpp"
 #include "com_ptr.hpp"
 #include "platform_utils.hpp"
+#include "pixel_conversion.hpp"
 #include "reshade_api_object_impl.hpp"
 #include <set>
 #include <thread>
@@ -25,9 +26,9 @@
 #include <cctype> // std::toupper
 #include <cwctype> // std::towlower
 #include <cstdlib> // std::malloc, std::rand, std::strtod, std::strtol
-#include <cstring> // std::memcpy, std::memset, std::strlen
+#include <cstring> // std::memcmp, std::memcpy, std::memset, std::strlen
 #include <charconv> // std::to_chars
-#include <algorithm> // std::all_of, std::copy_n, std::equal, std::fill_n, std::find, std::find_if, std::for_each, std::max, std::min, std::replace, std::remove, std::remove_if, std::reverse, std::search, std::sort, std::stable_sort, std::swap, std::transform
+#include <algorithm> // std::all_of, std::copy_n, std::count_if, std::equal, std::fill_n, std::find, std::find_if, std::for_each, std::max, std::min, std::none_of, std::replace, std::remove, std::remove_if, std::reverse, std::rotate, std::search, std::sort, std::stable_sort, std::swap, std::transform
 #include <fpng.h>
 #include <stb_image.h>
 #include <stb_image_dds.h>
@@ -35,6 +36,13 @@
 #include <stb_image_resize2.h>
 #include <d3dcompiler.h>
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+	#define RESHADE_UNIFORM_LERP_SSE 1
+	#include <xmmintrin.h>
+#else
+	#define RESHADE_UNIFORM_LERP_SSE 0
+#endif
+
 bool resolve_path(std::filesystem::path &path, std::error_code &ec)
 {
 	// First convert path to an absolute path
@@ -173,6 +181,39 @@ static std::vector<std::filesystem::path> find_files(const std::vector<std::file
 	return files;
 }
 
+// Linearly interpolates between two arrays of floating-point values, used to blend uniform data during preset transitions
+static void lerp_float_data(float *dst, const float *a, const float *b, size_t count, float t)
+{
+	size_t i = 0;
+#if RESHADE_UNIFORM_LERP_SSE
+	const __m128 t4 = _mm_set1_ps(t);
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 a4 = _mm_loadu_ps(a + i);
+		const __m128 b4 = _mm_loadu_ps(b + i);
+		_mm_storeu_ps(dst + i, _mm_add_ps(a4, _mm_mul_ps(_mm_sub_ps(b4, a4), t4)));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = a[i] + (b[i] - a[i]) * t;
+}
+
+static size_t calc_spec_constant_preset_hash(const reshadefx::effect_module &module, const std::string &effect_name, const ini_file &preset)
+{
+	// Hash the raw preset values, so that constants missing from the preset (which fall back to their default value) are detected as well
+	size_t hash = 0;
+	for (const reshadefx::uniform_info &constant : module.spec_constants)
+	{
+		std::vector<std::string> values;
+		preset.get(effect_name, constant.name, values);
+
+		hash ^= std::hash<std::string>()(constant.name) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		for (const std::string &value : values)
+			hash ^= std::hash<std::string>()(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+	return hash;
+}
+
 static int format_color_bit_depth(reshade::api::format value)
 {
 	switch (value)
@@ -269,7 +310,7 @@ reshade::runtime::runtime(api::swapchain *swapchain, api::command_queue *graphic
 	// Default shortcut PrtScrn
 	_screenshot_key_data[0] = 0x2C;
 
-#if RESHADE_GUI && RESHADE_FX
+#if RESHADE_FX
 	_timestamp_frequency = graphics_queue->get_timestamp_frequency();
 #endif
 
@@ -287,9 +328,9 @@ reshade::runtime::runtime(api::swapchain *swapchain, api::command_queue *graphic
 }
 reshade::runtime::~runtime()
 {
-	assert(_worker_threads.empty());
+	assert(_worker_threads.empty() && _screenshot_job_threads.empty());
 #if RESHADE_FX
-	assert(!_is_initialized && _techniques.empty() && _technique_sorting.empty());
+	assert(!_is_initialized && _techniques.empty() && _technique_sorting.empty() && _lazy_compile_threads.empty());
 #endif
 
 #if RESHADE_GUI
@@ -575,6 +616,25 @@ void reshade::runtime::on_reset()
 	else
 		return; // Nothing to do if the runtime was already destroyed or not successfully initialized in the first place
 
+	// Stop capturing any further frames, since the back buffer is about to be destroyed
+	if (_screenshot_burst != nullptr)
+		end_screenshot_burst();
+
+	// Complete any outstanding readbacks, so that pending screenshots are still saved
+	process_texture_readbacks(true);
+	// Then wait for them to be written to disk
+	finish_screenshot_jobs();
+
+	for (texture_readback &slot : _readback_slots)
+	{
+		_device->destroy_resource(slot.intermediate);
+		slot = {};
+	}
+	_readback_next_slot = 0;
+
+	_device->destroy_fence(_readback_fence);
+	_readback_fence = {};
+
 #if RESHADE_FX
 	// Already performs a wait for idle, so no need to do it again before destroying resources below
 	destroy_effects();
@@ -667,6 +727,9 @@ void reshade::runtime::on_present(api::command_queue *present_queue)
 		}
 	}
 
+	// Complete readbacks from previous frames the GPU has finished with by now, without stalling
+	process_texture_readbacks();
+
 #if RESHADE_ADDON
 	_is_in_present_call = true;
 #endif
@@ -726,11 +789,25 @@ void reshade::runtime::on_present(api::command_queue *present_queue)
 
 	if (_should_save_screenshot)
 		save_screenshot();
+	if (_screenshot_burst != nullptr)
+		capture_screenshot_burst_frame();
 
 	_frame_count++;
+#if RESHADE_FX
+	std::copy_n(_effect_bind_calls, 2, _last_effect_bind_calls);
+	std::fill_n(_effect_bind_calls, 2, 0u);
+
+	// Wait for the GPU timings of the last captured frame to be read back before saving the capture
+	if (_timing_capture_last_frame != 0 && _frame_count >= _timing_capture_last_frame + 4)
+		save_timing_capture();
+#endif
 	const auto current_time = std::chrono::high_resolution_clock::now();
 	_last_frame_duration = current_time - _last_present_time; _last_present_time = current_time;
 
+#if RESHADE_FX
+	update_performance_governor();
+#endif
+
 #if RESHADE_GUI
 	// Draw overlay
 	if (_is_vr)
@@ -767,6 +844,13 @@ void reshade::runtime::on_present(api::command_queue *present_queue)
 			_screenshot_count++;
 			_should_save_screenshot = true; // Remember that we want to save a screenshot next frame
 		}
+		if (_input->is_key_pressed(_screenshot_burst_key_data, _force_shortcut_modifiers))
+		{
+			if (_screenshot_burst == nullptr)
+				begin_screenshot_burst();
+			else
+				end_screenshot_burst(); // Pressing the key again stops an ongoing capture early
+		}
 
 #if RESHADE_FX
 		// Do not allow the following shortcuts while effects are being loaded or initialized (since they affect that state)
@@ -972,7 +1056,7 @@ void reshade::runtime::on_present(api::command_queue *present_queue)
 
 			for (const auto &info : _backup_texture_semantic_bindings)
 			{
-				if (info.second.first == _effect_color_srv[0] && info.second.second == _effect_color_srv[1])
+				if ((info.second.first == _effect_color_srv[0] && info.second.second == _effect_color_srv[1]))
 					continue;
 
 				update_texture_bindings(info.first.c_str(), addon_enabled ? info.second.first : api::resource_view { 0 }, addon_enabled ? info.second.second : api::resource_view { 0 });
@@ -1004,6 +1088,7 @@ void reshade::runtime::load_config()
 
 	config_get("INPUT", "ForceShortcutModifiers", _force_shortcut_modifiers);
 	config_get("INPUT", "KeyScreenshot", _screenshot_key_data);
+	config_get("INPUT", "KeyScreenshotBurst", _screenshot_burst_key_data);
 #if RESHADE_FX
 	config_get("INPUT", "KeyEffects", _effects_key_data);
 	config_get("INPUT", "KeyNextPreset", _next_preset_key_data);
@@ -1017,8 +1102,12 @@ void reshade::runtime::load_config()
 
 	config_get("GENERAL", "EffectSearchPaths", _effect_search_paths);
 	config_get("GENERAL", "PerformanceMode", _performance_mode);
+	config_get("GENERAL", "PerformanceModePermutationCacheSize", _effect_permutation_cache_size);
 	config_get("GENERAL", "PreprocessorDefinitions", _global_preprocessor_definitions);
 	config_get("GENERAL", "SkipLoadingDisabledEffects", _effect_load_skipping);
+	config_get("GENERAL", "LazyEffectLoading", _effect_load_lazy);
+	config_get("GENERAL", "AliasTransientTextures", _alias_transient_textures);
+	config_get("GENERAL", "FrameTimeBudget", _frame_time_budget);
 	config_get("GENERAL", "TextureSearchPaths", _texture_search_paths);
 	config_get("GENERAL", "IntermediateCachePath", _effect_cache_path);
 
@@ -1064,6 +1153,7 @@ void reshade::runtime::load_config()
 	config_get("SCREENSHOT", "FileFormat", _screenshot_format);
 	config_get("SCREENSHOT", "FileNaming", _screenshot_name);
 	config_get("SCREENSHOT", "JPEGQuality", _screenshot_jpeg_quality);
+	config_get("SCREENSHOT", "BurstFrameCount", _screenshot_burst_frame_count);
 #if RESHADE_FX
 	config_get("SCREENSHOT", "SaveBeforeShot", _screenshot_save_before);
 	config_get("SCREENSHOT", "SavePresetFile", _screenshot_include_preset);
@@ -1086,6 +1176,7 @@ void reshade::runtime::save_config() const
 
 	config.set("INPUT", "ForceShortcutModifiers", _force_shortcut_modifiers);
 	config.set("INPUT", "KeyScreenshot", _screenshot_key_data);
+	config.set("INPUT", "KeyScreenshotBurst", _screenshot_burst_key_data);
 #if RESHADE_FX
 	config.set("INPUT", "KeyEffects", _effects_key_data);
 	config.set("INPUT", "KeyNextPreset", _next_preset_key_data);
@@ -1099,8 +1190,12 @@ void reshade::runtime::save_config() const
 
 	config.set("GENERAL", "EffectSearchPaths", _effect_search_paths);
 	config.set("GENERAL", "PerformanceMode", _performance_mode);
+	config.set("GENERAL", "PerformanceModePermutationCacheSize", _effect_permutation_cache_size);
 	config.set("GENERAL", "PreprocessorDefinitions", _global_preprocessor_definitions);
 	config.set("GENERAL", "SkipLoadingDisabledEffects", _effect_load_skipping);
+	config.set("GENERAL", "LazyEffectLoading", _effect_load_lazy);
+	config.set("GENERAL", "AliasTransientTextures", _alias_transient_textures);
+	config.set("GENERAL", "FrameTimeBudget", _frame_time_budget);
 	config.set("GENERAL", "TextureSearchPaths", _texture_search_paths);
 	config.set("GENERAL", "IntermediateCachePath", _effect_cache_path);
 
@@ -1132,6 +1227,7 @@ void reshade::runtime::save_config() const
 	config.set("SCREENSHOT", "FileFormat", _screenshot_format);
 	config.set("SCREENSHOT", "FileNaming", _screenshot_name);
 	config.set("SCREENSHOT", "JPEGQuality", _screenshot_jpeg_quality);
+	config.set("SCREENSHOT", "BurstFrameCount", _screenshot_burst_frame_count);
 #if RESHADE_FX
 	config.set("SCREENSHOT", "SaveBeforeShot", _screenshot_save_before);
 	config.set("SCREENSHOT", "SavePresetFile", _screenshot_include_preset);
@@ -1172,8 +1268,9 @@ void reshade::runtime::load_current_preset()
 		if (_performance_mode || preset_preprocessor_definitions != _preset_preprocessor_definitions)
 		{
 			_preset_preprocessor_definitions = std::move(preset_preprocessor_definitions);
-			reload_effects();
-			return; // Preset values are loaded in 'update_effects' during effect loading
+			// Only recompile those effects that actually reference any of the changed definitions or preset values
+			if (reload_changed_effects())
+				return; // Preset values are loaded in 'update_effects' during effect loading
 		}
 
 		if (std::find_if(technique_list.cbegin(), technique_list.cend(),
@@ -1185,7 +1282,7 @@ void reshade::runtime::load_current_preset()
 						[effect_name = std::filesystem::u8path(technique_name.substr(at_pos + 1))](const effect &effect) {
 							return effect_name == effect.source_file.filename();
 						});
-					return it != _effects.cend() && it->skipped;
+					return it != _effects.cend() && it->skipped && !_effect_load_lazy; // Lazily loaded effects are compiled on demand when their techniques are enabled below
 				}) != technique_list.cend())
 		{
 			reload_effects();
@@ -1244,24 +1341,67 @@ void reshade::runtime::load_current_preset()
 	// Compute times since the transition has started and how much is left till it should end
 	auto transition_time = std::chrono::duration_cast<std::chrono::microseconds>(_last_present_time - _last_preset_switching_time).count();
 	auto transition_ms_left = _preset_transition_duration - transition_time / 1000;
-	auto transition_ms_left_from_last_frame = transition_ms_left + std::chrono::duration_cast<std::chrono::microseconds>(_last_frame_duration).count() / 1000;
 
 	if (_is_in_preset_transition && transition_ms_left <= 0)
 		_is_in_preset_transition = false;
 
-	for (effect &effect : _effects)
+	// Effects were reloaded since the snapshots were taken, so the uniform indices stored in them are no longer valid
+	if (const uint64_t uniforms_version = _effect_uniforms_version.load(); _preset_snapshots_uniforms_version != uniforms_version)
 	{
-		const std::string effect_name = effect.source_file.filename().u8string();
+		_preset_snapshots.clear();
+		_preset_snapshots_uniforms_version = uniforms_version;
+		_preset_transition_start_time = {};
+	}
 
-		for (uniform &variable : effect.uniforms)
+	// Blend between the uniform data at the start of the transition and the data with all preset values applied
+	const auto transition_uniform_data = [this, transition_factor = static_cast<float>(transition_time) / (_preset_transition_duration * 1000.0f)]() {
+		for (effect &effect : _effects)
 		{
-			if (variable.special != special_uniform::none ||
-				variable.annotation_as_uint("nosave"))
-				continue;
+			for (const std::pair<uint32_t, uint32_t> &range : effect.preset_transition_ranges)
+			{
+				lerp_float_data(
+					reinterpret_cast<float *>(effect.uniform_data_storage.data() + range.first),
+					reinterpret_cast<const float *>(effect.preset_transition_start_data.data() + range.first),
+					reinterpret_cast<const float *>(effect.preset_transition_target_data.data() + range.first),
+					(range.second - range.first) / 4,
+					transition_factor);
+
+				effect.mark_uniform_data_modified(range.first, range.second - range.first);
+			}
+		}
+	};
+
+	if (_is_in_preset_transition && _preset_transition_start_time == _last_preset_switching_time)
+	{
+		// Every other value was already applied when the transition started, so only need to continue blending the ranges that differ
+		transition_uniform_data();
+	}
+	else
+	{
+		_preset_transition_start_time = _last_preset_switching_time;
+
+		for (effect &effect : _effects)
+		{
+			effect.preset_transition_ranges.clear();
+
+			if (_is_in_preset_transition)
+				effect.preset_transition_start_data = effect.uniform_data_storage;
+			else
+			{
+				effect.preset_transition_start_data.clear();
+				effect.preset_transition_target_data.clear();
+			}
+		}
+
+		for (const preset_snapshot_value &target : get_preset_snapshot(preset).values)
+		{
+			uniform &variable = _effects[target.effect_index].uniforms[target.uniform_index];
 
 			if (variable.supports_toggle_key())
 			{
-				if (!preset.get(effect_name, "Key" + variable.name, variable.toggle_key_data))
+				if (target.has_toggle_key)
+					std::memcpy(variable.toggle_key_data, target.toggle_key_data, sizeof(variable.toggle_key_data));
+				else
 					std::memset(variable.toggle_key_data, 0, sizeof(variable.toggle_key_data));
 			}
 
@@ -1269,38 +1409,53 @@ void reshade::runtime::load_current_preset()
 			if (!_is_in_preset_transition)
 				reset_uniform_value(variable);
 
-			reshadefx::constant values, values_old;
+			if (!target.has_value)
+				continue;
 
 			switch (variable.type.base)
 			{
 			case reshadefx::type::t_int:
-				get_uniform_value(variable, values.as_int, variable.type.components());
-				preset.get(effect_name, variable.name, values.as_int);
-				set_uniform_value(variable, values.as_int, variable.type.components());
+				set_uniform_value(variable, target.value.as_int, variable.type.components());
 				break;
 			case reshadefx::type::t_bool:
 			case reshadefx::type::t_uint:
-				get_uniform_value(variable, values.as_uint, variable.type.components());
-				preset.get(effect_name, variable.name, values.as_uint);
-				set_uniform_value(variable, values.as_uint, variable.type.components());
+				set_uniform_value(variable, target.value.as_uint, variable.type.components());
 				break;
 			case reshadefx::type::t_float:
-				get_uniform_value(variable, values.as_float, variable.type.components());
-				values_old = values;
-				preset.get(effect_name, variable.name, values.as_float);
+				set_uniform_value(variable, target.value.as_float, variable.type.components());
+
 				if (_is_in_preset_transition)
 				{
-					// Perform smooth transition on floating point values
-					for (unsigned int i = 0; i < variable.type.components(); i++)
-					{
-						const float value_left = (values.as_float[i] - values_old.as_float[i]);
-						values.as_float[i] -= (value_left / transition_ms_left_from_last_frame) * transition_ms_left;
-					}
+					effect &effect = _effects[variable.effect_index];
+
+					if (std::memcmp(effect.preset_transition_start_data.data() + variable.offset, effect.uniform_data_storage.data() + variable.offset, variable.size) == 0)
+						break;
+
+					// Merge with the previous range if adjacent, since float variables are often declared next to each other
+					if (!effect.preset_transition_ranges.empty() && effect.preset_transition_ranges.back().second == variable.offset)
+						effect.preset_transition_ranges.back().second += variable.size;
+					else
+						effect.preset_transition_ranges.emplace_back(variable.offset, variable.offset + variable.size);
 				}
-				set_uniform_value(variable, values.as_float, variable.type.components());
 				break;
 			}
 		}
+
+		if (_is_in_preset_transition)
+		{
+			for (effect &effect : _effects)
+			{
+				if (effect.preset_transition_ranges.empty())
+				{
+					effect.preset_transition_start_data.clear();
+					continue;
+				}
+
+				effect.preset_transition_target_data = effect.uniform_data_storage;
+			}
+
+			transition_uniform_data();
+		}
 	}
 
 	for (technique &tech : _techniques)
@@ -1323,6 +1478,74 @@ void reshade::runtime::load_current_preset()
 	// Reverse queue so that effects are enabled in the order they are defined in the preset (since the queue is worked from back to front)
 	std::reverse(_reload_create_queue.begin(), _reload_create_queue.end());
 }
+
+// Only the presets of the current transition and a few recently switched between are needed, so do not keep snapshots of every preset ever loaded around
+static constexpr size_t s_max_preset_snapshots = 4;
+
+const reshade::runtime::preset_snapshot &reshade::runtime::get_preset_snapshot(const ini_file &preset)
+{
+	if (const auto it = std::find_if(_preset_snapshots.begin(), _preset_snapshots.end(),
+			[&preset](const preset_snapshot &item) { return item.preset_path == preset.path(); });
+		it != _preset_snapshots.end())
+	{
+		// Move to the front, so that it is evicted last
+		std::rotate(_preset_snapshots.begin(), it, it + 1);
+	}
+	else
+	{
+		// Evict the least recently used snapshot once the limit is reached
+		if (_preset_snapshots.size() >= s_max_preset_snapshots)
+			_preset_snapshots.pop_back();
+
+		_preset_snapshots.insert(_preset_snapshots.begin(), preset_snapshot { preset.path() });
+	}
+
+	preset_snapshot &snapshot = _preset_snapshots.front();
+	if (snapshot.preset_version == preset.version())
+		return snapshot;
+
+	snapshot.preset_version = preset.version();
+	snapshot.values.clear();
+
+	for (size_t effect_index = 0; effect_index < _effects.size(); ++effect_index)
+	{
+		const effect &effect = _effects[effect_index];
+		const std::string effect_name = effect.source_file.filename().u8string();
+
+		for (size_t uniform_index = 0; uniform_index < effect.uniforms.size(); ++uniform_index)
+		{
+			const uniform &variable = effect.uniforms[uniform_index];
+
+			if (variable.special != special_uniform::none ||
+				variable.annotation_as_uint("nosave"))
+				continue;
+
+			preset_snapshot_value &value = snapshot.values.emplace_back();
+			value.effect_index = effect_index;
+			value.uniform_index = uniform_index;
+
+			if (variable.supports_toggle_key())
+				value.has_toggle_key = preset.get(effect_name, "Key" + variable.name, value.toggle_key_data);
+
+			switch (variable.type.base)
+			{
+			case reshadefx::type::t_int:
+				value.has_value = preset.get(effect_name, variable.name, value.value.as_int);
+				break;
+			case reshadefx::type::t_bool:
+			case reshadefx::type::t_uint:
+				value.has_value = preset.get(effect_name, variable.name, value.value.as_uint);
+				break;
+			case reshadefx::type::t_float:
+				value.has_value = preset.get(effect_name, variable.name, value.value.as_float);
+				break;
+			}
+		}
+	}
+
+	return snapshot;
+}
+
 void reshade::runtime::save_current_preset() const
 {
 	ini_file &preset = ini_file::load_cache(_current_preset_path);
@@ -1499,24 +1722,8 @@ bool reshade::runtime::switch_to_next_preset(std::filesystem::path filter_path,
 	return true;
 }
 
-bool reshade::runtime::load_effect(const std::filesystem::path &source_file, const ini_file &preset, size_t effect_index, bool force_load, bool preprocess_required)
+std::vector<std::pair<std::string, std::string>> reshade::runtime::get_effect_preprocessor_definitions(const std::string &effect_name) const
 {
-	const std::chrono::high_resolution_clock::time_point time_load_started = std::chrono::high_resolution_clock::now();
-
-	// Generate a unique string identifying this effect
-	std::string attributes;
-	attributes += "app=" + g_target_executable_path.stem().u8string() + ';';
-	attributes += "width=" + std::to_string(_effect_width) + ';';
-	attributes += "height=" + std::to_string(_effect_height) + ';';
-	attributes += "color_space=" + std::to_string(static_cast<uint32_t>(_back_buffer_color_space)) + ';';
-	attributes += "color_bit_depth=" + std::to_string(format_color_bit_depth(_effect_color_format)) + ';';
-	attributes += "version=" + std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION) + ';';
-	attributes += "performance_mode=" + std::string(_performance_mode ? "1" : "0") + ';';
-	attributes += "vendor=" + std::to_string(_vendor_id) + ';';
-	attributes += "device=" + std::to_string(_device_id) + ';';
-
-	const std::string effect_name = source_file.filename().u8string();
-
 	std::vector<std::pair<std::string, std::string>> preprocessor_definitions = _global_preprocessor_definitions;
 	// Insert preset preprocessor definitions before global ones, so that if there are duplicates, the preset ones are used (since 'add_macro_definition' succeeds only for the first occurance)
 	if (const auto preset_it = _preset_preprocessor_definitions.find({});
@@ -1527,8 +1734,6 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		preprocessor_definitions.insert(preprocessor_definitions.begin(), preset_it->second.cbegin(), preset_it->second.cend());
 
 #if RESHADE_ADDON
-	std::vector<std::string> addon_definitions;
-	addon_definitions.reserve(addon_loaded_info.size());
 	for (const addon_info &info : addon_loaded_info)
 	{
 		std::string addon_definition;
@@ -1540,6 +1745,94 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 	}
 #endif
 
+	return preprocessor_definitions;
+}
+
+static reshade::special_uniform_updates build_special_uniform_updates(const std::vector<reshade::uniform> &uniforms)
+{
+	using reshade::special_uniform;
+	using key_mode = reshade::special_uniform_updates::key_mode;
+
+	reshade::special_uniform_updates updates;
+
+	for (size_t uniform_index = 0; uniform_index < uniforms.size(); ++uniform_index)
+	{
+		const reshade::uniform &variable = uniforms[uniform_index];
+
+		int keycode = 0;
+		key_mode mode = key_mode::down;
+		float min = 0.0f, max = 0.0f, step_min = 0.0f, step_max = 0.0f;
+
+		switch (variable.special)
+		{
+		case special_uniform::none:
+		case special_uniform::unknown:
+			continue;
+		case special_uniform::key:
+		case special_uniform::mouse_button:
+			keycode = variable.annotation_as_int("keycode");
+			// Skip variables with an invalid key code, since they would never be updated anyway
+			if (variable.special == special_uniform::key ? (keycode <= 7 || keycode >= 256) : (keycode < 0 || keycode >= 5))
+				continue;
+			if (const std::string_view mode_name = variable.annotation_as_string("mode");
+				mode_name == "toggle" || variable.annotation_as_int("toggle"))
+				mode = key_mode::toggle;
+			else if (mode_name == "press")
+				mode = key_mode::press;
+			break;
+		case special_uniform::ping_pong:
+			min = variable.annotation_as_float("min", 0, 0.0f);
+			max = variable.annotation_as_float("max", 0, 1.0f);
+			step_min = variable.annotation_as_float("step", 0);
+			step_max = variable.annotation_as_float("step", 1);
+			break;
+		case special_uniform::mouse_wheel:
+			min = variable.annotation_as_float("min");
+			max = variable.annotation_as_float("max");
+			step_min = variable.annotation_as_float("step");
+			if (step_min == 0.0f)
+				step_min = 1.0f;
+			break;
+		default:
+			break;
+		}
+
+		updates.uniform_index.push_back(static_cast<uint32_t>(uniform_index));
+		updates.type.push_back(variable.special);
+		updates.keycode.push_back(keycode);
+		updates.mode.push_back(mode);
+		updates.int_min.push_back(variable.special == special_uniform::random ? variable.annotation_as_int("min", 0, 0) : 0);
+		updates.int_max.push_back(variable.special == special_uniform::random ? variable.annotation_as_int("max", 0, RAND_MAX) : 0);
+		updates.min.push_back(min);
+		updates.max.push_back(max);
+		updates.step_min.push_back(step_min);
+		updates.step_max.push_back(step_max);
+		updates.smoothing.push_back(variable.special == special_uniform::ping_pong ? variable.annotation_as_float("smoothing") : 0.0f);
+	}
+
+	return updates;
+}
+
+bool reshade::runtime::load_effect(const std::filesystem::path &source_file, const ini_file &preset, size_t effect_index, bool force_load, bool preprocess_required)
+{
+	const std::chrono::high_resolution_clock::time_point time_load_started = std::chrono::high_resolution_clock::now();
+
+	// Generate a unique string identifying this effect
+	std::string attributes;
+	attributes += "app=" + g_target_executable_path.stem().u8string() + ';';
+	attributes += "width=" + std::to_string(_effect_width) + ';';
+	attributes += "height=" + std::to_string(_effect_height) + ';';
+	attributes += "color_space=" + std::to_string(static_cast<uint32_t>(_back_buffer_color_space)) + ';';
+	attributes += "color_bit_depth=" + std::to_string(format_color_bit_depth(_effect_color_format)) + ';';
+	attributes += "version=" + std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION) + ';';
+	attributes += "performance_mode=" + std::string(_performance_mode ? "1" : "0") + ';';
+	attributes += "vendor=" + std::to_string(_vendor_id) + ';';
+	attributes += "device=" + std::to_string(_device_id) + ';';
+
+	const std::string effect_name = source_file.filename().u8string();
+
+	const std::vector<std::pair<std::string, std::string>> preprocessor_definitions = get_effect_preprocessor_definitions(effect_name);
+
 	for (const std::pair<std::string, std::string> &definition : preprocessor_definitions)
 		attributes += definition.first + '=' + definition.second + ';';
 
@@ -1589,9 +1882,9 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 	effect &effect = _effects[effect_index];
 
 	const size_t source_hash = std::hash<std::string>()(attributes);
-	if (source_file != effect.source_file || source_hash != effect.source_hash)
+	if (source_file != effect.source_file || source_hash != effect.source_hash || effect.skipped)
 	{
-		// Source hash has changed, reset effect and load from scratch, rather than updating
+		// Source hash has changed (or effect was not fully loaded before), reset effect and load from scratch, rather than updating
 		effect = {};
 		effect.source_file = source_file;
 		effect.source_hash = source_hash;
@@ -1602,7 +1895,10 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		effect.errors.clear();
 	}
 
-	if (_effect_load_skipping && !force_load)
+	// Remember the definitions this effect was loaded with, so that changes to them can be detected later on
+	effect.preprocessor_definitions = preprocessor_definitions;
+
+	if ((_effect_load_skipping || _effect_load_lazy) && !force_load)
 	{
 		if (std::vector<std::string> techniques;
 			preset.get({}, "Techniques", techniques) && !techniques.empty())
@@ -1613,7 +1909,8 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 					return at_pos == 0 || technique.find(effect_name, at_pos) == at_pos;
 				}) == techniques.cend();
 
-			if (effect.skipped)
+			// Lazily loaded effects are still parsed, so that their techniques and uniforms can be listed, only shader compilation is deferred
+			if (effect.skipped && !_effect_load_lazy)
 			{
 				if (_reload_remaining_effects != 0 && _reload_remaining_effects != std::numeric_limits<size_t>::max())
 					_reload_remaining_effects--;
@@ -1625,9 +1922,14 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 	bool skip_optimization = false;
 	std::string code_preamble;
 
-	bool source_cached = false;
+	const std::string source_cache_id = source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + std::to_string(source_hash);
+
+	// Try to restore the parsed effect module from the metadata cache first, which avoids both preprocessing and parsing
+	const bool module_cached = !effect.preprocessed && !effect.compiled && !preprocess_required && load_effect_metadata(source_cache_id, effect, code_preamble, skip_optimization);
+
+	bool source_cached = module_cached;
 	std::string source;
-	if (!effect.preprocessed && (preprocess_required || (source_cached = load_effect_cache(source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + std::to_string(source_hash), "i", source)) == false))
+	if (!module_cached && !effect.preprocessed && (preprocess_required || (source_cached = load_effect_cache(source_cache_id, "i", source)) == false))
 	{
 		reshadefx::preprocessor pp;
 		pp.add_macro_definition("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
@@ -1710,9 +2012,18 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 
 			std::sort(effect.definitions.begin(), effect.definitions.end());
 
+			// Keep track of all macros that can influence the preprocessor output (so that only affected effects are reloaded when definitions change)
+			effect.referenced_macros = pp.referenced_macros();
+			effect.referenced_macros_known = true;
+
+			std::string referenced_macros_directive = "#macros";
+			for (const std::string &referenced_macro : effect.referenced_macros)
+				referenced_macros_directive += ' ' + referenced_macro;
+			source = "// " + referenced_macros_directive + '\n' + source;
+
 			// Do not cache if any special pragma directives were used, to ensure they are read again next time
 			if (!skip_optimization)
-				source_cached = save_effect_cache(source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + std::to_string(source_hash), "i", source);
+				source_cached = save_effect_cache(source_cache_id, "i", source);
 		}
 
 		// Keep track of included files
@@ -1735,6 +2046,19 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 				{
 					code_preamble += source.substr(offset, (next + 1) - offset);
 				}
+				else if (source.compare(offset, 7, "#macros") == 0)
+				{
+					for (size_t name_offset = offset + 7, name_end; name_offset < next; name_offset = name_end)
+					{
+						name_offset = source.find_first_not_of(' ', name_offset);
+						if (name_offset == std::string::npos || name_offset >= next)
+							break;
+						name_end = std::min(source.find(' ', name_offset), next);
+						effect.referenced_macros.push_back(source.substr(name_offset, name_end - name_offset));
+					}
+
+					effect.referenced_macros_known = true;
+				}
 				else if (const size_t equals_index = source.find('=', offset);
 					equals_index != std::string::npos)
 				{
@@ -1748,45 +2072,58 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		}
 	}
 
-	if (!effect.compiled && !source.empty())
+	if (module_cached || (!effect.compiled && !source.empty()))
 	{
-		unsigned shader_model;
-		if (_renderer_id == 0x9000)
-			shader_model = 30; // D3D9
-		else if (_renderer_id < 0xa100)
-			shader_model = 40; // D3D10 (including feature level 9)
-		else if (_renderer_id < 0xb000)
-			shader_model = 41; // D3D10.1
-		else if (_renderer_id < 0xc000)
-			shader_model = 50; // D3D11
+		if (module_cached)
+		{
+			effect.compiled = true;
+		}
 		else
-			shader_model = 51; // D3D12
+		{
+			unsigned shader_model;
+			if (_renderer_id == 0x9000)
+				shader_model = 30; // D3D9
+			else if (_renderer_id < 0xa100)
+				shader_model = 40; // D3D10 (including feature level 9)
+			else if (_renderer_id < 0xb000)
+				shader_model = 41; // D3D10.1
+			else if (_renderer_id < 0xc000)
+				shader_model = 50; // D3D11
+			else
+				shader_model = 51; // D3D12
 
-		std::unique_ptr<reshadefx::codegen> codegen;
-		if ((_renderer_id & 0xF0000) == 0)
-			codegen.reset(reshadefx::create_codegen_hlsl(shader_model, !_no_debug_info, _performance_mode));
-		else if (_renderer_id < 0x20000)
-			codegen.reset(reshadefx::create_codegen_glsl(false, !_no_debug_info, _performance_mode, false, true));
-		else // Vulkan uses SPIR-V input
-			codegen.reset(reshadefx::create_codegen_spirv(true, !_no_debug_info, _performance_mode, false, false));
+			std::unique_ptr<reshadefx::codegen> codegen;
+			if ((_renderer_id & 0xF0000) == 0)
+				codegen.reset(reshadefx::create_codegen_hlsl(shader_model, !_no_debug_info, _performance_mode));
+			else if (_renderer_id < 0x20000)
+				codegen.reset(reshadefx::create_codegen_glsl(false, !_no_debug_info, _performance_mode, false, true));
+			else // Vulkan uses SPIR-V input
+				codegen.reset(reshadefx::create_codegen_spirv(true, !_no_debug_info, _performance_mode, false, false));
 
-		reshadefx::parser parser;
+			reshadefx::parser parser;
 
-		// Compile the pre-processed source code (try the compile even if the preprocessor step failed to get additional error information)
-		effect.compiled = parser.parse(std::move(source), codegen.get());
+			// Compile the pre-processed source code (try the compile even if the preprocessor step failed to get additional error information)
+			effect.compiled = parser.parse(std::move(source), codegen.get());
 
-		// Append parser errors to the error list
-		effect.errors  += parser.errors();
+			// Append parser errors to the error list
+			effect.errors  += parser.errors();
 
-		// Write result to effect module
-		codegen->write_result(effect.module);
+			// Write result to effect module
+			codegen->write_result(effect.module);
+
+			// Store the module before it is modified below, so that the next load of this effect can skip preprocessing and parsing
+			if (effect.compiled && (effect.preprocessed || source_cached))
+				save_effect_metadata(source_cache_id, effect, code_preamble, skip_optimization);
+		}
 
 		if (effect.compiled)
 		{
 			effect.uniforms.clear();
+			effect.special_uniforms = {};
 
 			// Create space for all variables (aligned to 16 bytes)
 			effect.uniform_data_storage.resize((effect.module.total_uniform_size + 15) & ~15);
+			effect.mark_uniform_data_modified(0, static_cast<uint32_t>(effect.uniform_data_storage.size()));
 
 			for (uniform variable : effect.module.uniforms)
 			{
@@ -1825,6 +2162,8 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 					variable.special = special_uniform::overlay_hovered;
 				else if (special == "screenshot")
 					variable.special = special_uniform::screenshot;
+				else if (special == "render_scale")
+					variable.special = special_uniform::render_scale;
 				else
 					variable.special = special_uniform::unknown;
 
@@ -1834,9 +2173,15 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 				effect.uniforms.push_back(std::move(variable));
 			}
 
+			// Resolve annotation parameters of special uniform variables now, so that updating them every frame does not have to look them up again
+			effect.special_uniforms = build_special_uniform_updates(effect.uniforms);
+			_effect_uniforms_version++;
+
 			// Fill all specialization constants with values from the current preset
 			if (_performance_mode)
 			{
+				effect.spec_constant_hash = calc_spec_constant_preset_hash(effect.module, effect_name, preset);
+
 				for (reshadefx::uniform_info &constant : effect.module.spec_constants)
 				{
 					switch (constant.type.base)
@@ -1903,368 +2248,79 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 
 	if ( effect.compiled && (effect.preprocessed || source_cached))
 	{
-		// Compile shader modules
-		for (const std::pair<std::string, reshadefx::shader_type> &entry_point : effect.module.entry_points)
+		if (effect.skipped)
+		{
+			// Keep what is needed to compile the shader modules later, once a technique of this effect is enabled
+			effect.code_preamble = std::move(code_preamble);
+			effect.skip_optimization = skip_optimization;
+		}
+		else
+		{
+			effect_assembly output;
+			compile_effect(effect_index, code_preamble, skip_optimization, output);
+
+			effect.compiled = output.compiled;
+			effect.errors += output.errors;
+			effect.assembly = std::move(output.assembly);
+			effect.assembly_text = std::move(output.assembly_text);
+		}
+
+		const std::unique_lock<std::shared_mutex> lock(_reload_mutex);
+
+		for (texture new_texture : effect.module.textures)
 		{
-			if (entry_point.second == reshadefx::shader_type::compute && !_device->check_capability(api::device_caps::compute_shader))
+			new_texture.effect_index = effect_index;
+
+			if (!new_texture.semantic.empty() && (new_texture.render_target || new_texture.storage_access))
 			{
-				effect.errors += "error: " + entry_point.first + ": compute shaders are not supported in D3D9/D3D10\n";
+				effect.errors += "error: " + new_texture.unique_name + ": texture with a semantic used as a render target or storage\n";
 				effect.compiled = false;
 				break;
 			}
 
-			std::string &cso = effect.assembly[entry_point.first];
-			std::string &cso_text = effect.assembly_text[entry_point.first];
-
-			if ((_renderer_id & 0xF0000) == 0)
+			// Try to share textures with the same name across effects
+			if (const auto existing_texture = std::find_if(_textures.begin(), _textures.end(),
+					[&new_texture](const texture &item) {
+						return item.unique_name == new_texture.unique_name;
+					});
+				existing_texture != _textures.end())
 			{
-				assert(_d3d_compiler_module != nullptr);
-
-				// Copy string, since this has to be repeated for every entry point
-				std::string hlsl = code_preamble;
+				// Cannot share texture if this is a normal one, but the existing one is a reference and vice versa
+				if (new_texture.semantic != existing_texture->semantic)
+				{
+					effect.errors += "error: " + new_texture.unique_name + ": another effect (";
+					effect.errors += _effects[existing_texture->effect_index].source_file.filename().u8string();
+					effect.errors += ") already created a texture with the same name but different semantic\n";
+					effect.compiled = false;
+					break;
+				}
 
-				if (_renderer_id == 0x9000)
+				if (new_texture.semantic.empty() && !existing_texture->matches_description(new_texture))
+				{
+					effect.errors += "warning: " + new_texture.unique_name + ": another effect (";
+					effect.errors += _effects[existing_texture->effect_index].source_file.filename().u8string();
+					effect.errors += ") already created a texture with the same name but different dimensions\n";
+				}
+				if (new_texture.semantic.empty() && (existing_texture->annotation_as_string("source") != new_texture.annotation_as_string("source")))
 				{
-					// Create SEMANTIC_PIXEL_SIZE constants
-					hlsl += "#define COLOR_PIXEL_SIZE 1.0 / " + std::to_string(_effect_width) + ", 1.0 / " + std::to_string(_effect_height) + '\n';
+					effect.errors += "warning: " + new_texture.unique_name + ": another effect (";
+					effect.errors += _effects[existing_texture->effect_index].source_file.filename().u8string();
+					effect.errors += ") already created a texture with a different image file\n";
+				}
 
-					uint32_t semantic_index = 0;
-					for (const reshadefx::texture_info &tex : effect.module.textures)
+				if (existing_texture->semantic == "COLOR" && format_color_bit_depth(_effect_color_format) != 8)
+				{
+					for (const reshadefx::sampler_info &sampler_info : effect.module.samplers)
 					{
-						if (tex.semantic.empty() || tex.semantic == "COLOR")
-							continue;
-
-						semantic_index++;
-						assert((effect.uniform_data_storage.size() / 16) <= (255 - semantic_index));
-
-						// Avoid duplicate declarations if the semantic was used multiple times
-						if (hlsl.find(tex.semantic + "_PIXEL_SIZE") == std::string::npos)
-							hlsl += "uniform float2 " + tex.semantic + "_PIXEL_SIZE : register(c" + std::to_string(255 - semantic_index) + ");\n";
+						if (sampler_info.srgb && sampler_info.texture_name == new_texture.unique_name)
+						{
+							effect.errors += "warning: " + sampler_info.unique_name + ": texture does not support sRGB sampling (back buffer format is not RGBA8)\n";
+						}
 					}
 				}
 
-				hlsl += "#line 1\n"; // Reset line number, so it matches what is shown when viewing the generated code
-				hlsl.append(effect.module.code.data(), effect.module.code.size());
-
-				// Overwrite position semantic in pixel shaders
-				const D3D_SHADER_MACRO ps_defines[] = {
-					{ "POSITION", "VPOS" }, { nullptr, nullptr }
-				};
-
-				std::string profile;
-				switch (entry_point.second)
-				{
-				case reshadefx::shader_type::vertex:
-					profile = "vs";
-					break;
-				case reshadefx::shader_type::pixel:
-					profile = "ps";
-					break;
-				case reshadefx::shader_type::compute:
-					profile = "cs";
-					break;
-				}
-
-				switch (_renderer_id)
-				{
-				default:
-				case D3D_FEATURE_LEVEL_11_0:
-					profile += "_5_0";
-					break;
-				case D3D_FEATURE_LEVEL_10_1:
-					profile += "_4_1";
-					break;
-				case D3D_FEATURE_LEVEL_10_0:
-					profile += "_4_0";
-					break;
-				case D3D_FEATURE_LEVEL_9_1:
-				case D3D_FEATURE_LEVEL_9_2:
-					profile += "_4_0_level_9_1";
-					break;
-				case D3D_FEATURE_LEVEL_9_3:
-					profile += "_4_0_level_9_3";
-					break;
-				case 0x9000:
-					profile += "_3_0";
-					break;
-				}
-
-				UINT compile_flags = 0;
-				if (skip_optimization)
-					compile_flags |= D3DCOMPILE_SKIP_OPTIMIZATION;
-				else if (_performance_mode)
-					compile_flags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
-				if (_renderer_id >= D3D_FEATURE_LEVEL_10_0)
-					compile_flags |= D3DCOMPILE_ENABLE_STRICTNESS;
-#ifndef NDEBUG
-				compile_flags |= D3DCOMPILE_DEBUG;
-#endif
-
-				std::string hlsl_attributes;
-				hlsl_attributes += "entrypoint=" + entry_point.first + ';';
-				hlsl_attributes += "profile=" + profile + ';';
-				hlsl_attributes += "flags=" + std::to_string(compile_flags) + ';';
-
-				const std::string cache_id =
-					effect.source_file.stem().u8string() + '-' + entry_point.first + '-' + std::to_string(_renderer_id) + '-' +
-					std::to_string(std::hash<std::string_view>()(hlsl_attributes) ^ std::hash<std::string_view>()(hlsl));
-
-				if (!load_effect_cache(cache_id, "cso", cso))
-				{
-					const auto D3DCompile = reinterpret_cast<pD3DCompile>(GetProcAddress(static_cast<HMODULE>(_d3d_compiler_module), "D3DCompile"));
-					assert(D3DCompile != nullptr);
-
-					com_ptr<ID3DBlob> d3d_compiled, d3d_errors;
-					const HRESULT hr = D3DCompile(
-						hlsl.data(), hlsl.size(),
-						nullptr, entry_point.second == reshadefx::shader_type::pixel ? ps_defines : nullptr, nullptr,
-						entry_point.first.c_str(),
-						profile.c_str(),
-						compile_flags, 0,
-						&d3d_compiled, &d3d_errors);
-
-					std::string d3d_errors_string;
-					if (d3d_errors != nullptr) // Append warnings to the output error string as well
-						d3d_errors_string.assign(static_cast<const char *>(d3d_errors->GetBufferPointer()), d3d_errors->GetBufferSize() - 1); // Subtracting one to not append the null-terminator as well
-					d3d_errors.reset();
-
-					// De-duplicate error lines (D3DCompiler sometimes repeats the same error multiple times)
-					for (size_t line_offset = 0, next_line_offset; (next_line_offset = d3d_errors_string.find('\n', line_offset)) != std::string::npos; line_offset = next_line_offset + 1)
-					{
-						const std::string_view cur_line(d3d_errors_string.data() + line_offset, next_line_offset - line_offset);
-
-						if (const size_t end_offset = d3d_errors_string.find('\n', next_line_offset + 1);
-							end_offset != std::string::npos)
-						{
-							const std::string_view next_line(d3d_errors_string.data() + next_line_offset + 1, end_offset - next_line_offset - 1);
-							if (cur_line == next_line)
-							{
-								d3d_errors_string.erase(next_line_offset, end_offset - next_line_offset);
-								next_line_offset = line_offset - 1;
-							}
-						}
-
-						// Also remove D3DCompiler warnings about 'groupshared' specifier used in VS/PS modules
-						if (cur_line.find("X3579") != std::string_view::npos)
-						{
-							d3d_errors_string.erase(line_offset, next_line_offset + 1 - line_offset);
-							next_line_offset = line_offset - 1;
-						}
-					}
-
-					if (FAILED(hr))
-					{
-						// Add a prefix with the offending entry point name for generic error messages like an out of memory notification
-						if (d3d_errors_string.find("error") == std::string::npos)
-							effect.errors += "error: " + entry_point.first + ": ";
-
-						effect.errors += d3d_errors_string;
-						effect.compiled = false;
-						break;
-					}
-					else
-					{
-						// Append warnings
-						effect.errors += d3d_errors_string;
-					}
-
-					cso.resize(d3d_compiled->GetBufferSize());
-					std::memcpy(cso.data(), d3d_compiled->GetBufferPointer(), cso.size());
-
-					save_effect_cache(cache_id, "cso", cso);
-				}
-
-				if (!load_effect_cache(cache_id, "asm", cso_text))
-				{
-					const auto D3DDisassemble = reinterpret_cast<pD3DDisassemble>(GetProcAddress(static_cast<HMODULE>(_d3d_compiler_module), "D3DDisassemble"));
-					assert(D3DDisassemble != nullptr);
-
-					com_ptr<ID3DBlob> d3d_disassembled;
-					if (SUCCEEDED(D3DDisassemble(cso.data(), cso.size(), 0, nullptr, &d3d_disassembled)))
-						cso_text.assign(static_cast<const char *>(d3d_disassembled->GetBufferPointer()), d3d_disassembled->GetBufferSize() - 1);
-
-					save_effect_cache(cache_id, "asm", cso_text);
-				}
-			}
-			else if (_renderer_id < 0x20000)
-			{
-				std::string glsl = "#version 430\n#define ENTRY_POINT_" + entry_point.first + " 1\n";
-
-				if (entry_point.second != reshadefx::shader_type::pixel)
-				{
-					// OpenGL does not allow using 'discard' in the vertex shader profile
-					glsl += "#define discard\n";
-					// 'dFdx', 'dFdx' and 'fwidth' too are only available in fragment shaders
-					glsl += "#define dFdx(x) x\n";
-					glsl += "#define dFdy(y) y\n";
-					glsl += "#define fwidth(p) p\n";
-				}
-				if (entry_point.second != reshadefx::shader_type::compute)
-				{
-					// OpenGL does not allow using 'shared' in vertex/fragment shader profile
-					glsl += "#define shared\n";
-					glsl += "#define atomicAdd(a, b) a\n";
-					glsl += "#define atomicAnd(a, b) a\n";
-					glsl += "#define atomicOr(a, b) a\n";
-					glsl += "#define atomicXor(a, b) a\n";
-					glsl += "#define atomicMin(a, b) a\n";
-					glsl += "#define atomicMax(a, b) a\n";
-					glsl += "#define atomicExchange(a, b) a\n";
-					glsl += "#define atomicCompSwap(a, b, c) a\n";
-					// Barrier intrinsics are only available in compute shaders
-					glsl += "#define barrier()\n";
-					glsl += "#define memoryBarrier()\n";
-					glsl += "#define groupMemoryBarrier()\n";
-				}
-
-				glsl += code_preamble;
-				glsl += "#line 1 0\n"; // Reset line number, so it matches what is shown when viewing the generated code
-				glsl.append(effect.module.code.data(), effect.module.code.size());
-
-				cso_text = cso = std::move(glsl);
-			}
-			else
-			{
-				assert(_renderer_id >= 0x14600); // Core since OpenGL 4.6 (see https://www.khronos.org/opengl/wiki/SPIR-V)
-
-#if 1
-				// There are various issues with SPIR-V modules that have multiple entry points on all major GPU vendors.
-				// On AMD for instance creating a graphics pipeline just fails with a generic 'VK_ERROR_OUT_OF_HOST_MEMORY'. On NVIDIA artifacts occur on some driver versions.
-				// To work around these problems, create a separate shader module for every entry point and rewrite the SPIR-V module for each to remove all but a single entry point (and associated functions/variables).
-				uint32_t current_function = 0, current_function_offset = 0;
-				// Copy SPIR-V, so that all but the current entry point are only removed from that copy
-				std::vector<uint32_t> spirv(reinterpret_cast<const uint32_t *>(effect.module.code.data()), reinterpret_cast<const uint32_t *>(effect.module.code.data() + effect.module.code.size()));
-				std::vector<uint32_t> functions_to_remove, variables_to_remove;
-
-				for (uint32_t inst = 5 /* Skip SPIR-V header information */; inst < spirv.size();)
-				{
-					const uint32_t op = spirv[inst] & 0xFFFF;
-					const uint32_t len = (spirv[inst] >> 16) & 0xFFFF;
-					assert(len != 0);
-
-					switch (op)
-					{
-					case 15 /* OpEntryPoint */:
-						// Look for any non-matching entry points
-						if (entry_point.first != reinterpret_cast<const char *>(&spirv[inst + 3]))
-						{
-							functions_to_remove.push_back(spirv[inst + 2]);
-
-							// Get interface variables
-							for (uint32_t k = inst + 3 + static_cast<uint32_t>((std::strlen(reinterpret_cast<const char *>(&spirv[inst + 3])) + 4) / 4); k < inst + len; ++k)
-								variables_to_remove.push_back(spirv[k]);
-
-							// Remove this entry point from the module
-							spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
-							continue;
-						}
-						break;
-					case 16 /* OpExecutionMode */:
-						if (std::find(functions_to_remove.begin(), functions_to_remove.end(), spirv[inst + 1]) != functions_to_remove.end())
-						{
-							spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
-							continue;
-						}
-						break;
-					case 59 /* OpVariable */:
-						// Remove all declarations of the interface variables for non-matching entry points
-						if (std::find(variables_to_remove.begin(), variables_to_remove.end(), spirv[inst + 2]) != variables_to_remove.end())
-						{
-							spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
-							continue;
-						}
-						break;
-					case 71 /* OpDecorate */:
-						// Remove all decorations targeting any of the interface variables for non-matching entry points
-						if (std::find(variables_to_remove.begin(), variables_to_remove.end(), spirv[inst + 1]) != variables_to_remove.end())
-						{
-							spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
-							continue;
-						}
-						break;
-					case 54 /* OpFunction */:
-						current_function = spirv[inst + 2];
-						current_function_offset = inst;
-						break;
-					case 56 /* OpFunctionEnd */:
-						// Remove all function definitions for non-matching entry points
-						if (std::find(functions_to_remove.begin(), functions_to_remove.end(), current_function) != functions_to_remove.end())
-						{
-							spirv.erase(spirv.begin() + current_function_offset, spirv.begin() + inst + len);
-							inst = current_function_offset;
-							continue;
-						}
-						break;
-					}
-
-					inst += len;
-				}
-
-				cso.resize(spirv.size() * sizeof(uint32_t));
-				std::memcpy(cso.data(), spirv.data(), cso.size());
-#else
-				cso.resize(effect.module.code.size());
-				std::memcpy(cso.data(), effect.module.code.data(), effect.module.code.size());
-#endif
-			}
-		}
-
-		const std::unique_lock<std::shared_mutex> lock(_reload_mutex);
-
-		for (texture new_texture : effect.module.textures)
-		{
-			new_texture.effect_index = effect_index;
-
-			if (!new_texture.semantic.empty() && (new_texture.render_target || new_texture.storage_access))
-			{
-				effect.errors += "error: " + new_texture.unique_name + ": texture with a semantic used as a render target or storage\n";
-				effect.compiled = false;
-				break;
-			}
-
-			// Try to share textures with the same name across effects
-			if (const auto existing_texture = std::find_if(_textures.begin(), _textures.end(),
-					[&new_texture](const texture &item) {
-						return item.unique_name == new_texture.unique_name;
-					});
-				existing_texture != _textures.end())
-			{
-				// Cannot share texture if this is a normal one, but the existing one is a reference and vice versa
-				if (new_texture.semantic != existing_texture->semantic)
-				{
-					effect.errors += "error: " + new_texture.unique_name + ": another effect (";
-					effect.errors += _effects[existing_texture->effect_index].source_file.filename().u8string();
-					effect.errors += ") already created a texture with the same name but different semantic\n";
-					effect.compiled = false;
-					break;
-				}
-
-				if (new_texture.semantic.empty() && !existing_texture->matches_description(new_texture))
-				{
-					effect.errors += "warning: " + new_texture.unique_name + ": another effect (";
-					effect.errors += _effects[existing_texture->effect_index].source_file.filename().u8string();
-					effect.errors += ") already created a texture with the same name but different dimensions\n";
-				}
-				if (new_texture.semantic.empty() && (existing_texture->annotation_as_string("source") != new_texture.annotation_as_string("source")))
-				{
-					effect.errors += "warning: " + new_texture.unique_name + ": another effect (";
-					effect.errors += _effects[existing_texture->effect_index].source_file.filename().u8string();
-					effect.errors += ") already created a texture with a different image file\n";
-				}
-
-				if (existing_texture->semantic == "COLOR" && format_color_bit_depth(_effect_color_format) != 8)
-				{
-					for (const reshadefx::sampler_info &sampler_info : effect.module.samplers)
-					{
-						if (sampler_info.srgb && sampler_info.texture_name == new_texture.unique_name)
-						{
-							effect.errors += "warning: " + sampler_info.unique_name + ": texture does not support sRGB sampling (back buffer format is not RGBA8)\n";
-						}
-					}
-				}
-
-				if (std::find(existing_texture->shared.begin(), existing_texture->shared.end(), effect_index) == existing_texture->shared.end())
-					existing_texture->shared.push_back(effect_index);
+				if (std::find(existing_texture->shared.begin(), existing_texture->shared.end(), effect_index) == existing_texture->shared.end())
+					existing_texture->shared.push_back(effect_index);
 
 				// Update render target and storage access flags of the existing shared texture, in case they are used as such in this effect
 				existing_texture->render_target |= new_texture.render_target;
@@ -2336,32 +2392,447 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		}
 	}
 
-	const std::chrono::high_resolution_clock::time_point time_load_finished = std::chrono::high_resolution_clock::now();
+	const std::chrono::high_resolution_clock::time_point time_load_finished = std::chrono::high_resolution_clock::now();
+
+	if (_reload_remaining_effects != 0 && _reload_remaining_effects != std::numeric_limits<size_t>::max())
+		_reload_remaining_effects--;
+	else
+		_reload_remaining_effects = 0; // Force effect initialization in 'update_effects'
+
+	if ( effect.compiled && (effect.preprocessed || source_cached))
+	{
+		if (effect.skipped)
+			LOG(INFO) << "Successfully parsed " << source_file << " in " << (std::chrono::duration_cast<std::chrono::milliseconds>(time_load_finished - time_load_started).count() * 1e-3f) << " s, compilation is deferred until first use.";
+		else if (effect.errors.empty())
+			LOG(INFO) << "Successfully compiled " << source_file << " in " << (std::chrono::duration_cast<std::chrono::milliseconds>(time_load_finished - time_load_started).count() * 1e-3f) << " s.";
+		else
+			LOG(WARN) << "Successfully compiled " << source_file << " in " << (std::chrono::duration_cast<std::chrono::milliseconds>(time_load_finished - time_load_started).count() * 1e-3f) << " s with warnings:\n" << effect.errors;
+		return true;
+	}
+	else
+	{
+		_last_reload_successful = false;
+
+		if (effect.errors.empty())
+			LOG(ERROR) << "Failed to compile " << source_file << '!';
+		else
+			LOG(ERROR) << "Failed to compile " << source_file << ":\n" << effect.errors;
+		return false;
+	}
+}
+bool reshade::runtime::compile_effect(size_t effect_index, const std::string &code_preamble, bool skip_optimization, effect_assembly &output)
+{
+	assert(effect_index < _effects.size());
+
+	// Only read from the effect, since this may run on a background thread while the overlay is accessing it
+	const effect &effect = _effects[effect_index];
+
+	// In performance mode the generated code depends on the preset values (except for SPIR-V, where they are applied as specialization constants during pipeline creation), so keep recently used permutations around to make switching back and forth between presets fast
+	size_t permutation_hash = 0;
+	if (_performance_mode && _effect_permutation_cache_size != 0 && !effect.module.spec_constants.empty() && _renderer_id < 0x20000)
+	{
+		permutation_hash = effect.source_hash ^ std::hash<std::string>()(code_preamble);
+
+		const std::unique_lock<std::mutex> lock(_effect_permutation_cache_mutex);
+
+		if (const auto it = std::find_if(_effect_permutation_cache.begin(), _effect_permutation_cache.end(),
+				[&effect, permutation_hash](const effect_permutation &item) { return item.hash == permutation_hash && item.source_file == effect.source_file; });
+			it != _effect_permutation_cache.end())
+		{
+			output.assembly = it->assembly;
+			output.assembly_text = it->assembly_text;
+
+			// Move to the front, so that it is evicted last
+			std::rotate(_effect_permutation_cache.begin(), it, it + 1);
+			return output.compiled;
+		}
+	}
+
+	// Compile shader modules
+	for (const std::pair<std::string, reshadefx::shader_type> &entry_point : effect.module.entry_points)
+	{
+		if (entry_point.second == reshadefx::shader_type::compute && !_device->check_capability(api::device_caps::compute_shader))
+		{
+			output.errors += "error: " + entry_point.first + ": compute shaders are not supported in D3D9/D3D10\n";
+			output.compiled = false;
+			break;
+		}
+
+		std::string &cso = output.assembly[entry_point.first];
+		std::string &cso_text = output.assembly_text[entry_point.first];
+
+		if ((_renderer_id & 0xF0000) == 0)
+		{
+			assert(_d3d_compiler_module != nullptr);
+
+			// Copy string, since this has to be repeated for every entry point
+			std::string hlsl = code_preamble;
+
+			if (_renderer_id == 0x9000)
+			{
+				// Create SEMANTIC_PIXEL_SIZE constants
+				hlsl += "#define COLOR_PIXEL_SIZE 1.0 / " + std::to_string(_effect_width) + ", 1.0 / " + std::to_string(_effect_height) + '\n';
+
+				uint32_t semantic_index = 0;
+				for (const reshadefx::texture_info &tex : effect.module.textures)
+				{
+					if (tex.semantic.empty() || tex.semantic == "COLOR")
+						continue;
+
+					semantic_index++;
+					assert((effect.uniform_data_storage.size() / 16) <= (255 - semantic_index));
+
+					// Avoid duplicate declarations if the semantic was used multiple times
+					if (hlsl.find(tex.semantic + "_PIXEL_SIZE") == std::string::npos)
+						hlsl += "uniform float2 " + tex.semantic + "_PIXEL_SIZE : register(c" + std::to_string(255 - semantic_index) + ");\n";
+				}
+			}
+
+			hlsl += "#line 1\n"; // Reset line number, so it matches what is shown when viewing the generated code
+			hlsl.append(effect.module.code.data(), effect.module.code.size());
+
+			// Overwrite position semantic in pixel shaders
+			const D3D_SHADER_MACRO ps_defines[] = {
+				{ "POSITION", "VPOS" }, { nullptr, nullptr }
+			};
+
+			std::string profile;
+			switch (entry_point.second)
+			{
+			case reshadefx::shader_type::vertex:
+				profile = "vs";
+				break;
+			case reshadefx::shader_type::pixel:
+				profile = "ps";
+				break;
+			case reshadefx::shader_type::compute:
+				profile = "cs";
+				break;
+			}
+
+			switch (_renderer_id)
+			{
+			default:
+			case D3D_FEATURE_LEVEL_11_0:
+				profile += "_5_0";
+				break;
+			case D3D_FEATURE_LEVEL_10_1:
+				profile += "_4_1";
+				break;
+			case D3D_FEATURE_LEVEL_10_0:
+				profile += "_4_0";
+				break;
+			case D3D_FEATURE_LEVEL_9_1:
+			case D3D_FEATURE_LEVEL_9_2:
+				profile += "_4_0_level_9_1";
+				break;
+			case D3D_FEATURE_LEVEL_9_3:
+				profile += "_4_0_level_9_3";
+				break;
+			case 0x9000:
+				profile += "_3_0";
+				break;
+			}
+
+			UINT compile_flags = 0;
+			if (skip_optimization)
+				compile_flags |= D3DCOMPILE_SKIP_OPTIMIZATION;
+			else if (_performance_mode)
+				compile_flags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
+			if (_renderer_id >= D3D_FEATURE_LEVEL_10_0)
+				compile_flags |= D3DCOMPILE_ENABLE_STRICTNESS;
+#ifndef NDEBUG
+			compile_flags |= D3DCOMPILE_DEBUG;
+#endif
+
+			std::string hlsl_attributes;
+			hlsl_attributes += "entrypoint=" + entry_point.first + ';';
+			hlsl_attributes += "profile=" + profile + ';';
+			hlsl_attributes += "flags=" + std::to_string(compile_flags) + ';';
+
+			const std::string cache_id =
+				effect.source_file.stem().u8string() + '-' + entry_point.first + '-' + std::to_string(_renderer_id) + '-' +
+				std::to_string(std::hash<std::string_view>()(hlsl_attributes) ^ std::hash<std::string_view>()(hlsl));
+
+			if (!load_effect_cache(cache_id, "cso", cso))
+			{
+				const auto D3DCompile = reinterpret_cast<pD3DCompile>(GetProcAddress(static_cast<HMODULE>(_d3d_compiler_module), "D3DCompile"));
+				assert(D3DCompile != nullptr);
+
+				com_ptr<ID3DBlob> d3d_compiled, d3d_errors;
+				const HRESULT hr = D3DCompile(
+					hlsl.data(), hlsl.size(),
+					nullptr, entry_point.second == reshadefx::shader_type::pixel ? ps_defines : nullptr, nullptr,
+					entry_point.first.c_str(),
+					profile.c_str(),
+					compile_flags, 0,
+					&d3d_compiled, &d3d_errors);
+
+				std::string d3d_errors_string;
+				if (d3d_errors != nullptr) // Append warnings to the output error string as well
+					d3d_errors_string.assign(static_cast<const char *>(d3d_errors->GetBufferPointer()), d3d_errors->GetBufferSize() - 1); // Subtracting one to not append the null-terminator as well
+				d3d_errors.reset();
+
+				// De-duplicate error lines (D3DCompiler sometimes repeats the same error multiple times)
+				for (size_t line_offset = 0, next_line_offset; (next_line_offset = d3d_errors_string.find('\n', line_offset)) != std::string::npos; line_offset = next_line_offset + 1)
+				{
+					const std::string_view cur_line(d3d_errors_string.data() + line_offset, next_line_offset - line_offset);
+
+					if (const size_t end_offset = d3d_errors_string.find('\n', next_line_offset + 1);
+						end_offset != std::string::npos)
+					{
+						const std::string_view next_line(d3d_errors_string.data() + next_line_offset + 1, end_offset - next_line_offset - 1);
+						if (cur_line == next_line)
+						{
+							d3d_errors_string.erase(next_line_offset, end_offset - next_line_offset);
+							next_line_offset = line_offset - 1;
+						}
+					}
+
+					// Also remove D3DCompiler warnings about 'groupshared' specifier used in VS/PS modules
+					if (cur_line.find("X3579") != std::string_view::npos)
+					{
+						d3d_errors_string.erase(line_offset, next_line_offset + 1 - line_offset);
+						next_line_offset = line_offset - 1;
+					}
+				}
+
+				if (FAILED(hr))
+				{
+					// Add a prefix with the offending entry point name for generic error messages like an out of memory notification
+					if (d3d_errors_string.find("error") == std::string::npos)
+						output.errors += "error: " + entry_point.first + ": ";
+
+					output.errors += d3d_errors_string;
+					output.compiled = false;
+					break;
+				}
+				else
+				{
+					// Append warnings
+					output.errors += d3d_errors_string;
+				}
+
+				cso.resize(d3d_compiled->GetBufferSize());
+				std::memcpy(cso.data(), d3d_compiled->GetBufferPointer(), cso.size());
+
+				save_effect_cache(cache_id, "cso", cso);
+			}
+
+			if (!load_effect_cache(cache_id, "asm", cso_text))
+			{
+				const auto D3DDisassemble = reinterpret_cast<pD3DDisassemble>(GetProcAddress(static_cast<HMODULE>(_d3d_compiler_module), "D3DDisassemble"));
+				assert(D3DDisassemble != nullptr);
+
+				com_ptr<ID3DBlob> d3d_disassembled;
+				if (SUCCEEDED(D3DDisassemble(cso.data(), cso.size(), 0, nullptr, &d3d_disassembled)))
+					cso_text.assign(static_cast<const char *>(d3d_disassembled->GetBufferPointer()), d3d_disassembled->GetBufferSize() - 1);
+
+				save_effect_cache(cache_id, "asm", cso_text);
+			}
+		}
+		else if (_renderer_id < 0x20000)
+		{
+			std::string glsl = "#version 430\n#define ENTRY_POINT_" + entry_point.first + " 1\n";
+
+			if (entry_point.second != reshadefx::shader_type::pixel)
+			{
+				// OpenGL does not allow using 'discard' in the vertex shader profile
+				glsl += "#define discard\n";
+				// 'dFdx', 'dFdx' and 'fwidth' too are only available in fragment shaders
+				glsl += "#define dFdx(x) x\n";
+				glsl += "#define dFdy(y) y\n";
+				glsl += "#define fwidth(p) p\n";
+			}
+			if (entry_point.second != reshadefx::shader_type::compute)
+			{
+				// OpenGL does not allow using 'shared' in vertex/fragment shader profile
+				glsl += "#define shared\n";
+				glsl += "#define atomicAdd(a, b) a\n";
+				glsl += "#define atomicAnd(a, b) a\n";
+				glsl += "#define atomicOr(a, b) a\n";
+				glsl += "#define atomicXor(a, b) a\n";
+				glsl += "#define atomicMin(a, b) a\n";
+				glsl += "#define atomicMax(a, b) a\n";
+				glsl += "#define atomicExchange(a, b) a\n";
+				glsl += "#define atomicCompSwap(a, b, c) a\n";
+				// Barrier intrinsics are only available in compute shaders
+				glsl += "#define barrier()\n";
+				glsl += "#define memoryBarrier()\n";
+				glsl += "#define groupMemoryBarrier()\n";
+			}
+
+			glsl += code_preamble;
+			glsl += "#line 1 0\n"; // Reset line number, so it matches what is shown when viewing the generated code
+			glsl.append(effect.module.code.data(), effect.module.code.size());
+
+			cso_text = cso = std::move(glsl);
+		}
+		else
+		{
+			assert(_renderer_id >= 0x14600); // Core since OpenGL 4.6 (see https://www.khronos.org/opengl/wiki/SPIR-V)
+
+#if 1
+			// There are various issues with SPIR-V modules that have multiple entry points on all major GPU vendors.
+			// On AMD for instance creating a graphics pipeline just fails with a generic 'VK_ERROR_OUT_OF_HOST_MEMORY'. On NVIDIA artifacts occur on some driver versions.
+			// To work around these problems, create a separate shader module for every entry point and rewrite the SPIR-V module for each to remove all but a single entry point (and associated functions/variables).
+			uint32_t current_function = 0, current_function_offset = 0;
+			// Copy SPIR-V, so that all but the current entry point are only removed from that copy
+			std::vector<uint32_t> spirv(reinterpret_cast<const uint32_t *>(effect.module.code.data()), reinterpret_cast<const uint32_t *>(effect.module.code.data() + effect.module.code.size()));
+			std::vector<uint32_t> functions_to_remove, variables_to_remove;
+
+			for (uint32_t inst = 5 /* Skip SPIR-V header information */; inst < spirv.size();)
+			{
+				const uint32_t op = spirv[inst] & 0xFFFF;
+				const uint32_t len = (spirv[inst] >> 16) & 0xFFFF;
+				assert(len != 0);
+
+				switch (op)
+				{
+				case 15 /* OpEntryPoint */:
+					// Look for any non-matching entry points
+					if (entry_point.first != reinterpret_cast<const char *>(&spirv[inst + 3]))
+					{
+						functions_to_remove.push_back(spirv[inst + 2]);
+
+						// Get interface variables
+						for (uint32_t k = inst + 3 + static_cast<uint32_t>((std::strlen(reinterpret_cast<const char *>(&spirv[inst + 3])) + 4) / 4); k < inst + len; ++k)
+							variables_to_remove.push_back(spirv[k]);
+
+						// Remove this entry point from the module
+						spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
+						continue;
+					}
+					break;
+				case 16 /* OpExecutionMode */:
+					if (std::find(functions_to_remove.begin(), functions_to_remove.end(), spirv[inst + 1]) != functions_to_remove.end())
+					{
+						spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
+						continue;
+					}
+					break;
+				case 59 /* OpVariable */:
+					// Remove all declarations of the interface variables for non-matching entry points
+					if (std::find(variables_to_remove.begin(), variables_to_remove.end(), spirv[inst + 2]) != variables_to_remove.end())
+					{
+						spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
+						continue;
+					}
+					break;
+				case 71 /* OpDecorate */:
+					// Remove all decorations targeting any of the interface variables for non-matching entry points
+					if (std::find(variables_to_remove.begin(), variables_to_remove.end(), spirv[inst + 1]) != variables_to_remove.end())
+					{
+						spirv.erase(spirv.begin() + inst, spirv.begin() + inst + len);
+						continue;
+					}
+					break;
+				case 54 /* OpFunction */:
+					current_function = spirv[inst + 2];
+					current_function_offset = inst;
+					break;
+				case 56 /* OpFunctionEnd */:
+					// Remove all function definitions for non-matching entry points
+					if (std::find(functions_to_remove.begin(), functions_to_remove.end(), current_function) != functions_to_remove.end())
+					{
+						spirv.erase(spirv.begin() + current_function_offset, spirv.begin() + inst + len);
+						inst = current_function_offset;
+						continue;
+					}
+					break;
+				}
+
+				inst += len;
+			}
+
+			cso.resize(spirv.size() * sizeof(uint32_t));
+			std::memcpy(cso.data(), spirv.data(), cso.size());
+#else
+			cso.resize(effect.module.code.size());
+			std::memcpy(cso.data(), effect.module.code.data(), effect.module.code.size());
+#endif
+		}
+	}
+
+	if (permutation_hash != 0 && output.compiled)
+	{
+		const std::unique_lock<std::mutex> lock(_effect_permutation_cache_mutex);
+
+		effect_permutation permutation;
+		permutation.source_file = effect.source_file;
+		permutation.hash = permutation_hash;
+		permutation.assembly = output.assembly;
+		permutation.assembly_text = output.assembly_text;
+		_effect_permutation_cache.insert(_effect_permutation_cache.begin(), std::move(permutation));
+
+		// Evict the least recently used permutation of this effect once the limit is exceeded
+		if (std::count_if(_effect_permutation_cache.cbegin(), _effect_permutation_cache.cend(),
+				[&effect](const effect_permutation &item) { return item.source_file == effect.source_file; }) > static_cast<ptrdiff_t>(_effect_permutation_cache_size))
+		{
+			const auto it = std::find_if(_effect_permutation_cache.rbegin(), _effect_permutation_cache.rend(),
+				[&effect](const effect_permutation &item) { return item.source_file == effect.source_file; });
+			_effect_permutation_cache.erase(std::next(it).base());
+		}
+	}
+
+	return output.compiled;
+}
+void reshade::runtime::compile_effect_async(size_t effect_index)
+{
+	// Avoid compiling the same effect multiple times if it was queued again while still compiling
+	if (std::find_if(_lazy_compile_threads.cbegin(), _lazy_compile_threads.cend(),
+			[effect_index](const std::pair<size_t, std::thread> &item) { return item.first == effect_index; }) != _lazy_compile_threads.cend())
+		return;
+
+	_lazy_compile_threads.emplace_back(effect_index, std::thread([this, effect_index]() {
+		const std::chrono::high_resolution_clock::time_point time_compile_started = std::chrono::high_resolution_clock::now();
+
+		const effect &effect = _effects[effect_index];
+
+		// Compile into separate storage, which is only moved into the effect on the render thread in 'update_effects' after this thread was joined
+		effect_assembly output;
+		if (compile_effect(effect_index, effect.code_preamble, effect.skip_optimization, output))
+			LOG(INFO) << "Successfully compiled " << effect.source_file << " in " << (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - time_compile_started).count() * 1e-3f) << " s.";
+		else
+			LOG(ERROR) << "Failed to compile " << effect.source_file << ":\n" << output.errors;
+
+		const std::unique_lock<std::mutex> lock(_lazy_compile_mutex);
+		_lazy_compile_finished.emplace_back(effect_index, std::move(output));
+	}));
+}
+static std::string find_transient_texture_technique(const reshadefx::effect_module &module, const std::string &texture_name, bool assume_overwritten)
+{
+	const reshadefx::technique_info *transient_technique = nullptr;
+
+	for (const reshadefx::technique_info &technique_info : module.techniques)
+	{
+		for (const reshadefx::pass_info &pass_info : technique_info.passes)
+		{
+			const auto render_target = std::find(std::begin(pass_info.render_target_names), std::end(pass_info.render_target_names), texture_name);
+
+			if (render_target == std::end(pass_info.render_target_names) &&
+				std::none_of(pass_info.samplers.cbegin(), pass_info.samplers.cend(), [&texture_name](const reshadefx::sampler_info &info) { return info.texture_name == texture_name; }) &&
+				std::none_of(pass_info.storages.cbegin(), pass_info.storages.cend(), [&texture_name](const reshadefx::storage_info &info) { return info.texture_name == texture_name; }))
+				continue;
+
+			// Texture may only be used in a single technique, since techniques are rendered one after another and therefore never use their textures at the same time
+			if (transient_technique != nullptr)
+				return std::string();
 
-	if (_reload_remaining_effects != 0 && _reload_remaining_effects != std::numeric_limits<size_t>::max())
-		_reload_remaining_effects--;
-	else
-		_reload_remaining_effects = 0; // Force effect initialization in 'update_effects'
+			transient_technique = &technique_info;
 
-	if ( effect.compiled && (effect.preprocessed || source_cached))
-	{
-		if (effect.errors.empty())
-			LOG(INFO) << "Successfully compiled " << source_file << " in " << (std::chrono::duration_cast<std::chrono::milliseconds>(time_load_finished - time_load_started).count() * 1e-3f) << " s.";
-		else
-			LOG(WARN) << "Successfully compiled " << source_file << " in " << (std::chrono::duration_cast<std::chrono::milliseconds>(time_load_finished - time_load_started).count() * 1e-3f) << " s with warnings:\n" << effect.errors;
-		return true;
-	}
-	else
-	{
-		_last_reload_successful = false;
+			// The first pass using the texture has to clear it, so that contents left behind by other techniques never matter
+			// Which pixels a pass writes otherwise depends on what its vertex shader does, so cannot assume it overwrites them all, unless the texture explicitly says so
+			if (render_target == std::end(pass_info.render_target_names) || !(pass_info.clear_render_targets || assume_overwritten))
+				return std::string();
 
-		if (effect.errors.empty())
-			LOG(ERROR) << "Failed to compile " << source_file << '!';
-		else
-			LOG(ERROR) << "Failed to compile " << source_file << ":\n" << effect.errors;
-		return false;
+			break; // Later passes in this technique may use the texture in any way
+		}
 	}
+
+	return transient_technique != nullptr ? transient_technique->name : std::string();
 }
+
 bool reshade::runtime::create_effect(size_t effect_index)
 {
 	assert(effect_index < _effects.size());
@@ -2374,6 +2845,11 @@ bool reshade::runtime::create_effect(size_t effect_index)
 		if (tex.resource != 0 || std::find(tex.shared.cbegin(), tex.shared.cend(), effect_index) == tex.shared.cend())
 			continue;
 
+		tex.transient_technique.clear();
+		if (_alias_transient_textures && tex.semantic.empty() && tex.render_target && !tex.storage_access && tex.shared.size() == 1 &&
+			!tex.annotation_as_int("pooled") && tex.annotation_as_string("source").empty())
+			tex.transient_technique = find_transient_texture_technique(effect.module, tex.unique_name, tex.annotation_as_int("transient") != 0);
+
 		if (!create_texture(tex))
 		{
 			effect.errors += "Failed to create texture " + tex.unique_name + '.';
@@ -2392,7 +2868,11 @@ bool reshade::runtime::create_effect(size_t effect_index)
 	}
 
 	// Create optional query heap for time measurements
-	if (!_device->create_query_heap(api::query_type::timestamp, static_cast<uint32_t>(effect.module.techniques.size() * 2 * 4), &effect.query_heap))
+	uint32_t num_queries = 0;
+	for (const reshadefx::technique_info &technique_info : effect.module.techniques)
+		num_queries += static_cast<uint32_t>(2 + technique_info.passes.size() * 2) * 4;
+
+	if (!_device->create_query_heap(api::query_type::timestamp, num_queries, &effect.query_heap))
 		LOG(ERROR) << "Failed to create query heap for effect file " << effect.source_file << '!';
 
 	const bool sampler_with_resource_view = _device->check_capability(api::device_caps::sampler_with_resource_view);
@@ -2462,17 +2942,22 @@ bool reshade::runtime::create_effect(size_t effect_index)
 		return false;
 	}
 
-	api::buffer_range cb_range = {};
+	api::buffer_range cb_ranges[4] = {};
 	std::vector<api::descriptor_table_update> descriptor_writes;
-	descriptor_writes.reserve(effect.module.num_sampler_bindings + effect.module.num_texture_bindings + effect.module.num_storage_bindings + 1);
+	descriptor_writes.reserve(effect.module.num_sampler_bindings + effect.module.num_texture_bindings + effect.module.num_storage_bindings + std::size(cb_ranges));
 	std::vector<api::sampler_with_resource_view> sampler_descriptors;
 	sampler_descriptors.resize(effect.module.num_sampler_bindings + effect.module.num_texture_bindings);
 
 	// Create global constant buffer (except in D3D9, which does not have constant buffers)
 	if (_renderer_id != 0x9000 && !effect.uniform_data_storage.empty())
 	{
+		// Constant buffer views have to be aligned to 256 bytes in D3D12, which also satisfies the offset alignment requirements of Vulkan
+		const bool use_slices = _device->get_api() == api::device_api::d3d12 || _device->get_api() == api::device_api::vulkan;
+		const uint32_t num_slices = use_slices ? static_cast<uint32_t>(std::size(cb_ranges)) : 1;
+		effect.cb_slice_size = use_slices ? (static_cast<uint32_t>(effect.uniform_data_storage.size()) + 255) & ~255u : static_cast<uint32_t>(effect.uniform_data_storage.size());
+
 		if (!_device->create_resource(
-				api::resource_desc(effect.uniform_data_storage.size(), api::memory_heap::cpu_to_gpu, api::resource_usage::constant_buffer),
+				api::resource_desc(static_cast<uint64_t>(effect.cb_slice_size) * num_slices, api::memory_heap::cpu_to_gpu, api::resource_usage::constant_buffer),
 				nullptr, api::resource_usage::cpu_access, &effect.cb))
 		{
 			LOG(ERROR) << "Failed to create constant buffer for effect file " << effect.source_file << '!';
@@ -2481,20 +2966,32 @@ bool reshade::runtime::create_effect(size_t effect_index)
 
 		_device->set_resource_name(effect.cb, "ReShade constant buffer");
 
-		if (!_device->allocate_descriptor_table(effect.layout, 0, &effect.cb_table))
+		// Keep buffer mapped for its entire lifetime, since upload heap memory can be written while mapped
+		if (use_slices && !_device->map_buffer_region(effect.cb, 0, std::numeric_limits<uint64_t>::max(), api::map_access::write_only, reinterpret_cast<void **>(&effect.cb_mapped_data)))
 		{
-			LOG(ERROR) << "Failed to create constant buffer descriptor table for effect file " << effect.source_file << '!';
+			LOG(ERROR) << "Failed to map constant buffer for effect file " << effect.source_file << '!';
 			return false;
 		}
 
-		cb_range.buffer = effect.cb;
+		if (!_device->allocate_descriptor_tables(num_slices, effect.layout, 0, effect.cb_table))
+		{
+			LOG(ERROR) << "Failed to create constant buffer descriptor table for effect file " << effect.source_file << '!';
+			return false;
+		}
 
-		api::descriptor_table_update &write = descriptor_writes.emplace_back();
-		write.table = effect.cb_table;
-		write.binding = 0;
-		write.type = api::descriptor_type::constant_buffer;
-		write.count = 1;
-		write.descriptors = &cb_range;
+		for (uint32_t slice = 0; slice < num_slices; ++slice)
+		{
+			cb_ranges[slice].buffer = effect.cb;
+			cb_ranges[slice].offset = static_cast<uint64_t>(slice) * effect.cb_slice_size;
+			cb_ranges[slice].size = effect.cb_slice_size;
+
+			api::descriptor_table_update &write = descriptor_writes.emplace_back();
+			write.table = effect.cb_table[slice];
+			write.binding = 0;
+			write.type = api::descriptor_type::constant_buffer;
+			write.count = 1;
+			write.descriptors = &cb_ranges[slice];
+		}
 	}
 
 	// Initialize bindings
@@ -2564,7 +3061,7 @@ bool reshade::runtime::create_effect(size_t effect_index)
 
 	// Initialize techniques and passes
 	size_t total_pass_index = 0;
-	size_t technique_index_in_effect = 0;
+	uint32_t query_index = 0;
 
 	for (technique &tech : _techniques)
 	{
@@ -2573,8 +3070,9 @@ bool reshade::runtime::create_effect(size_t effect_index)
 
 		tech.passes_data.resize(tech.passes.size());
 
-		// Offset index so that a query exists for each command frame and two subsequent ones are used for before/after stamps
-		tech.query_base_index = static_cast<uint32_t>(technique_index_in_effect++ * 2 * 4);
+		// Offset index so that a set of queries exists for each command frame
+		tech.query_base_index = query_index;
+		query_index += tech.query_count() * 4;
 
 		for (size_t pass_index = 0; pass_index < tech.passes.size(); ++pass_index, ++total_pass_index)
 		{
@@ -2671,7 +3169,7 @@ bool reshade::runtime::create_effect(size_t effect_index)
 							pass_data.modified_resources.push_back(render_target_texture->resource);
 
 							if (pass_info.generate_mipmaps && render_target_texture->levels > 1)
-								pass_data.generate_mipmap_views.push_back(render_target_texture->srv[0]);
+								pass_data.generate_mipmap_views.emplace_back(render_target_texture->resource, render_target_texture->srv[0]);
 						}
 
 						const api::resource_desc res_desc = _device->get_resource_desc(render_target_texture->resource);
@@ -2859,6 +3357,10 @@ bool reshade::runtime::create_effect(size_t effect_index)
 					else
 					{
 						srv = sampler_texture->srv[info.srgb];
+
+						// Keep track of the textures read by this pass, so that pending writes to them can be resolved before it in 'render_technique'
+						if (std::find(pass_data.sampled_resources.cbegin(), pass_data.sampled_resources.cend(), sampler_texture->resource) == pass_data.sampled_resources.cend())
+							pass_data.sampled_resources.push_back(sampler_texture->resource);
 					}
 
 					assert(srv != 0);
@@ -2883,7 +3385,7 @@ bool reshade::runtime::create_effect(size_t effect_index)
 						pass_data.modified_resources.push_back(storage_texture->resource);
 
 						if (pass_info.generate_mipmaps && storage_texture->levels > 1)
-							pass_data.generate_mipmap_views.push_back(storage_texture->srv[0]);
+							pass_data.generate_mipmap_views.emplace_back(storage_texture->resource, storage_texture->srv[0]);
 					}
 
 					api::descriptor_table_update &write = descriptor_writes.emplace_back();
@@ -2966,11 +3468,19 @@ void reshade::runtime::destroy_effect(size_t effect_index)
 
 	{	effect &effect = _effects[effect_index];
 
+		if (effect.cb_mapped_data != nullptr)
+			_device->unmap_buffer_region(effect.cb);
+		effect.cb_mapped_data = nullptr;
+		std::fill_n(effect.cb_slice_versions, std::size(effect.cb_slice_versions), 0);
+
 		_device->destroy_resource(effect.cb);
 		effect.cb = {};
 
-		_device->free_descriptor_table(effect.cb_table);
-		effect.cb_table = {};
+		for (api::descriptor_table &cb_table : effect.cb_table)
+		{
+			_device->free_descriptor_table(cb_table);
+			cb_table = {};
+		}
 		_device->free_descriptor_table(effect.sampler_table);
 		effect.sampler_table = {};
 
@@ -3027,10 +3537,76 @@ void reshade::runtime::destroy_effect(size_t effect_index)
 	// Do not clear effect here, since it is common to be reused immediately
 }
 
+static bool get_texture_data_layout(reshadefx::texture_format format, uint32_t &pixel_size, stbir_datatype &data_type, stbir_pixel_layout &pixel_layout)
+{
+	switch (format)
+	{
+	case reshadefx::texture_format::r8:
+		pixel_size = 1 * 1;
+		data_type = STBIR_TYPE_UINT8;
+		pixel_layout = STBIR_1CHANNEL;
+		break;
+	case reshadefx::texture_format::r32f:
+		pixel_size = 4 * 1;
+		data_type = STBIR_TYPE_FLOAT;
+		pixel_layout = STBIR_1CHANNEL;
+		break;
+	case reshadefx::texture_format::rg8:
+		pixel_size = 1 * 2;
+		data_type = STBIR_TYPE_UINT8;
+		pixel_layout = STBIR_2CHANNEL;
+		break;
+	case reshadefx::texture_format::rg16:
+		pixel_size = 2 * 2;
+		data_type = STBIR_TYPE_UINT16;
+		pixel_layout = STBIR_2CHANNEL;
+		break;
+	case reshadefx::texture_format::rg16f:
+		pixel_size = 2 * 2;
+		data_type = STBIR_TYPE_HALF_FLOAT;
+		pixel_layout = STBIR_2CHANNEL;
+		break;
+	case reshadefx::texture_format::rg32f:
+		pixel_size = 4 * 2;
+		data_type = STBIR_TYPE_FLOAT;
+		pixel_layout = STBIR_2CHANNEL;
+		break;
+	case reshadefx::texture_format::rgba8:
+	case reshadefx::texture_format::rgb10a2:
+		pixel_size = 1 * 4;
+		data_type = STBIR_TYPE_UINT8;
+		pixel_layout = STBIR_RGBA;
+		break;
+	case reshadefx::texture_format::rgba16:
+		pixel_size = 2 * 4;
+		data_type = STBIR_TYPE_UINT16;
+		pixel_layout = STBIR_RGBA;
+		break;
+	case reshadefx::texture_format::rgba16f:
+		pixel_size = 2 * 4;
+		data_type = STBIR_TYPE_HALF_FLOAT;
+		pixel_layout = STBIR_RGBA;
+		break;
+	case reshadefx::texture_format::rgba32f:
+		pixel_size = 4 * 4;
+		data_type = STBIR_TYPE_FLOAT;
+		pixel_layout = STBIR_RGBA;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
 void reshade::runtime::load_textures()
 {
-	for (texture &tex : _textures)
+	// Resolve source paths first, so that only textures with an image file attached are decoded below
+	std::vector<std::pair<size_t, std::filesystem::path>> texture_sources;
+	for (size_t texture_index = 0; texture_index < _textures.size(); ++texture_index)
 	{
+		const texture &tex = _textures[texture_index];
+
 		if (tex.resource == 0 || !tex.semantic.empty())
 			continue; // Ignore textures that are not created yet and those that are handled in the runtime implementation
 
@@ -3047,158 +3623,267 @@ void reshade::runtime::load_textures()
 			continue;
 		}
 
-		std::error_code ec;
-		const uintmax_t file_size = std::filesystem::file_size(source_path, ec);
+		texture_sources.emplace_back(texture_index, std::move(source_path));
+	}
+
+	// Decode image files in parallel, since that is the expensive part, and only upload the results on this thread afterwards
+	std::vector<std::vector<uint8_t>> texture_data(texture_sources.size());
+
+	size_t num_splits = std::min(texture_sources.size(), static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 2u) - 1));
+#ifndef _WIN64
+	// Limit number of threads in 32-bit due to the limited about of address space being available there and decoding being memory hungry
+	num_splits = std::min(num_splits, static_cast<size_t>(4));
+#endif
+
+	const auto decode_batch = [this, &texture_sources, &texture_data, num_splits](size_t n) {
+		for (size_t i = 0; i < texture_sources.size(); ++i)
+			if (i * num_splits / texture_sources.size() == n)
+				load_texture_data(_textures[texture_sources[i].first], texture_sources[i].second, texture_data[i]);
+	};
+
+	if (num_splits > 1)
+	{
+		std::vector<std::thread> decode_threads;
+		decode_threads.reserve(num_splits - 1);
+		for (size_t n = 1; n < num_splits; ++n)
+			decode_threads.emplace_back(decode_batch, n);
 
-		void *pixels = nullptr;
-		int width = 0, height = 1, depth = 1, channels = 0;
-		const bool is_floating_point_format = (tex.format == reshadefx::texture_format::r32f || tex.format == reshadefx::texture_format::rg32f || tex.format == reshadefx::texture_format::rgba32f);
+		// Make use of this thread as well while waiting for the others
+		decode_batch(0);
 
-		if (auto file = std::ifstream(source_path, std::ios::binary))
+		for (std::thread &thread : decode_threads)
+			thread.join();
+	}
+	else if (num_splits == 1)
+	{
+		decode_batch(0);
+	}
+
+	for (size_t i = 0; i < texture_sources.size(); ++i)
+	{
+		texture &tex = _textures[texture_sources[i].first];
+
+		if (texture_data[i].empty())
 		{
-			if (source_path.extension() == L".cube")
-			{
-				if (!is_floating_point_format)
-				{
-					LOG(ERROR) << "Source " << source_path << " for texture '" << tex.unique_name << "' is a Cube LUT file, which can only be loaded into textures with a floating-point format!";
-					_last_reload_successful = false;
-					continue;
-				}
+			_last_reload_successful = false;
+			continue;
+		}
 
-				float domain_min[3] = { 0.0f, 0.0f, 0.0f };
-				float domain_max[3] = { 1.0f, 1.0f, 1.0f };
+		update_texture(tex, tex.width, tex.height, tex.depth, texture_data[i].data());
 
-				// Read header information
-				std::string line;
-				while (std::getline(file, line))
-				{
-					if (line.empty() || line[0] == '#')
-						continue; // Skip lines with comments
+		tex.loaded = true;
+	}
 
-					char *p = line.data();
+	_textures_loaded = true;
+}
+bool reshade::runtime::load_texture_data(const texture &tex, const std::filesystem::path &source_path, std::vector<uint8_t> &data) const
+{
+	uint32_t pixel_size;
+	stbir_datatype data_type;
+	stbir_pixel_layout pixel_layout;
+	if (!get_texture_data_layout(tex.format, pixel_size, data_type, pixel_layout))
+	{
+		LOG(ERROR) << "Texture upload is not supported for format " << static_cast<int>(tex.format) << " of texture '" << tex.unique_name << "'!";
+		return false;
+	}
 
-					if (line.rfind("TITLE", 0) == 0)
-						continue; // Skip optional line with title
+	std::error_code ec;
+	const uintmax_t file_size = std::filesystem::file_size(source_path, ec);
 
-					if (line.rfind("DOMAIN_MIN", 0) == 0)
-					{
-						p += 10;
-						domain_min[0] = static_cast<float>(std::strtod(p, &p));
-						domain_min[1] = static_cast<float>(std::strtod(p, &p));
-						domain_min[2] = static_cast<float>(std::strtod(p, &p));
-						continue;
-					}
-					if (line.rfind("DOMAIN_MAX", 0) == 0)
-					{
-						p += 10;
-						domain_max[0] = static_cast<float>(std::strtod(p, &p));
-						domain_max[1] = static_cast<float>(std::strtod(p, &p));
-						domain_max[2] = static_cast<float>(std::strtod(p, &p));
-						continue;
-					}
+	// Generate a unique string identifying the decoded image data, which depends on both the source file and the texture description
+	std::string attributes;
+	attributes += source_path.u8string();
+	attributes += '?';
+	attributes += std::to_string(std::filesystem::last_write_time(source_path, ec).time_since_epoch().count());
+	attributes += ';';
+	attributes += "size=" + std::to_string(file_size) + ';';
+	attributes += "format=" + std::to_string(static_cast<uint32_t>(tex.format)) + ';';
+	attributes += "width=" + std::to_string(tex.width) + ';';
+	attributes += "height=" + std::to_string(tex.height) + ';';
+	attributes += "depth=" + std::to_string(tex.depth) + ';';
+
+	const size_t data_size = static_cast<size_t>(tex.width) * static_cast<size_t>(tex.height) * static_cast<size_t>(tex.depth) * static_cast<size_t>(pixel_size);
+	const std::string cache_id = source_path.stem().u8string() + '-' + std::to_string(std::hash<std::string>()(attributes));
+
+	// Decoded data is cached in the exact layout it is uploaded in, so it can be used as is
+	if (std::string cached_data;
+		load_effect_cache(cache_id, "tex", cached_data) && cached_data.size() == data_size)
+	{
+		data.assign(cached_data.begin(), cached_data.end());
+		return true;
+	}
 
-					if (line.rfind("LUT_1D_SIZE", 0) == 0)
-					{
-						if (pixels != nullptr)
-							break;
-						width = std::strtol(p + 11, nullptr, 10);
-						pixels = std::malloc(static_cast<size_t>(width) * 4 * sizeof(float));
-						continue;
-					}
-					if (line.rfind("LUT_3D_SIZE", 0) == 0)
-					{
-						if (pixels != nullptr)
-							break;
-						width = height = depth = std::strtol(p + 11, nullptr, 10);
-						pixels = std::malloc(static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * 4 * sizeof(float));
-						continue;
-					}
+	void *pixels = nullptr;
+	int width = 0, height = 1, depth = 1, channels = 0;
+	const bool is_floating_point_format = (tex.format == reshadefx::texture_format::r32f || tex.format == reshadefx::texture_format::rg32f || tex.format == reshadefx::texture_format::rgba32f);
 
-					// Line has no known keyword, so assume this is where the table data starts and roll back a line to continue reading that below
-					file.seekg(-static_cast<std::streampos>(line.size() + 1), std::ios::cur);
-					break;
-				}
+	if (auto file = std::ifstream(source_path, std::ios::binary))
+	{
+		if (source_path.extension() == L".cube")
+		{
+			if (!is_floating_point_format)
+			{
+				LOG(ERROR) << "Source " << source_path << " for texture '" << tex.unique_name << "' is a Cube LUT file, which can only be loaded into textures with a floating-point format!";
+				return false;
+			}
 
-				// Read table data
-				if (pixels != nullptr)
-				{
-					size_t index = 0;
-					while (std::getline(file, line) && (index + 4) <= (static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * 4))
-					{
-						if (line.empty() || line[0] == '#')
-							continue; // Skip lines with comments
+			float domain_min[3] = { 0.0f, 0.0f, 0.0f };
+			float domain_max[3] = { 1.0f, 1.0f, 1.0f };
+
+			// Read header information
+			std::string line;
+			while (std::getline(file, line))
+			{
+				if (line.empty() || line[0] == '#')
+					continue; // Skip lines with comments
 
-						char *p = line.data();
+				char *p = line.data();
 
-						static_cast<float *>(pixels)[index++] = static_cast<float>(std::strtod(p, &p)) * (domain_max[0] - domain_min[0]) + domain_min[0];
-						static_cast<float *>(pixels)[index++] = static_cast<float>(std::strtod(p, &p)) * (domain_max[1] - domain_min[1]) + domain_min[1];
-						static_cast<float *>(pixels)[index++] = static_cast<float>(std::strtod(p, &p)) * (domain_max[2] - domain_min[2]) + domain_min[2];
-						static_cast<float *>(pixels)[index++] = 1.0f;
-					}
+				if (line.rfind("TITLE", 0) == 0)
+					continue; // Skip optional line with title
+
+				if (line.rfind("DOMAIN_MIN", 0) == 0)
+				{
+					p += 10;
+					domain_min[0] = static_cast<float>(std::strtod(p, &p));
+					domain_min[1] = static_cast<float>(std::strtod(p, &p));
+					domain_min[2] = static_cast<float>(std::strtod(p, &p));
+					continue;
+				}
+				if (line.rfind("DOMAIN_MAX", 0) == 0)
+				{
+					p += 10;
+					domain_max[0] = static_cast<float>(std::strtod(p, &p));
+					domain_max[1] = static_cast<float>(std::strtod(p, &p));
+					domain_max[2] = static_cast<float>(std::strtod(p, &p));
+					continue;
+				}
+
+				if (line.rfind("LUT_1D_SIZE", 0) == 0)
+				{
+					if (pixels != nullptr)
+						break;
+					width = std::strtol(p + 11, nullptr, 10);
+					pixels = std::malloc(static_cast<size_t>(width) * 4 * sizeof(float));
+					continue;
+				}
+				if (line.rfind("LUT_3D_SIZE", 0) == 0)
+				{
+					if (pixels != nullptr)
+						break;
+					width = height = depth = std::strtol(p + 11, nullptr, 10);
+					pixels = std::malloc(static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * 4 * sizeof(float));
+					continue;
 				}
+
+				// Line has no known keyword, so assume this is where the table data starts and roll back a line to continue reading that below
+				file.seekg(-static_cast<std::streampos>(line.size() + 1), std::ios::cur);
+				break;
 			}
-			else
+
+			// Read table data
+			if (pixels != nullptr)
 			{
-				// Read texture data into memory in one go since that is faster than reading chunk by chunk
-				std::vector<stbi_uc> file_data(static_cast<size_t>(file_size));
-				file.read(reinterpret_cast<char *>(file_data.data()), file_data.size());
-				file.close();
-
-				if (is_floating_point_format)
-					pixels = stbi_loadf_from_memory(file_data.data(), static_cast<int>(file_data.size()), &width, &height, &channels, STBI_rgb_alpha);
-				else if (stbi_dds_test_memory(file_data.data(), static_cast<int>(file_data.size())))
-					pixels = stbi_dds_load_from_memory(file_data.data(), static_cast<int>(file_data.size()), &width, &height, &depth, &channels, STBI_rgb_alpha);
-				else
-					pixels = stbi_load_from_memory(file_data.data(), static_cast<int>(file_data.size()), &width, &height, &channels, STBI_rgb_alpha);
+				size_t index = 0;
+				while (std::getline(file, line) && (index + 4) <= (static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * 4))
+				{
+					if (line.empty() || line[0] == '#')
+						continue; // Skip lines with comments
+
+					char *p = line.data();
+
+					static_cast<float *>(pixels)[index++] = static_cast<float>(std::strtod(p, &p)) * (domain_max[0] - domain_min[0]) + domain_min[0];
+					static_cast<float *>(pixels)[index++] = static_cast<float>(std::strtod(p, &p)) * (domain_max[1] - domain_min[1]) + domain_min[1];
+					static_cast<float *>(pixels)[index++] = static_cast<float>(std::strtod(p, &p)) * (domain_max[2] - domain_min[2]) + domain_min[2];
+					static_cast<float *>(pixels)[index++] = 1.0f;
+				}
 			}
 		}
-
-		if (ec || pixels == nullptr)
+		else
 		{
-			LOG(ERROR) << "Failed to load " << source_path << " for texture '" << tex.unique_name << "' with error code " << ec.value() << '!';
-			_last_reload_successful = false;
-			continue;
+			// Read texture data into memory in one go since that is faster than reading chunk by chunk
+			std::vector<stbi_uc> file_data(static_cast<size_t>(file_size));
+			file.read(reinterpret_cast<char *>(file_data.data()), file_data.size());
+			file.close();
+
+			if (is_floating_point_format)
+				pixels = stbi_loadf_from_memory(file_data.data(), static_cast<int>(file_data.size()), &width, &height, &channels, STBI_rgb_alpha);
+			else if (stbi_dds_test_memory(file_data.data(), static_cast<int>(file_data.size())))
+				pixels = stbi_dds_load_from_memory(file_data.data(), static_cast<int>(file_data.size()), &width, &height, &depth, &channels, STBI_rgb_alpha);
+			else
+				pixels = stbi_load_from_memory(file_data.data(), static_cast<int>(file_data.size()), &width, &height, &channels, STBI_rgb_alpha);
 		}
+	}
 
-		// Collapse data to the correct number of components per pixel based on the texture format
-		switch (tex.format)
-		{
-		case reshadefx::texture_format::r8:
-			for (size_t i = 4, k = 1; i < static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * 4; i += 4, k += 1)
-				static_cast<stbi_uc *>(pixels)[k] = static_cast<stbi_uc *>(pixels)[i];
-			break;
-		case reshadefx::texture_format::r32f:
-			for (size_t i = 4, k = 1; i < static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * 4; i += 4, k += 1)
-				static_cast<float *>(pixels)[k] = static_cast<float *>(pixels)[i];
-			break;
-		case reshadefx::texture_format::rg8:
-			for (size_t i = 4, k = 2; i < static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * 4; i += 4, k += 2)
-				static_cast<stbi_uc *>(pixels)[k + 0] = static_cast<stbi_uc *>(pixels)[i + 0],
-				static_cast<stbi_uc *>(pixels)[k + 1] = static_cast<stbi_uc *>(pixels)[i + 1];
-			break;
-		case reshadefx::texture_format::rg32f:
-			for (size_t i = 4, k = 2; i < static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * 4; i += 4, k += 2)
-				static_cast<float *>(pixels)[k + 0] = static_cast<float *>(pixels)[i + 0],
-				static_cast<float *>(pixels)[k + 1] = static_cast<float *>(pixels)[i + 1];
-			break;
-		case reshadefx::texture_format::rgba8:
-		case reshadefx::texture_format::rgba32f:
-			break;
-		default:
-			LOG(ERROR) << "Texture upload is not supported for format " << static_cast<int>(tex.format) << " of texture '" << tex.unique_name << "'!";
-			_last_reload_successful = false;
-			stbi_image_free(pixels);
-			continue;
-		}
+	if (ec || pixels == nullptr)
+	{
+		LOG(ERROR) << "Failed to load " << source_path << " for texture '" << tex.unique_name << "' with error code " << ec.value() << '!';
+		return false;
+	}
 
-		update_texture(tex, width, height, depth, pixels);
+	// Collapse data to the correct number of components per pixel based on the texture format
+	switch (tex.format)
+	{
+	case reshadefx::texture_format::r8:
+		for (size_t i = 4, k = 1; i < static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * 4; i += 4, k += 1)
+			static_cast<stbi_uc *>(pixels)[k] = static_cast<stbi_uc *>(pixels)[i];
+		break;
+	case reshadefx::texture_format::r32f:
+		for (size_t i = 4, k = 1; i < static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * 4; i += 4, k += 1)
+			static_cast<float *>(pixels)[k] = static_cast<float *>(pixels)[i];
+		break;
+	case reshadefx::texture_format::rg8:
+		for (size_t i = 4, k = 2; i < static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * 4; i += 4, k += 2)
+			static_cast<stbi_uc *>(pixels)[k + 0] = static_cast<stbi_uc *>(pixels)[i + 0],
+			static_cast<stbi_uc *>(pixels)[k + 1] = static_cast<stbi_uc *>(pixels)[i + 1];
+		break;
+	case reshadefx::texture_format::rg32f:
+		for (size_t i = 4, k = 2; i < static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * 4; i += 4, k += 2)
+			static_cast<float *>(pixels)[k + 0] = static_cast<float *>(pixels)[i + 0],
+			static_cast<float *>(pixels)[k + 1] = static_cast<float *>(pixels)[i + 1];
+		break;
+	case reshadefx::texture_format::rgba8:
+	case reshadefx::texture_format::rgba32f:
+		break;
+	default:
+		LOG(ERROR) << "Texture upload is not supported for format " << static_cast<int>(tex.format) << " of texture '" << tex.unique_name << "'!";
+		stbi_image_free(pixels);
+		return false;
+	}
 
+	if (tex.depth != static_cast<uint32_t>(depth) || (tex.depth != 1 && (tex.width != static_cast<uint32_t>(width) || tex.height != static_cast<uint32_t>(height))))
+	{
+		LOG(ERROR) << "Resizing image data is not supported for 3D textures like '" << tex.unique_name << "'.";
 		stbi_image_free(pixels);
+		return false;
+	}
 
-		tex.loaded = true;
+	data.resize(data_size);
+
+	// Need to potentially resize image data to the texture dimensions
+	if (tex.width != static_cast<uint32_t>(width) || tex.height != static_cast<uint32_t>(height))
+	{
+		LOG(INFO) << "Resizing image data for texture '" << tex.unique_name << "' from " << width << "x" << height << " to " << tex.width << "x" << tex.height << '.';
+
+		if (stbir_resize(pixels, width, height, 0, data.data(), tex.width, tex.height, 0, pixel_layout, data_type, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT) == nullptr)
+			data.clear();
+	}
+	else
+	{
+		std::memcpy(data.data(), pixels, data_size);
+	}
+
+	stbi_image_free(pixels);
+
+	if (data.empty())
+	{
+		LOG(ERROR) << "Failed to resize image data for texture '" << tex.unique_name << "'!";
+		return false;
 	}
 
-	_textures_loaded = true;
+	save_effect_cache(cache_id, "tex", std::string(reinterpret_cast<const char *>(data.data()), data.size()));
+
+	return true;
 }
 bool reshade::runtime::create_texture(texture &tex)
 {
@@ -3313,13 +3998,37 @@ bool reshade::runtime::create_texture(texture &tex)
 		}
 	}
 
-	if (!_device->create_resource(api::resource_desc(type, tex.width, tex.height, tex.depth, tex.levels, format, 1, api::memory_heap::gpu_only, usage, flags), initial_data.data(), api::resource_usage::shader_resource, &tex.resource))
+	const api::resource_desc desc(type, tex.width, tex.height, tex.depth, tex.levels, format, 1, api::memory_heap::gpu_only, usage, flags);
+
+	if (!tex.transient_technique.empty())
 	{
-		LOG(ERROR) << "Failed to create texture '" << tex.unique_name << "' (width = " << tex.width << ", height = " << tex.height << ", levels = " << tex.levels << ", format = " << static_cast<uint32_t>(format) << ", usage = " << std::hex << static_cast<uint32_t>(usage) << std::dec << ")! Make sure the texture dimensions are reasonable.";
-		return false;
+		// Share resource with a transient texture of the same description that is used in a different technique
+		const auto it = std::find_if(_transient_resources.begin(), _transient_resources.end(),
+			[&tex, &desc](const transient_resource &item) {
+				return item.desc.type == desc.type && item.desc.texture.width == desc.texture.width && item.desc.texture.height == desc.texture.height && item.desc.texture.depth_or_layers == desc.texture.depth_or_layers &&
+					item.desc.texture.levels == desc.texture.levels && item.desc.texture.format == desc.texture.format && item.desc.usage == desc.usage && item.desc.flags == desc.flags &&
+					std::find(item.techniques.cbegin(), item.techniques.cend(), std::make_pair(tex.effect_index, tex.transient_technique)) == item.techniques.cend();
+			});
+		if (it != _transient_resources.end())
+		{
+			it->techniques.emplace_back(tex.effect_index, tex.transient_technique);
+			tex.resource = it->resource;
+		}
 	}
 
-	_device->set_resource_name(tex.resource, tex.unique_name.c_str());
+	if (tex.resource == 0)
+	{
+		if (!_device->create_resource(desc, initial_data.data(), api::resource_usage::shader_resource, &tex.resource))
+		{
+			LOG(ERROR) << "Failed to create texture '" << tex.unique_name << "' (width = " << tex.width << ", height = " << tex.height << ", levels = " << tex.levels << ", format = " << static_cast<uint32_t>(format) << ", usage = " << std::hex << static_cast<uint32_t>(usage) << std::dec << ")! Make sure the texture dimensions are reasonable.";
+			return false;
+		}
+
+		_device->set_resource_name(tex.resource, tex.unique_name.c_str());
+
+		if (!tex.transient_technique.empty())
+			_transient_resources.push_back({ desc, tex.resource, { std::make_pair(tex.effect_index, tex.transient_technique) } });
+	}
 
 	// Always create shader resource views
 	{
@@ -3388,7 +4097,22 @@ void reshade::runtime::destroy_texture(texture &tex)
 		_preview_texture.handle = 0;
 #endif
 
-	_device->destroy_resource(tex.resource);
+	if (const auto it = std::find_if(_transient_resources.begin(), _transient_resources.end(),
+			[&tex](const transient_resource &item) { return item.resource == tex.resource; });
+		tex.resource != 0 && it != _transient_resources.end())
+	{
+		// Only destroy a shared resource once the last texture using it is gone
+		it->techniques.erase(std::remove(it->techniques.begin(), it->techniques.end(), std::make_pair(tex.effect_index, tex.transient_technique)), it->techniques.end());
+		if (it->techniques.empty())
+		{
+			_device->destroy_resource(tex.resource);
+			_transient_resources.erase(it);
+		}
+	}
+	else
+	{
+		_device->destroy_resource(tex.resource);
+	}
 	tex.resource = {};
 
 	_device->destroy_resource_view(tex.srv[0]);
@@ -3459,6 +4183,14 @@ void reshade::runtime::disable_technique(technique &tech)
 	tech.time_left = 0;
 	tech.average_cpu_duration.clear();
 	tech.average_gpu_duration.clear();
+	tech.average_gpu_transition_duration.clear();
+	tech.governor_skipped_frame = 0;
+	for (technique::pass_data &pass_data : tech.passes_data)
+	{
+		pass_data.average_cpu_duration.clear();
+		pass_data.average_gpu_duration.clear();
+		pass_data.average_gpu_transition_duration.clear();
+	}
 
 	if (status_changed) // Decrease rendering reference count
 		_effects[tech.effect_index].rendering--;
@@ -3535,6 +4267,20 @@ void reshade::runtime::load_effects(bool force_load_all)
 	// Allocate space for effects which are placed in this array during the 'load_effect' call
 	const size_t offset = _effects.size();
 	_effects.resize(offset + effect_files.size());
+
+	std::vector<std::pair<std::filesystem::path, size_t>> effect_files_and_indices;
+	effect_files_and_indices.reserve(effect_files.size());
+	for (size_t i = 0; i < effect_files.size(); ++i)
+		effect_files_and_indices.emplace_back(effect_files[i], offset + i);
+
+	load_effects_async(std::move(effect_files_and_indices), force_load_all);
+}
+void reshade::runtime::load_effects_async(std::vector<std::pair<std::filesystem::path, size_t>> &&effect_files, bool force_load_all)
+{
+	assert(!effect_files.empty());
+
+	ini_file &preset = ini_file::load_cache(_current_preset_path);
+
 	_reload_remaining_effects = effect_files.size();
 
 	// Now that we have a list of files, load them in parallel
@@ -3545,13 +4291,18 @@ void reshade::runtime::load_effects(bool force_load_all)
 	num_splits = std::min(num_splits, static_cast<size_t>(4));
 #endif
 
+	// Share the file list between all threads, rather than copying it into each of them
+	const std::shared_ptr<const std::vector<std::pair<std::filesystem::path, size_t>>> shared_effect_files =
+		std::make_shared<const std::vector<std::pair<std::filesystem::path, size_t>>>(std::move(effect_files));
+
 	// Keep track of the spawned threads, so the runtime cannot be destroyed while they are still running
 	for (size_t n = 0; n < num_splits; ++n)
-		_worker_threads.emplace_back([this, effect_files, offset, num_splits, n, &preset, force_load_all]() {
+		_worker_threads.emplace_back([this, shared_effect_files, num_splits, n, &preset, force_load_all]() {
+			const std::vector<std::pair<std::filesystem::path, size_t>> &effect_files = *shared_effect_files;
 			// Abort loading when initialization state changes (indicating that 'on_reset' was called in the meantime)
 			for (size_t i = 0; i < effect_files.size() && _is_initialized; ++i)
 				if (i * num_splits / effect_files.size() == n)
-					load_effect(effect_files[i], preset, offset + i, force_load_all || effect_files[i].extension() == L".addonfx");
+					load_effect(effect_files[i].first, preset, effect_files[i].second, force_load_all || effect_files[i].first.extension() == L".addonfx");
 		});
 }
 bool reshade::runtime::reload_effect(size_t effect_index)
@@ -3563,6 +4314,8 @@ bool reshade::runtime::reload_effect(size_t effect_index)
 	// Make sure no effect resources are currently in use
 	_graphics_queue->wait_idle();
 
+	wait_for_effect_compilation(effect_index);
+
 	const std::filesystem::path source_file = _effects[effect_index].source_file;
 	destroy_effect(effect_index);
 
@@ -3576,6 +4329,97 @@ bool reshade::runtime::reload_effect(size_t effect_index)
 
 	return load_effect(source_file, ini_file::load_cache(_current_preset_path), effect_index, true, true);
 }
+bool reshade::runtime::reload_changed_effects()
+{
+	// Cannot reload individual effects while others are still being loaded in the background
+	if (_reload_remaining_effects != std::numeric_limits<size_t>::max())
+	{
+		reload_effects();
+		return true;
+	}
+
+	const auto find_definition = [](const std::vector<std::pair<std::string, std::string>> &definitions, const std::string &name) {
+		return std::find_if(definitions.cbegin(), definitions.cend(),
+			[&name](const std::pair<std::string, std::string> &definition) { return definition.first == name; });
+	};
+
+	const ini_file &preset = ini_file::load_cache(_current_preset_path);
+
+	std::vector<size_t> affected_effects;
+	for (size_t effect_index = 0; effect_index < _effects.size(); ++effect_index)
+	{
+		const effect &effect = _effects[effect_index];
+		// Effects that were skipped during loading are loaded again anyway once their techniques are enabled
+		if (effect.source_file.empty() || (effect.skipped && !effect.compiled))
+			continue;
+
+		const std::string effect_name = effect.source_file.filename().u8string();
+		const std::vector<std::pair<std::string, std::string>> preprocessor_definitions = get_effect_preprocessor_definitions(effect_name);
+
+		bool affected = !effect.compiled;
+		// In performance mode preset values are compile-time constants, so effects need to be recompiled when those changed
+		if (!affected && _performance_mode)
+			affected = calc_spec_constant_preset_hash(effect.module, effect_name, preset) != effect.spec_constant_hash;
+
+		if (!affected && !effect.referenced_macros_known)
+		{
+			// Do not know which macros this effect depends on (e.g. because it was loaded from an old cache), so need to compare all of them
+			affected = preprocessor_definitions != effect.preprocessor_definitions;
+		}
+
+		// Only the first occurrence of a definition is used (see 'load_effect'), so compare those
+		for (size_t i = 0; i < effect.referenced_macros.size() && !affected; ++i)
+		{
+			const auto old_it = find_definition(effect.preprocessor_definitions, effect.referenced_macros[i]);
+			const auto new_it = find_definition(preprocessor_definitions, effect.referenced_macros[i]);
+			affected = (old_it == effect.preprocessor_definitions.cend()) != (new_it == preprocessor_definitions.cend()) ||
+				(old_it != effect.preprocessor_definitions.cend() && old_it->second != new_it->second);
+		}
+
+		if (affected)
+			affected_effects.push_back(effect_index);
+	}
+
+	if (affected_effects.empty())
+		return false;
+
+	if (affected_effects.size() == _effects.size())
+	{
+		reload_effects();
+		return true;
+	}
+
+	LOG(INFO) << "Reloading " << affected_effects.size() << " out of " << _effects.size() << " effects affected by changed preprocessor definitions or preset values ...";
+
+	// Make sure no effect resources are currently in use
+	_graphics_queue->wait_idle();
+
+	std::vector<std::pair<std::filesystem::path, size_t>> effect_files;
+	effect_files.reserve(affected_effects.size());
+
+	for (const size_t effect_index : affected_effects)
+	{
+		wait_for_effect_compilation(effect_index);
+
+		_reload_create_queue.erase(std::remove(_reload_create_queue.begin(), _reload_create_queue.end(), effect_index), _reload_create_queue.end());
+
+		effect_files.emplace_back(_effects[effect_index].source_file, effect_index);
+		destroy_effect(effect_index);
+
+		// Force the effect to be loaded from scratch, since the source hash does not cover preset values
+		_effects[effect_index].source_hash = 0;
+	}
+
+#if RESHADE_ADDON
+	// Call event after destroying the effects, so add-ons get a chance to release any handles they hold to variables and techniques
+	invoke_addon_event<addon_event::reshade_reloaded_effects>(this);
+#endif
+
+	_last_reload_successful = true;
+
+	load_effects_async(std::move(effect_files), false);
+	return true;
+}
 void reshade::runtime::reload_effects(bool force_load_all)
 {
 	// Clear out any previous effects
@@ -3595,6 +4439,21 @@ void reshade::runtime::reload_effects(bool force_load_all)
 
 	load_effects(force_load_all);
 }
+void reshade::runtime::wait_for_effect_compilation(size_t effect_index)
+{
+	// Make sure the effect is not still being compiled in the background
+	if (const auto it = std::find_if(_lazy_compile_threads.begin(), _lazy_compile_threads.end(),
+			[effect_index](const std::pair<size_t, std::thread> &item) { return item.first == effect_index; });
+		it != _lazy_compile_threads.end())
+	{
+		it->second.join();
+		_lazy_compile_threads.erase(it);
+
+		const std::unique_lock<std::mutex> lock(_lazy_compile_mutex);
+		_lazy_compile_finished.erase(std::remove_if(_lazy_compile_finished.begin(), _lazy_compile_finished.end(),
+			[effect_index](const std::pair<size_t, effect_assembly> &item) { return item.first == effect_index; }), _lazy_compile_finished.end());
+	}
+}
 void reshade::runtime::destroy_effects()
 {
 	// Make sure no threads are still accessing effect data
@@ -3602,6 +4461,10 @@ void reshade::runtime::destroy_effects()
 		if (thread.joinable())
 			thread.join();
 	_worker_threads.clear();
+	for (std::pair<size_t, std::thread> &thread : _lazy_compile_threads)
+		thread.second.join();
+	_lazy_compile_threads.clear();
+	_lazy_compile_finished.clear();
 
 #if RESHADE_GUI
 	_effect_filter[0] = '\0';
@@ -3618,12 +4481,16 @@ void reshade::runtime::destroy_effects()
 
 	// Reset the effect list after all resources have been destroyed
 	_effects.clear();
+	_effect_uniforms_version++;
 
 	// Clean up sampler objects
 	for (const auto &[hash, sampler] : _effect_sampler_states)
 		_device->destroy_sampler(sampler);
 	_effect_sampler_states.clear();
 
+	// Cached permutations refer to effects that no longer exist (and source files that may have changed since), so drop them too
+	_effect_permutation_cache.clear();
+
 	// Unload HLSL compiler which was previously loaded in 'load_effects' above
 	if (_d3d_compiler_module)
 	{
@@ -3637,6 +4504,7 @@ void reshade::runtime::destroy_effects()
 
 	_textures_loaded = false;
 	_should_reload_effect = std::numeric_limits<size_t>::max();
+	_should_reload_affected_effects = false;
 }
 
 bool reshade::runtime::load_effect_cache(const std::string &id, const std::string &type, std::string &data) const
@@ -3675,8 +4543,120 @@ bool reshade::runtime::save_effect_cache(const std::string &id, const std::strin
 	file.write(data.data(), data.size());
 	return !file.fail();
 }
+
+// Increase this whenever the layout written in 'save_effect_metadata' changes
+static constexpr uint32_t s_effect_metadata_version = 2;
+
+bool reshade::runtime::load_effect_metadata(const std::string &id, effect &effect, std::string &code_preamble, bool &skip_optimization) const
+{
+	std::string data;
+	if (!load_effect_cache(id, "meta", data))
+		return false;
+
+	size_t offset = 0;
+	const auto read_uint = [&data, &offset](uint32_t &value) {
+		if (data.size() - offset < sizeof(value))
+			return false;
+		std::memcpy(&value, data.data() + offset, sizeof(value));
+		offset += sizeof(value);
+		return true;
+	};
+	const auto read_string = [&data, &offset, &read_uint](std::string &value) {
+		uint32_t size = 0;
+		if (!read_uint(size) || data.size() - offset < size)
+			return false;
+		value.assign(data.data() + offset, size);
+		offset += size;
+		return true;
+	};
+
+	uint32_t version = 0, flags = 0, num_definitions = 0, num_included_files = 0;
+	std::string preamble;
+	if (!read_uint(version) || version != s_effect_metadata_version ||
+		!read_uint(flags) || (flags & 0x1) != (_no_debug_info ? 0u : 1u) || // Module differs depending on whether debug information is included
+		!read_string(preamble) ||
+		!read_uint(num_definitions) || num_definitions > data.size() - offset)
+		return false;
+
+	std::vector<std::pair<std::string, std::string>> definitions(num_definitions);
+	for (std::pair<std::string, std::string> &definition : definitions)
+		if (!read_string(definition.first) || !read_string(definition.second))
+			return false;
+
+	if (!read_uint(num_included_files) || num_included_files > data.size() - offset)
+		return false;
+
+	std::vector<std::filesystem::path> included_files(num_included_files);
+	for (std::filesystem::path &included_file : included_files)
+	{
+		std::string included_file_string;
+		if (!read_string(included_file_string))
+			return false;
+		included_file = std::filesystem::u8path(included_file_string);
+	}
+
+	uint32_t num_referenced_macros = 0;
+	if (!read_uint(num_referenced_macros) || num_referenced_macros > data.size() - offset)
+		return false;
+
+	std::vector<std::string> referenced_macros(num_referenced_macros);
+	for (std::string &referenced_macro : referenced_macros)
+		if (!read_string(referenced_macro))
+			return false;
+
+	if (!reshadefx::deserialize_module(effect.module, data, offset))
+		return false;
+
+	code_preamble = std::move(preamble);
+	skip_optimization = (flags & 0x2) != 0;
+	effect.definitions = std::move(definitions);
+	effect.included_files = std::move(included_files);
+	effect.referenced_macros = std::move(referenced_macros);
+	effect.referenced_macros_known = true;
+	return true;
+}
+bool reshade::runtime::save_effect_metadata(const std::string &id, const effect &effect, const std::string &code_preamble, bool skip_optimization) const
+{
+	std::string data;
+	const auto write_uint = [&data](uint32_t value) {
+		data.append(reinterpret_cast<const char *>(&value), sizeof(value));
+	};
+	const auto write_string = [&data, &write_uint](const std::string &value) {
+		write_uint(static_cast<uint32_t>(value.size()));
+		data.append(value);
+	};
+
+	write_uint(s_effect_metadata_version);
+	write_uint((_no_debug_info ? 0x0 : 0x1) | (skip_optimization ? 0x2 : 0x0));
+	write_string(code_preamble);
+
+	write_uint(static_cast<uint32_t>(effect.definitions.size()));
+	for (const std::pair<std::string, std::string> &definition : effect.definitions)
+	{
+		write_string(definition.first);
+		write_string(definition.second);
+	}
+
+	write_uint(static_cast<uint32_t>(effect.included_files.size()));
+	for (const std::filesystem::path &included_file : effect.included_files)
+		write_string(included_file.u8string());
+
+	write_uint(static_cast<uint32_t>(effect.referenced_macros.size()));
+	for (const std::string &referenced_macro : effect.referenced_macros)
+		write_string(referenced_macro);
+
+	reshadefx::serialize_module(effect.module, data);
+
+	return save_effect_cache(id, "meta", data);
+}
+
 void reshade::runtime::clear_effect_cache()
 {
+	{
+		const std::unique_lock<std::mutex> lock(_effect_permutation_cache_mutex);
+		_effect_permutation_cache.clear();
+	}
+
 	std::error_code ec;
 
 	// Find all cached effect files and delete them
@@ -3687,7 +4667,7 @@ void reshade::runtime::clear_effect_cache()
 
 		const std::filesystem::path filename = entry.path().filename();
 		const std::filesystem::path extension = entry.path().extension();
-		if (filename.native().compare(0, 8, L"reshade-") != 0 || (extension != L".i" && extension != L".cso" && extension != L".asm"))
+		if (filename.native().compare(0, 8, L"reshade-") != 0 || (extension != L".i" && extension != L".meta" && extension != L".cso" && extension != L".asm" && extension != L".tex"))
 			continue;
 
 		std::filesystem::remove(entry, ec);
@@ -3800,6 +4780,15 @@ void reshade::runtime::update_effects()
 	if (_frame_count == 0 && !_no_reload_on_init)
 		reload_effects();
 
+	if (_should_reload_affected_effects && !is_loading())
+	{
+		save_current_preset(); // Save preset preprocessor definitions
+
+		reload_changed_effects();
+
+		_should_reload_affected_effects = false;
+	}
+
 	if (_should_reload_effect != std::numeric_limits<size_t>::max() && !is_loading())
 	{
 		save_current_preset(); // Save preset preprocessor definitions
@@ -3857,12 +4846,62 @@ void reshade::runtime::update_effects()
 	if (_reload_remaining_effects != std::numeric_limits<size_t>::max())
 		return;
 
+	if (!_lazy_compile_threads.empty())
+	{
+		std::vector<std::pair<size_t, effect_assembly>> finished_effects;
+		{
+			const std::unique_lock<std::mutex> lock(_lazy_compile_mutex);
+			finished_effects.swap(_lazy_compile_finished);
+		}
+
+		for (auto &[effect_index, output] : finished_effects)
+		{
+			if (const auto it = std::find_if(_lazy_compile_threads.begin(), _lazy_compile_threads.end(),
+					[effect_index = effect_index](const std::pair<size_t, std::thread> &item) { return item.first == effect_index; });
+				it != _lazy_compile_threads.end())
+			{
+				it->second.join();
+				_lazy_compile_threads.erase(it);
+			}
+
+			// Hand the compilation results over to the effect, which the overlay only shows once it is no longer marked as skipped
+			effect &effect = _effects[effect_index];
+			effect.skipped = false;
+			effect.compiled = output.compiled;
+			effect.errors += output.errors;
+			effect.assembly = std::move(output.assembly);
+			effect.assembly_text = std::move(output.assembly_text);
+
+			if (!effect.compiled)
+			{
+				// Disable all techniques belonging to this effect
+				for (technique &tech : _techniques)
+					if (tech.effect_index == effect_index)
+						disable_technique(tech);
+
+				_last_reload_successful = false;
+			}
+			else if (effect.rendering != 0 && std::find(_reload_create_queue.cbegin(), _reload_create_queue.cend(), effect_index) == _reload_create_queue.cend())
+			{
+				// Shader modules are available now, so can finally create the effect
+				_reload_create_queue.push_back(effect_index);
+			}
+		}
+	}
+
 	if (!_reload_create_queue.empty())
 	{
 		// Pop an effect from the queue
 		const size_t effect_index = _reload_create_queue.back();
 		_reload_create_queue.pop_back();
 
+		if (_effects[effect_index].skipped)
+		{
+			// Effect was only parsed so far, so compile its shader modules in the background first (it is queued again for creation once that finished)
+			compile_effect_async(effect_index);
+			return;
+		}
+
 		if (!create_effect(effect_index))
 		{
 			_graphics_queue->wait_idle();
@@ -3931,14 +4970,21 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 		input_lock = _input->lock();
 
 	// Update special uniform variables
+	bool date_value_valid = false;
+	int date_value[4] = {};
+
 	for (effect &effect : _effects)
 	{
 		if (!effect.rendering)
 			continue;
 
-		for (uniform &variable : effect.uniforms)
+		const special_uniform_updates &updates = effect.special_uniforms;
+
+		for (size_t i = 0; i < updates.size(); ++i)
 		{
-			switch (variable.special)
+			uniform &variable = effect.uniforms[updates.uniform_index[i]];
+
+			switch (updates.type[i])
 			{
 				case special_uniform::frame_time:
 				{
@@ -3955,19 +5001,19 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 				}
 				case special_uniform::random:
 				{
-					const int min = variable.annotation_as_int("min", 0, 0);
-					const int max = variable.annotation_as_int("max", 0, RAND_MAX);
+					const int min = updates.int_min[i];
+					const int max = updates.int_max[i];
 					set_uniform_value(variable, min + (std::rand() % (std::abs(max - min) + 1)));
 					break;
 				}
 				case special_uniform::ping_pong:
 				{
-					const float min = variable.annotation_as_float("min", 0, 0.0f);
-					const float max = variable.annotation_as_float("max", 0, 1.0f);
-					const float step_min = variable.annotation_as_float("step", 0);
-					const float step_max = variable.annotation_as_float("step", 1);
+					const float min = updates.min[i];
+					const float max = updates.max[i];
+					const float step_min = updates.step_min[i];
+					const float step_max = updates.step_max[i];
 					float increment = step_max == 0 ? step_min : (step_min + std::fmod(static_cast<float>(std::rand()), step_max - step_min + 1));
-					const float smoothing = variable.annotation_as_float("smoothing");
+					const float smoothing = updates.smoothing[i];
 
 					float value[2] = { 0, 0 };
 					get_uniform_value(variable, value, 2);
@@ -3992,16 +5038,20 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 				}
 				case special_uniform::date:
 				{
-					const std::time_t t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-					struct tm tm; localtime_s(&tm, &t);
-
-					const int value[4] = {
-						tm.tm_year + 1900,
-						tm.tm_mon + 1,
-						tm.tm_mday,
-						tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec
-					};
-					set_uniform_value(variable, value, 4);
+					// Only query the date once per frame
+					if (!date_value_valid)
+					{
+						const std::time_t t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+						struct tm tm; localtime_s(&tm, &t);
+
+						date_value[0] = tm.tm_year + 1900;
+						date_value[1] = tm.tm_mon + 1;
+						date_value[2] = tm.tm_mday;
+						date_value[3] = tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+						date_value_valid = true;
+					}
+
+					set_uniform_value(variable, date_value, 4);
 					break;
 				}
 				case special_uniform::timer:
@@ -4015,21 +5065,24 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 					if (_input == nullptr)
 						break;
 
-					if (const int keycode = variable.annotation_as_int("keycode");
-						keycode > 7 && keycode < 256)
+					const int keycode = updates.keycode[i];
+
+					switch (updates.mode[i])
 					{
-						if (const std::string_view mode = variable.annotation_as_string("mode");
-							mode == "toggle" || variable.annotation_as_int("toggle"))
+					case special_uniform_updates::key_mode::toggle:
+						if (_input->is_key_pressed(keycode))
 						{
 							bool current_value = false;
 							get_uniform_value(variable, &current_value);
-							if (_input->is_key_pressed(keycode))
-								set_uniform_value(variable, !current_value);
+							set_uniform_value(variable, !current_value);
 						}
-						else if (mode == "press")
-							set_uniform_value(variable, _input->is_key_pressed(keycode));
-						else
-							set_uniform_value(variable, _input->is_key_down(keycode));
+						break;
+					case special_uniform_updates::key_mode::press:
+						set_uniform_value(variable, _input->is_key_pressed(keycode));
+						break;
+					default:
+						set_uniform_value(variable, _input->is_key_down(keycode));
+						break;
 					}
 					break;
 				}
@@ -4054,21 +5107,24 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 					if (_input == nullptr)
 						break;
 
-					if (const int keycode = variable.annotation_as_int("keycode");
-						keycode >= 0 && keycode < 5)
+					const int keycode = updates.keycode[i];
+
+					switch (updates.mode[i])
 					{
-						if (const std::string_view mode = variable.annotation_as_string("mode");
-							mode == "toggle" || variable.annotation_as_int("toggle"))
+					case special_uniform_updates::key_mode::toggle:
+						if (_input->is_mouse_button_pressed(keycode))
 						{
 							bool current_value = false;
 							get_uniform_value(variable, &current_value);
-							if (_input->is_mouse_button_pressed(keycode))
-								set_uniform_value(variable, !current_value);
+							set_uniform_value(variable, !current_value);
 						}
-						else if (mode == "press")
-							set_uniform_value(variable, _input->is_mouse_button_pressed(keycode));
-						else
-							set_uniform_value(variable, _input->is_mouse_button_down(keycode));
+						break;
+					case special_uniform_updates::key_mode::press:
+						set_uniform_value(variable, _input->is_mouse_button_pressed(keycode));
+						break;
+					default:
+						set_uniform_value(variable, _input->is_mouse_button_down(keycode));
+						break;
 					}
 					break;
 				}
@@ -4077,11 +5133,9 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 					if (_input == nullptr)
 						break;
 
-					const float min = variable.annotation_as_float("min");
-					const float max = variable.annotation_as_float("max");
-					float step = variable.annotation_as_float("step");
-					if (step == 0.0f)
-						step  = 1.0f;
+					const float min = updates.min[i];
+					const float max = updates.max[i];
+					const float step = updates.step_min[i];
 
 					float value[2] = { 0, 0 };
 					get_uniform_value(variable, value, 2);
@@ -4115,6 +5169,11 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 					set_uniform_value(variable, _should_save_screenshot);
 					break;
 				}
+				case special_uniform::render_scale:
+				{
+					set_uniform_value(variable, effect.render_scale);
+					break;
+				}
 			}
 		}
 	}
@@ -4153,6 +5212,10 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 	cmd_list->begin_debug_event("ReShade effects");
 #endif
 
+	// Application may have modified constant registers and bound state since the last frame
+	_uniform_push_effect_index = std::numeric_limits<size_t>::max();
+	_effect_bind_state = {};
+
 	// Render all enabled techniques
 	for (size_t technique_index : _technique_sorting)
 	{
@@ -4160,6 +5223,8 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 
 		if (tech.passes_data.empty() || !tech.enabled || (_should_save_screenshot && !tech.enabled_in_screenshot))
 			continue; // Ignore techniques that are not fully loaded or currently disabled
+		if (tech.governor_skipped_frame != 0 && !_should_save_screenshot)
+			continue; // Ignore techniques the performance governor skips to meet the frame time budget (but keep them in screenshots)
 
 		render_technique(tech, cmd_list, back_buffer_resource, rtv, rtv_srgb);
 
@@ -4182,47 +5247,290 @@ void reshade::runtime::render_effects(api::command_list *cmd_list, api::resource
 		apply_state(cmd_list, _app_state);
 #endif
 }
+void reshade::runtime::update_performance_governor()
+{
+	// Lowest render scale the governor degrades effects to, and how much it changes the render scale in each step
+	constexpr float min_render_scale = 0.5f;
+	constexpr float render_scale_step = 0.125f;
+	// Frame time has to drop below this fraction of the budget before quality is restored again, so that the governor does not oscillate around the budget
+	constexpr float restore_threshold = 0.85f;
+	// Number of frames to wait after every change, so that the averaged timings reflect it before the next decision
+	constexpr uint64_t settle_frames = 60;
+
+	if (_frame_time_budget <= 0.0f || !_effects_enabled || is_loading())
+	{
+		// Restore full quality when the governor is disabled
+		if (_governor_active)
+		{
+			for (effect &effect : _effects)
+				effect.render_scale = 1.0f;
+			for (technique &tech : _techniques)
+				tech.governor_skipped_frame = 0;
+
+			_governor_active = false;
+		}
+
+		_governor_frame_time = 0.0f;
+		return;
+	}
+
+	const float frame_time = std::chrono::duration_cast<std::chrono::nanoseconds>(_last_frame_duration).count() * 1e-6f;
+	_governor_frame_time = _governor_frame_time == 0.0f ? frame_time : _governor_frame_time + (frame_time - _governor_frame_time) * 0.05f;
+
+	if (_frame_count < _governor_next_frame)
+		return;
+
+	if (_governor_frame_time > _frame_time_budget)
+	{
+		// Degrade the effect that currently takes the most GPU time first, by lowering its render scale (only effects that actually read it can be degraded this way)
+		std::vector<uint64_t> effect_gpu_durations(_effects.size());
+		for (const technique &tech : _techniques)
+			if (tech.enabled && tech.governor_skipped_frame == 0)
+				effect_gpu_durations[tech.effect_index] += tech.average_gpu_duration;
+
+		size_t heaviest_effect_index = std::numeric_limits<size_t>::max();
+		for (size_t effect_index = 0; effect_index < _effects.size(); ++effect_index)
+			if (_effects[effect_index].rendering && _effects[effect_index].render_scale > min_render_scale &&
+				std::find(_effects[effect_index].special_uniforms.type.cbegin(), _effects[effect_index].special_uniforms.type.cend(), special_uniform::render_scale) != _effects[effect_index].special_uniforms.type.cend() &&
+				(heaviest_effect_index == std::numeric_limits<size_t>::max() || effect_gpu_durations[effect_index] > effect_gpu_durations[heaviest_effect_index]))
+				heaviest_effect_index = effect_index;
+
+		if (heaviest_effect_index != std::numeric_limits<size_t>::max())
+		{
+			effect &effect = _effects[heaviest_effect_index];
+			effect.render_scale = std::max(effect.render_scale - render_scale_step, min_render_scale);
+		}
+		else
+		{
+			// All effects are at the lowest render scale already, so skip whole techniques, starting with those of the lowest priority (as set by the "priority" annotation) and then the most expensive ones
+			technique *skipped_tech = nullptr;
+			for (technique &tech : _techniques)
+			{
+				if (!tech.enabled || tech.governor_skipped_frame != 0 || tech.passes_data.empty())
+					continue;
+
+				if (skipped_tech == nullptr ||
+					tech.annotation_as_int("priority") < skipped_tech->annotation_as_int("priority") ||
+					(tech.annotation_as_int("priority") == skipped_tech->annotation_as_int("priority") && tech.average_gpu_duration > skipped_tech->average_gpu_duration))
+					skipped_tech = &tech;
+			}
+
+			if (skipped_tech == nullptr)
+				return;
+
+			skipped_tech->governor_skipped_frame = _frame_count;
+
+			LOG(INFO) << "Skipping technique " << skipped_tech->name << " to meet frame time budget of " << _frame_time_budget << " ms.";
+		}
+
+		_governor_active = true;
+		_governor_next_frame = _frame_count + settle_frames;
+	}
+	else if (_governor_active && _governor_frame_time < _frame_time_budget * restore_threshold)
+	{
+		// Restore the most recently skipped technique first, but only if its last known cost still fits into the budget
+		technique *restored_tech = nullptr;
+		for (technique &tech : _techniques)
+			if (tech.governor_skipped_frame != 0 && (restored_tech == nullptr || tech.governor_skipped_frame > restored_tech->governor_skipped_frame))
+				restored_tech = &tech;
+
+		if (restored_tech != nullptr)
+		{
+			if (_governor_frame_time + restored_tech->average_gpu_duration * 1e-6f >= _frame_time_budget * restore_threshold)
+				return;
+
+			restored_tech->governor_skipped_frame = 0;
+
+			LOG(INFO) << "Restoring technique " << restored_tech->name << " after frame time dropped below budget.";
+		}
+		else
+		{
+			// Then raise the render scale of the most degraded effect again
+			effect *restored_effect = nullptr;
+			for (effect &effect : _effects)
+				if (effect.render_scale < 1.0f && (restored_effect == nullptr || effect.render_scale < restored_effect->render_scale))
+					restored_effect = &effect;
+
+			if (restored_effect == nullptr)
+			{
+				_governor_active = false;
+				return;
+			}
+
+			restored_effect->render_scale = std::min(restored_effect->render_scale + render_scale_step, 1.0f);
+		}
+
+		_governor_next_frame = _frame_count + settle_frames;
+	}
+}
+
 void reshade::runtime::render_technique(technique &tech, api::command_list *cmd_list, api::resource back_buffer_resource, api::resource_view back_buffer_rtv, api::resource_view back_buffer_rtv_srgb)
 {
-	const effect &effect = _effects[tech.effect_index];
+	effect &effect = _effects[tech.effect_index];
 
+	// Only gather GPU timings while they are actually looked at, since reading back query results is not free
+	bool gather_gpu_timings = _timing_capture_last_frame != 0 || _frame_count < _timings_requested_until_frame || _frame_time_budget > 0.0f;
 #if RESHADE_GUI
-	if (_gather_gpu_statistics && _timestamp_frequency != 0 && effect.query_heap != 0)
+	gather_gpu_timings = gather_gpu_timings || _gather_gpu_statistics;
+#endif
+	gather_gpu_timings = gather_gpu_timings && _timestamp_frequency != 0 && effect.query_heap != 0;
+
+	const bool capture_cpu_timings = _timing_capture_last_frame != 0 && _frame_count >= _timing_capture_first_frame && _frame_count < _timing_capture_last_frame;
+
+	const auto pass_timing_name = [&tech](size_t pass_index) {
+		const std::string &pass_name = tech.passes[pass_index].name;
+		return tech.name + '/' + (pass_name.empty() ? "Pass " + std::to_string(pass_index) : pass_name);
+	};
+
+	const uint32_t query_count = tech.query_count();
+	const uint32_t query_base_index = tech.query_base_index + (_frame_count % 4) * query_count;
+
+	if (gather_gpu_timings)
 	{
 		// Evaluate queries from oldest frame in queue
-		if (uint64_t timestamps[2];
-			_device->get_query_heap_results(effect.query_heap, tech.query_base_index + (_frame_count % 4) * 2, 2, timestamps, sizeof(uint64_t)))
-			tech.average_gpu_duration.append((timestamps[1] - timestamps[0]) * 1000000000ull / _timestamp_frequency);
+		if (temp_mem<uint64_t, 32> timestamps(query_count);
+			_device->get_query_heap_results(effect.query_heap, query_base_index, query_count, timestamps.p, sizeof(uint64_t)))
+		{
+			const auto ticks_to_ns = [this](uint64_t ticks) { return ticks * 1000000000ull / _timestamp_frequency; };
+
+			tech.average_gpu_duration.append(ticks_to_ns(timestamps[query_count - 1] - timestamps[0]));
+			tech.average_gpu_transition_duration.append(ticks_to_ns(timestamps[query_count - 1] - timestamps[query_count - 2]));
+
+			for (size_t pass_index = 0; pass_index < tech.passes_data.size(); ++pass_index)
+			{
+				technique::pass_data &pass_data = tech.passes_data[pass_index];
+				pass_data.average_gpu_transition_duration.append(ticks_to_ns(timestamps[1 + pass_index * 2] - timestamps[pass_index * 2]));
+				pass_data.average_gpu_duration.append(ticks_to_ns(timestamps[2 + pass_index * 2] - timestamps[1 + pass_index * 2]));
+			}
+
+			// Results are from four frames ago, so only add them to the capture if that frame was part of it
+			if (_timing_capture_last_frame != 0 && _frame_count >= _timing_capture_first_frame + 4 && _frame_count < _timing_capture_last_frame + 4)
+			{
+				if (_timing_capture_gpu_base == 0)
+					_timing_capture_gpu_base = timestamps[0];
+
+				const auto add_gpu_event = [&](const char *category, std::string name, size_t first_query, size_t last_query) {
+					if (timestamps[first_query] < _timing_capture_gpu_base || timestamps[last_query] < timestamps[first_query])
+						return; // Ignore results that are older than the capture
+					_timing_capture_events.push_back({ _frame_count - 4, category, std::move(name), true, ticks_to_ns(timestamps[first_query] - _timing_capture_gpu_base), ticks_to_ns(timestamps[last_query] - timestamps[first_query]) });
+				};
+
+				add_gpu_event("technique", tech.name, 0, query_count - 1);
+				for (size_t pass_index = 0; pass_index < tech.passes_data.size(); ++pass_index)
+				{
+					add_gpu_event("transition", pass_timing_name(pass_index), pass_index * 2, 1 + pass_index * 2);
+					add_gpu_event("pass", pass_timing_name(pass_index), 1 + pass_index * 2, 2 + pass_index * 2);
+				}
+				add_gpu_event("transition", tech.name, query_count - 2, query_count - 1);
+			}
+		}
 
-		cmd_list->end_query(effect.query_heap, api::query_type::timestamp, tech.query_base_index + (_frame_count % 4) * 2);
+		cmd_list->end_query(effect.query_heap, api::query_type::timestamp, query_base_index);
 	}
 
 	const std::chrono::high_resolution_clock::time_point time_technique_started = std::chrono::high_resolution_clock::now();
-#endif
 
 #ifndef NDEBUG
 	cmd_list->begin_debug_event(tech.name.c_str());
 #endif
 
-	// Update shader constants
-	if (void *mapped_uniform_data;
-		effect.cb != 0 && _device->map_buffer_region(effect.cb, 0, std::numeric_limits<uint64_t>::max(), api::map_access::write_discard, &mapped_uniform_data))
+	// Update shader constants, but only if they changed since they were last uploaded (so that multiple techniques of the same effect upload them only once per frame)
+	api::descriptor_table cb_table = effect.cb_table[0];
+	if (effect.cb_mapped_data != nullptr)
+	{
+		// Write to the slice of the current frame, since slices of previous frames may still be in use by the GPU
+		const size_t slice = _frame_count % std::size(effect.cb_table);
+		if (effect.cb_slice_versions[slice] != effect.uniform_data_version)
+		{
+			std::memcpy(effect.cb_mapped_data + slice * effect.cb_slice_size, effect.uniform_data_storage.data(), effect.uniform_data_storage.size());
+			effect.cb_slice_versions[slice] = effect.uniform_data_version;
+		}
+
+		cb_table = effect.cb_table[slice];
+	}
+	else if (void *mapped_uniform_data;
+		effect.cb != 0 && effect.cb_slice_versions[0] != effect.uniform_data_version &&
+		_device->map_buffer_region(effect.cb, 0, std::numeric_limits<uint64_t>::max(), api::map_access::write_discard, &mapped_uniform_data))
 	{
 		std::memcpy(mapped_uniform_data, effect.uniform_data_storage.data(), effect.uniform_data_storage.size());
 		_device->unmap_buffer_region(effect.cb);
+
+		effect.cb_slice_versions[0] = effect.uniform_data_version;
 	}
 	else if (_renderer_id == 0x9000)
 	{
-		cmd_list->push_constants(api::shader_stage::all, effect.layout, 0, 0, static_cast<uint32_t>(effect.uniform_data_storage.size() / 4), effect.uniform_data_storage.data());
+		// Constant registers are shared by all effects, so have to push everything again if another effect pushed its constants since (or this is the first push this frame), otherwise only what changed
+		if (_uniform_push_effect_index != tech.effect_index)
+		{
+			effect.uniform_data_dirty_begin = 0;
+			effect.uniform_data_dirty_end = static_cast<uint32_t>(effect.uniform_data_storage.size());
+		}
+
+		if (effect.uniform_data_dirty_begin < effect.uniform_data_dirty_end)
+		{
+			// Push entire registers (16 bytes each)
+			const uint32_t first = (effect.uniform_data_dirty_begin & ~15u) / 4;
+			const uint32_t last = std::min((effect.uniform_data_dirty_end + 15) & ~15u, static_cast<uint32_t>(effect.uniform_data_storage.size())) / 4;
+
+			cmd_list->push_constants(api::shader_stage::all, effect.layout, 0, first, last - first, effect.uniform_data_storage.data() + first * 4);
+		}
+
+		effect.uniform_data_dirty_begin = effect.uniform_data_dirty_end = 0;
+		_uniform_push_effect_index = tech.effect_index;
 	}
 
 	const bool sampler_with_resource_view = _device->check_capability(api::device_caps::sampler_with_resource_view);
 
+	// Skip binds of state that is still bound from a previous pass or technique
+	const auto bind_pipeline = [this, cmd_list](api::pipeline_stage stages, api::pipeline pipeline) {
+		api::pipeline &bound_pipeline = _effect_bind_state.pipeline[stages == api::pipeline_stage::all_compute];
+		if (bound_pipeline == pipeline)
+		{
+			_effect_bind_calls[1]++;
+			return;
+		}
+
+		cmd_list->bind_pipeline(stages, pipeline);
+		bound_pipeline = pipeline;
+		_effect_bind_calls[0]++;
+	};
+	const auto bind_descriptor_table = [this, cmd_list, &effect](api::shader_stage stages, uint32_t param_index, api::descriptor_table table, bool track = true) {
+		const size_t bind_point = stages == api::shader_stage::all_compute;
+		if (_effect_bind_state.layout[bind_point] != effect.layout)
+		{
+			// Descriptor tables bound with a different pipeline layout are not compatible
+			_effect_bind_state.layout[bind_point] = effect.layout;
+			std::fill_n(_effect_bind_state.tables[bind_point], 2, api::descriptor_table {});
+		}
+
+		track = track && param_index < 2;
+		if (track && _effect_bind_state.tables[bind_point][param_index] == table)
+		{
+			_effect_bind_calls[1]++;
+			return;
+		}
+
+		cmd_list->bind_descriptor_table(stages, effect.layout, param_index, table);
+		if (track)
+			_effect_bind_state.tables[bind_point][param_index] = table;
+		_effect_bind_calls[0]++;
+	};
+
 	bool is_effect_stencil_cleared = false;
 	bool needs_implicit_back_buffer_copy = true; // First pass always needs the back buffer updated
 
+	// Resources written by a pass are only transitioned back to shader access (and have their mipmaps generated) once a later pass reads them or the technique is finished
+	// This merges the transitions between passes writing to the same resources and avoids generating mipmaps multiple times for resources that are written repeatedly
+	std::vector<std::pair<api::resource, api::resource_usage>> written_resources;
+	std::vector<std::pair<api::resource, api::resource_view>> pending_mipmap_views;
+
 	for (size_t pass_index = 0; pass_index < tech.passes.size(); ++pass_index)
 	{
+		const reshadefx::pass_info &pass_info = tech.passes[pass_index];
+		const technique::pass_data &pass_data = tech.passes_data[pass_index];
+
+		const std::chrono::high_resolution_clock::time_point time_pass_started = std::chrono::high_resolution_clock::now();
+
 		if (needs_implicit_back_buffer_copy)
 		{
 			// Save back buffer of previous pass
@@ -4235,51 +5543,132 @@ void reshade::runtime::render_technique(technique &tech, api::command_list *cmd_
 			cmd_list->barrier(2, resources, state_new, state_old);
 		}
 
-		const reshadefx::pass_info &pass_info = tech.passes[pass_index];
-		const technique::pass_data &pass_data = tech.passes_data[pass_index];
-
 #ifndef NDEBUG
 		cmd_list->begin_debug_event((pass_info.name.empty() ? "Pass " + std::to_string(pass_index) : pass_info.name).c_str());
 #endif
 
-		const uint32_t num_barriers = static_cast<uint32_t>(pass_data.modified_resources.size());
+		// Resolve pending writes to resources this pass reads from, or that need their mipmaps generated before this pass overwrites them
+		{
+			const auto requires_mipmaps_before_pass = [&pass_data](const std::pair<api::resource, api::resource_view> &pending) {
+				if (std::find(pass_data.sampled_resources.cbegin(), pass_data.sampled_resources.cend(), pending.first) != pass_data.sampled_resources.cend())
+					return true;
+				// Mipmaps can be generated once after this pass instead if it writes to the resource and generates mipmaps for it as well
+				return std::find(pass_data.modified_resources.cbegin(), pass_data.modified_resources.cend(), pending.first) != pass_data.modified_resources.cend() &&
+					std::find(pass_data.generate_mipmap_views.cbegin(), pass_data.generate_mipmap_views.cend(), pending) == pass_data.generate_mipmap_views.cend();
+			};
+
+			temp_mem<api::resource> resources(written_resources.size());
+			temp_mem<api::resource_usage> state_old(written_resources.size()), state_new(written_resources.size());
+			uint32_t num_barriers = 0;
+
+			for (auto it = written_resources.begin(); it != written_resources.end();)
+			{
+				const bool is_sampled = std::find(pass_data.sampled_resources.cbegin(), pass_data.sampled_resources.cend(), it->first) != pass_data.sampled_resources.cend();
+				const bool requires_mipmaps = std::find_if(pending_mipmap_views.cbegin(), pending_mipmap_views.cend(),
+					[&it, &requires_mipmaps_before_pass](const std::pair<api::resource, api::resource_view> &pending) { return pending.first == it->first && requires_mipmaps_before_pass(pending); }) != pending_mipmap_views.cend();
+
+				if (is_sampled || requires_mipmaps)
+				{
+					resources[num_barriers] = it->first;
+					state_old[num_barriers] = it->second;
+					state_new[num_barriers] = api::resource_usage::shader_resource;
+					num_barriers++;
+
+					it = written_resources.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+
+			cmd_list->barrier(num_barriers, resources.p, state_old.p, state_new.p);
+
+			for (auto it = pending_mipmap_views.begin(); it != pending_mipmap_views.end();)
+			{
+				if (requires_mipmaps_before_pass(*it))
+				{
+					cmd_list->generate_mipmaps(it->second);
+
+					it = pending_mipmap_views.erase(it);
+
+					// Generating mipmaps may bind its own pipeline and descriptors
+					_effect_bind_state = {};
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+
+		// Transition resource state for all resources written by this pass
+		{
+			const api::resource_usage write_usage = pass_info.cs_entry_point.empty() ? api::resource_usage::render_target : api::resource_usage::unordered_access;
+
+			const uint32_t max_barriers = static_cast<uint32_t>(pass_data.modified_resources.size());
+			temp_mem<api::resource_usage> state_old(max_barriers), state_new(max_barriers);
+			temp_mem<api::resource> resources(max_barriers);
+			uint32_t num_barriers = 0;
+
+			for (const api::resource resource : pass_data.modified_resources)
+			{
+				const auto it = std::find_if(written_resources.begin(), written_resources.end(),
+					[resource](const std::pair<api::resource, api::resource_usage> &written) { return written.first == resource; });
+
+				if (it != written_resources.end())
+				{
+					// Subsequent writes to a render target are ordered implicitly, except in Vulkan where an explicit dependency between render passes is required
+					if (it->second == api::resource_usage::render_target && write_usage == api::resource_usage::render_target && _device->get_api() != api::device_api::vulkan)
+						continue;
+
+					resources[num_barriers] = resource;
+					state_old[num_barriers] = it->second;
+					state_new[num_barriers] = write_usage;
+					num_barriers++;
+
+					it->second = write_usage;
+				}
+				else
+				{
+					resources[num_barriers] = resource;
+					state_old[num_barriers] = api::resource_usage::shader_resource;
+					state_new[num_barriers] = write_usage;
+					num_barriers++;
+
+					written_resources.emplace_back(resource, write_usage);
+				}
+			}
+
+			cmd_list->barrier(num_barriers, resources.p, state_old.p, state_new.p);
+		}
+
+		if (gather_gpu_timings)
+			cmd_list->end_query(effect.query_heap, api::query_type::timestamp, query_base_index + 1 + static_cast<uint32_t>(pass_index) * 2);
 
 		if (!pass_info.cs_entry_point.empty())
 		{
 			// Compute shaders do not write to the back buffer, so no update necessary
 			needs_implicit_back_buffer_copy = false;
 
-			cmd_list->bind_pipeline(api::pipeline_stage::all_compute, pass_data.pipeline);
-
-			temp_mem<api::resource_usage> state_old, state_new;
-			std::fill_n(state_old.p, num_barriers, api::resource_usage::shader_resource);
-			std::fill_n(state_new.p, num_barriers, api::resource_usage::unordered_access);
-			cmd_list->barrier(num_barriers, pass_data.modified_resources.data(), state_old.p, state_new.p);
+			bind_pipeline(api::pipeline_stage::all_compute, pass_data.pipeline);
 
-			// Reset bindings on every pass (since they get invalidated by the call to 'generate_mipmaps' below)
 			if (effect.cb != 0)
-				cmd_list->bind_descriptor_table(api::shader_stage::all_compute, effect.layout, 0, effect.cb_table);
+				bind_descriptor_table(api::shader_stage::all_compute, 0, cb_table);
 			if (effect.sampler_table != 0)
 				assert(!sampler_with_resource_view),
-				cmd_list->bind_descriptor_table(api::shader_stage::all_compute, effect.layout, 1, effect.sampler_table);
+				bind_descriptor_table(api::shader_stage::all_compute, 1, effect.sampler_table);
+
 			if (pass_data.texture_table != 0)
-				cmd_list->bind_descriptor_table(api::shader_stage::all_compute, effect.layout, sampler_with_resource_view ? 1 : 2, pass_data.texture_table);
+				bind_descriptor_table(api::shader_stage::all_compute, sampler_with_resource_view ? 1 : 2, pass_data.texture_table, false);
 			if (pass_data.storage_table != 0)
-				cmd_list->bind_descriptor_table(api::shader_stage::all_compute, effect.layout, sampler_with_resource_view ? 2 : 3, pass_data.storage_table);
+				bind_descriptor_table(api::shader_stage::all_compute, sampler_with_resource_view ? 2 : 3, pass_data.storage_table, false);
 
 			cmd_list->dispatch(pass_info.viewport_width, pass_info.viewport_height, pass_info.viewport_dispatch_z);
-
-			cmd_list->barrier(num_barriers, pass_data.modified_resources.data(), state_new.p, state_old.p);
 		}
 		else
 		{
-			cmd_list->bind_pipeline(api::pipeline_stage::all_graphics, pass_data.pipeline);
-
-			// Transition resource state for render targets
-			temp_mem<api::resource_usage> state_old, state_new;
-			std::fill_n(state_old.p, num_barriers, api::resource_usage::shader_resource);
-			std::fill_n(state_new.p, num_barriers, api::resource_usage::render_target);
-			cmd_list->barrier(num_barriers, pass_data.modified_resources.data(), state_old.p, state_new.p);
+			bind_pipeline(api::pipeline_stage::all_graphics, pass_data.pipeline);
 
 			// Setup render targets
 			uint32_t render_target_count = 0;
@@ -4320,30 +5709,45 @@ void reshade::runtime::render_technique(technique &tech, api::command_list *cmd_
 
 			cmd_list->begin_render_pass(render_target_count, render_target, depth_stencil.view != 0 ? &depth_stencil : nullptr);
 
-			// Reset bindings on every pass (since they get invalidated by the call to 'generate_mipmaps' below)
+			// Setting a render target in D3D9 resets the viewport
+			if (_renderer_id == 0x9000)
+				_effect_bind_state.viewport_width = _effect_bind_state.viewport_height = 0;
+
 			if (effect.cb != 0)
-				cmd_list->bind_descriptor_table(api::shader_stage::all_graphics, effect.layout, 0, effect.cb_table);
+				bind_descriptor_table(api::shader_stage::all_graphics, 0, cb_table);
 			if (effect.sampler_table != 0)
 				assert(!sampler_with_resource_view),
-				cmd_list->bind_descriptor_table(api::shader_stage::all_graphics, effect.layout, 1, effect.sampler_table);
+				bind_descriptor_table(api::shader_stage::all_graphics, 1, effect.sampler_table);
+
 			// Setup shader resources after binding render targets, to ensure any OM bindings by the application are unset at this point (e.g. a depth buffer that was bound to the OM and is now bound as shader resource)
 			if (pass_data.texture_table != 0)
-				cmd_list->bind_descriptor_table(api::shader_stage::all_graphics, effect.layout, sampler_with_resource_view ? 1 : 2, pass_data.texture_table);
+				bind_descriptor_table(api::shader_stage::all_graphics, sampler_with_resource_view ? 1 : 2, pass_data.texture_table, false);
 
-			const api::viewport viewport = {
-				0.0f, 0.0f,
-				static_cast<float>(pass_info.viewport_width),
-				static_cast<float>(pass_info.viewport_height),
-				0.0f, 1.0f
-			};
-			cmd_list->bind_viewports(0, 1, &viewport);
+			if (_effect_bind_state.viewport_width != pass_info.viewport_width || _effect_bind_state.viewport_height != pass_info.viewport_height)
+			{
+				const api::viewport viewport = {
+					0.0f, 0.0f,
+					static_cast<float>(pass_info.viewport_width),
+					static_cast<float>(pass_info.viewport_height),
+					0.0f, 1.0f
+				};
+				cmd_list->bind_viewports(0, 1, &viewport);
 
-			const api::rect scissor_rect = {
-				0, 0,
-				static_cast<int32_t>(pass_info.viewport_width),
-				static_cast<int32_t>(pass_info.viewport_height)
-			};
-			cmd_list->bind_scissor_rects(0, 1, &scissor_rect);
+				const api::rect scissor_rect = {
+					0, 0,
+					static_cast<int32_t>(pass_info.viewport_width),
+					static_cast<int32_t>(pass_info.viewport_height)
+				};
+				cmd_list->bind_scissor_rects(0, 1, &scissor_rect);
+
+				_effect_bind_state.viewport_width = pass_info.viewport_width;
+				_effect_bind_state.viewport_height = pass_info.viewport_height;
+				_effect_bind_calls[0] += 2;
+			}
+			else
+			{
+				_effect_bind_calls[1] += 2;
+			}
 
 			if (_renderer_id == 0x9000)
 			{
@@ -4379,43 +5783,354 @@ void reshade::runtime::render_technique(technique &tech, api::command_list *cmd_
 			cmd_list->draw(pass_info.num_vertices, 1, 0, 0);
 
 			cmd_list->end_render_pass();
-
-			// Transition resource state back to shader access
-			cmd_list->barrier(num_barriers, pass_data.modified_resources.data(), state_new.p, state_old.p);
 		}
 
-		// Generate mipmaps for modified resources
-		for (const api::resource_view modified_texture : pass_data.generate_mipmap_views)
-			cmd_list->generate_mipmaps(modified_texture);
+		if (gather_gpu_timings)
+			cmd_list->end_query(effect.query_heap, api::query_type::timestamp, query_base_index + 2 + static_cast<uint32_t>(pass_index) * 2);
+
+		// Defer mipmap generation for modified resources until they are actually read
+		for (const std::pair<api::resource, api::resource_view> &modified_texture : pass_data.generate_mipmap_views)
+			if (std::find(pending_mipmap_views.cbegin(), pending_mipmap_views.cend(), modified_texture) == pending_mipmap_views.cend())
+				pending_mipmap_views.push_back(modified_texture);
+
+		const std::chrono::high_resolution_clock::time_point time_pass_finished = std::chrono::high_resolution_clock::now();
+
+		tech.passes_data[pass_index].average_cpu_duration.append(std::chrono::duration_cast<std::chrono::nanoseconds>(time_pass_finished - time_pass_started).count());
+
+		if (capture_cpu_timings)
+			_timing_capture_events.push_back({ _frame_count, "pass", pass_timing_name(pass_index), false,
+				static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time_pass_started - _timing_capture_cpu_base).count()),
+				static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time_pass_finished - time_pass_started).count()) });
 
 #ifndef NDEBUG
 		cmd_list->end_debug_event();
 #endif
 	}
 
+	// Transition all resources written by this technique back to shader access, since other techniques or effects may read from them
+	{
+		temp_mem<api::resource> resources(written_resources.size());
+		temp_mem<api::resource_usage> state_old(written_resources.size()), state_new(written_resources.size());
+		for (size_t i = 0; i < written_resources.size(); ++i)
+		{
+			resources[i] = written_resources[i].first;
+			state_old[i] = written_resources[i].second;
+			state_new[i] = api::resource_usage::shader_resource;
+		}
+
+		cmd_list->barrier(static_cast<uint32_t>(written_resources.size()), resources.p, state_old.p, state_new.p);
+
+		for (const std::pair<api::resource, api::resource_view> &pending_mipmap_view : pending_mipmap_views)
+			cmd_list->generate_mipmaps(pending_mipmap_view.second);
+
+		// Generating mipmaps may bind its own pipeline and descriptors
+		if (!pending_mipmap_views.empty())
+			_effect_bind_state = {};
+	}
+
 #ifndef NDEBUG
 	cmd_list->end_debug_event();
 #endif
 
-#if RESHADE_GUI
 	const std::chrono::high_resolution_clock::time_point time_technique_finished = std::chrono::high_resolution_clock::now();
 
 	tech.average_cpu_duration.append(std::chrono::duration_cast<std::chrono::nanoseconds>(time_technique_finished - time_technique_started).count());
 
-	if (_gather_gpu_statistics && _timestamp_frequency != 0 && effect.query_heap != 0)
-		cmd_list->end_query(effect.query_heap, api::query_type::timestamp, tech.query_base_index + (_frame_count % 4) * 2 + 1);
-#endif
+	if (capture_cpu_timings)
+		_timing_capture_events.push_back({ _frame_count, "technique", tech.name, false,
+			static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time_technique_started - _timing_capture_cpu_base).count()),
+			static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time_technique_finished - time_technique_started).count()) });
+
+	if (gather_gpu_timings)
+		cmd_list->end_query(effect.query_heap, api::query_type::timestamp, query_base_index + query_count - 1);
 
 #if RESHADE_ADDON
-	if (_is_in_api_call)
+	if (_is_in_api_call || !has_addon_event<addon_event::reshade_render_technique>())
 		return;
 
 	_is_in_api_call = true;
 	invoke_addon_event<addon_event::reshade_render_technique>(const_cast<runtime *>(this), api::effect_technique { reinterpret_cast<uintptr_t>(&tech) }, cmd_list, back_buffer_rtv, back_buffer_rtv_srgb);
 	_is_in_api_call = false;
+
+	// Add-ons may have modified constant registers and bound state
+	_uniform_push_effect_index = std::numeric_limits<size_t>::max();
+	_effect_bind_state = {};
+#endif
+}
+
+void reshade::runtime::save_timing_capture()
+{
+	std::vector<timing_capture_event> events = std::move(_timing_capture_events);
+	_timing_capture_events.clear();
+	_timing_capture_last_frame = 0;
+
+	const std::filesystem::path capture_path = g_reshade_base_path / _timing_capture_path;
+
+	_worker_threads.emplace_back([capture_path, events = std::move(events)]() {
+		std::ofstream file(capture_path, std::ios::trunc);
+		if (!file)
+		{
+			LOG(ERROR) << "Failed to open " << capture_path << " for writing timing capture!";
+			return;
+		}
+
+		const auto write_microseconds = [&file](uint64_t nanoseconds) {
+			char buffer[32];
+			const std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), nanoseconds * 1e-3, std::chars_format::fixed, 3);
+			file.write(buffer, result.ptr - buffer);
+		};
+
+		// Effect and technique names may contain any character, so have to escape them for the target format
+		const auto write_csv_field = [&file](const std::string &value) {
+			if (value.find_first_of(",\"\r\n") == std::string::npos)
+			{
+				file << value;
+				return;
+			}
+
+			file << '\"';
+			for (const char c : value)
+			{
+				if (c == '\"')
+					file << '\"'; // Quotes inside a quoted field are escaped by doubling them
+				file << c;
+			}
+			file << '\"';
+		};
+		const auto write_json_string = [&file](const std::string &value) {
+			for (const char c : value)
+			{
+				if (c == '\"' || c == '\\')
+				{
+					file << '\\' << c;
+				}
+				else if (static_cast<unsigned char>(c) < 0x20)
+				{
+					file << "\\u00" << "0123456789abcdef"[c >> 4] << "0123456789abcdef"[c & 0xF];
+				}
+				else
+				{
+					file << c;
+				}
+			}
+		};
+
+		if (capture_path.extension() == L".csv")
+		{
+			file << "frame,category,name,timeline,start_us,duration_us\n";
+
+			for (const timing_capture_event &event : events)
+			{
+				file << event.frame << ',' << event.category << ',';
+				write_csv_field(event.name);
+				file << ',' << (event.gpu ? "GPU" : "CPU") << ',';
+				write_microseconds(event.start);
+				file << ',';
+				write_microseconds(event.duration);
+				file << '\n';
+			}
+		}
+		else
+		{
+			// Chrome trace event format, which can be opened in 'chrome://tracing' or Perfetto, with the CPU and GPU timelines shown as separate threads
+			file << "{\"traceEvents\":[\n"
+				"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n"
+				"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+
+			for (const timing_capture_event &event : events)
+			{
+				file << ",\n{\"name\":\"";
+				write_json_string(event.name);
+				file << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << (event.gpu ? 1 : 0) << ",\"ts\":";
+				write_microseconds(event.start);
+				file << ",\"dur\":";
+				write_microseconds(event.duration);
+				file << ",\"args\":{\"frame\":" << event.frame << "}}";
+			}
+
+			file << "\n]}\n";
+		}
+
+		LOG(INFO) << "Saved timing capture of " << events.size() << " events to " << capture_path << '.';
+	});
+}
+
+#endif
+
+static bool write_image_file(const std::filesystem::path &path, unsigned int format, unsigned int jpeg_quality, const uint8_t *pixels, uint32_t width, uint32_t height, int comp)
+{
+	// Default to a save failure unless it is reported to succeed below
+	bool save_success = false;
+
+	if (auto file = std::ofstream(path, std::ios::binary | std::ios::trunc))
+	{
+		const auto write_callback = [](void *context, void *data, int size) {
+			static_cast<std::ofstream *>(context)->write(static_cast<const char *>(data), size);
+		};
+
+		switch (format)
+		{
+		case 0:
+			save_success = stbi_write_bmp_to_func(write_callback, &file, width, height, comp, pixels) != 0;
+			break;
+		case 1:
+		{
+#if 1
+			std::vector<uint8_t> encoded_data;
+			save_success = fpng::fpng_encode_image_to_memory(pixels, width, height, comp, encoded_data);
+			write_callback(&file, encoded_data.data(), static_cast<int>(encoded_data.size()));
+#else
+			save_success = stbi_write_png_to_func(write_callback, &file, width, height, comp, pixels, 0) != 0;
 #endif
+			break;
+		}
+		case 2:
+			save_success = stbi_write_jpg_to_func(write_callback, &file, width, height, comp, pixels, jpeg_quality) != 0;
+			break;
+		}
+
+		if (!file)
+			save_success = false;
+	}
+
+	return save_success;
+}
+
+// Exported by the stb_image_write implementation, but not declared in its header
+extern "C" unsigned char *stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality);
+
+static uint32_t png_crc32(const uint8_t *data, size_t size, uint32_t crc)
+{
+	static const struct crc32_table
+	{
+		crc32_table()
+		{
+			for (uint32_t n = 0; n < 256; ++n)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : (c >> 1);
+				values[n] = c;
+			}
+		}
+
+		uint32_t values[256];
+	} table;
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+		crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+static void write_png_chunk(std::ofstream &file, const char type[4], const uint8_t *data, size_t size)
+{
+	const uint8_t length[4] = { static_cast<uint8_t>(size >> 24), static_cast<uint8_t>(size >> 16), static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size) };
+	file.write(reinterpret_cast<const char *>(length), 4);
+	file.write(type, 4);
+	file.write(reinterpret_cast<const char *>(data), size);
+
+	const uint32_t crc = png_crc32(data, size, png_crc32(reinterpret_cast<const uint8_t *>(type), 4, 0));
+	const uint8_t crc_data[4] = { static_cast<uint8_t>(crc >> 24), static_cast<uint8_t>(crc >> 16), static_cast<uint8_t>(crc >> 8), static_cast<uint8_t>(crc) };
+	file.write(reinterpret_cast<const char *>(crc_data), 4);
+}
+
+static bool write_hdr_image_file(const std::filesystem::path &path, unsigned int format, const float *pixels, uint32_t width, uint32_t height, int comp, bool linear)
+{
+	const auto saturate = [](float value) { return value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f; }; // Also maps NaN to zero
+
+	// Default to a save failure unless it is reported to succeed below
+	bool save_success = false;
+
+	if (auto file = std::ofstream(path, std::ios::binary | std::ios::trunc))
+	{
+		switch (format)
+		{
+		case 3:
+		{
+			// 16-bit PNG, which neither fpng nor stb_image_write support, so write the chunks manually and only use stb for the deflate compression
+			const size_t row_size = 1 + static_cast<size_t>(width) * comp * 2;
+			std::vector<uint8_t> raw_data(row_size * height);
+
+			for (size_t y = 0; y < height; ++y)
+			{
+				uint8_t *row = raw_data.data() + y * row_size;
+				*row++ = 0; // No filter
+
+				for (size_t x = 0; x < width; ++x)
+				{
+					for (int c = 0; c < comp; ++c, row += 2)
+					{
+						float value = saturate(pixels[(y * width + x) * 4 + c]);
+						// Linear floating-point data is stored sRGB encoded, like the 8-bit formats
+						if (linear && c < 3)
+							value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+
+						const uint16_t value_16 = static_cast<uint16_t>(value * 65535.0f + 0.5f);
+						row[0] = static_cast<uint8_t>(value_16 >> 8); // PNG stores big-endian values
+						row[1] = static_cast<uint8_t>(value_16 & 0xFF);
+					}
+				}
+			}
+
+			int compressed_size = 0;
+			uint8_t *const compressed_data = stbi_zlib_compress(raw_data.data(), static_cast<int>(raw_data.size()), &compressed_size, 8);
+			if (compressed_data == nullptr)
+				break;
+
+			const uint8_t header_data[13] = {
+				static_cast<uint8_t>(width >> 24), static_cast<uint8_t>(width >> 16), static_cast<uint8_t>(width >> 8), static_cast<uint8_t>(width),
+				static_cast<uint8_t>(height >> 24), static_cast<uint8_t>(height >> 16), static_cast<uint8_t>(height >> 8), static_cast<uint8_t>(height),
+				16, // Bit depth
+				static_cast<uint8_t>(comp == 4 ? 6 : 2), // Color type (RGBA or RGB)
+				0, 0, 0 // Compression, filter and interlace method
+			};
+
+			file.write("\x89PNG\r\n\x1A\n", 8);
+			write_png_chunk(file, "IHDR", header_data, sizeof(header_data));
+			write_png_chunk(file, "IDAT", compressed_data, compressed_size);
+			write_png_chunk(file, "IEND", nullptr, 0);
+
+			std::free(compressed_data);
+
+			save_success = true;
+			break;
+		}
+		case 4:
+		{
+			// Radiance HDR, which stores run-length encoded linear RGB values in a shared exponent format that cannot represent negative values
+			std::vector<float> rgb_data(static_cast<size_t>(width) * height * 3);
+
+			for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					float value = pixels[i * 4 + c];
+					value = value > 0.0f ? value : 0.0f;
+					// Normalized formats contain sRGB encoded data, so need to decode those to linear first
+					if (!linear)
+						value = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+
+					rgb_data[i * 3 + c] = value;
+				}
+			}
+
+			const auto write_callback = [](void *context, void *data, int size) {
+				static_cast<std::ofstream *>(context)->write(static_cast<const char *>(data), size);
+			};
+
+			save_success = stbi_write_hdr_to_func(write_callback, &file, width, height, 3, rgb_data.data()) != 0;
+			break;
+		}
+		}
+
+		if (!file)
+			save_success = false;
+	}
+
+	return save_success;
 }
 
+#if RESHADE_FX
 void reshade::runtime::save_texture(const texture &tex)
 {
 	if (tex.type == reshadefx::texture_type::texture_3d)
@@ -4425,50 +6140,54 @@ void reshade::runtime::save_texture(const texture &tex)
 	}
 
 	std::string filename = tex.unique_name;
-	filename += (_screenshot_format == 0 ? ".bmp" : _screenshot_format == 1 ? ".png" : ".jpg");
+	filename += (_screenshot_format == 0 ? ".bmp" : _screenshot_format == 2 ? ".jpg" : _screenshot_format == 4 ? ".hdr" : ".png");
 
 	const std::filesystem::path screenshot_path = g_reshade_base_path / _screenshot_path / std::filesystem::u8path(filename);
 
 	_last_screenshot_save_successful = true;
 
-	if (std::vector<uint8_t> pixels(static_cast<size_t>(tex.width) * static_cast<size_t>(tex.height) * 4);
-		get_texture_data(tex.resource, api::resource_usage::shader_resource, pixels.data()))
-	{
-		_worker_threads.emplace_back([this, screenshot_path, pixels = std::move(pixels), width = tex.width, height = tex.height]() mutable {
-			// Default to a save failure unless it is reported to succeed below
-			bool save_success = false;
-
-			if (auto file = std::ofstream(screenshot_path, std::ios::binary | std::ios::trunc))
-			{
-				const auto write_callback = [](void *context, void *data, int size) {
-					static_cast<std::ofstream *>(context)->write(static_cast<const char *>(data), size);
-				};
+	// Formats 3 and 4 are high dynamic range formats, which are written from floating-point data
+	const bool hdr = _screenshot_format >= 3;
+	const bool linear = api::format_to_default_typed(_device->get_resource_desc(tex.resource).texture.format, 0) == api::format::r16g16b16a16_float;
 
-				switch (_screenshot_format)
-				{
-				case 0:
-					save_success = stbi_write_bmp_to_func(write_callback, &file, width, height, 4, pixels.data()) != 0;
-					break;
-				case 1:
-				{
-#if 1
-					std::vector<uint8_t> encoded_data;
-					save_success = fpng::fpng_encode_image_to_memory(pixels.data(), width, height, 4, encoded_data);
-					write_callback(&file, encoded_data.data(), static_cast<int>(encoded_data.size()));
-#else
-					save_success = stbi_write_png_to_func(write_callback, &file, width, height, 4, pixels.data(), 0) != 0;
-#endif
-					break;
-				}
-				case 2:
-					save_success = stbi_write_jpg_to_func(write_callback, &file, width, height, 4, pixels.data(), _screenshot_jpeg_quality) != 0;
-					break;
-				}
+	// Textures with fewer than four channels are read back with an opaque alpha channel, so can leave it out of the file
+	bool has_alpha = true;
+	switch (tex.format)
+	{
+	case reshadefx::texture_format::r8:
+	case reshadefx::texture_format::r16:
+	case reshadefx::texture_format::r16f:
+	case reshadefx::texture_format::r32i:
+	case reshadefx::texture_format::r32u:
+	case reshadefx::texture_format::r32f:
+	case reshadefx::texture_format::rg8:
+	case reshadefx::texture_format::rg16:
+	case reshadefx::texture_format::rg16f:
+	case reshadefx::texture_format::rg32f:
+		has_alpha = false;
+		break;
+	default:
+		break;
+	}
 
-				if (!file)
-					save_success = false;
+	if (std::vector<uint8_t> pixels(static_cast<size_t>(tex.width) * static_cast<size_t>(tex.height) * (hdr ? 4 * sizeof(float) : 4));
+		get_texture_data(tex.resource, api::resource_usage::shader_resource, pixels.data(), hdr ? api::format::r32g32b32a32_float : api::format::r8g8b8a8_unorm))
+	{
+		queue_screenshot_job([this, screenshot_path, pixels = std::move(pixels), width = tex.width, height = tex.height, hdr, linear, has_alpha]() mutable {
+			// Remove alpha channel
+			int comp = 4;
+			if (!has_alpha)
+			{
+				comp = 3;
+				// Floating-point data is packed while writing the file instead
+				if (!hdr)
+					utils::pack_rgba8_to_rgb8(pixels.data(), width, height);
 			}
 
+			const bool save_success = hdr ?
+				write_hdr_image_file(screenshot_path, _screenshot_format, reinterpret_cast<const float *>(pixels.data()), width, height, comp, linear) :
+				write_image_file(screenshot_path, _screenshot_format, _screenshot_jpeg_quality, pixels.data(), width, height, comp);
+
 			if (_last_screenshot_save_successful)
 			{
 				_last_screenshot_time = std::chrono::high_resolution_clock::now();
@@ -4489,62 +6208,8 @@ void reshade::runtime::update_texture(texture &tex, uint32_t width, uint32_t hei
 	uint32_t pixel_size;
 	stbir_datatype data_type;
 	stbir_pixel_layout pixel_layout;
-	switch (tex.format)
-	{
-	case reshadefx::texture_format::r8:
-		pixel_size = 1 * 1;
-		data_type = STBIR_TYPE_UINT8;
-		pixel_layout = STBIR_1CHANNEL;
-		break;
-	case reshadefx::texture_format::r32f:
-		pixel_size = 4 * 1;
-		data_type = STBIR_TYPE_FLOAT;
-		pixel_layout = STBIR_1CHANNEL;
-		break;
-	case reshadefx::texture_format::rg8:
-		pixel_size = 1 * 2;
-		data_type = STBIR_TYPE_UINT8;
-		pixel_layout = STBIR_2CHANNEL;
-		break;
-	case reshadefx::texture_format::rg16:
-		pixel_size = 2 * 2;
-		data_type = STBIR_TYPE_UINT16;
-		pixel_layout = STBIR_2CHANNEL;
-		break;
-	case reshadefx::texture_format::rg16f:
-		pixel_size = 2 * 2;
-		data_type = STBIR_TYPE_HALF_FLOAT;
-		pixel_layout = STBIR_2CHANNEL;
-		break;
-	case reshadefx::texture_format::rg32f:
-		pixel_size = 4 * 2;
-		data_type = STBIR_TYPE_FLOAT;
-		pixel_layout = STBIR_2CHANNEL;
-		break;
-	case reshadefx::texture_format::rgba8:
-	case reshadefx::texture_format::rgb10a2:
-		pixel_size = 1 * 4;
-		data_type = STBIR_TYPE_UINT8;
-		pixel_layout = STBIR_RGBA;
-		break;
-	case reshadefx::texture_format::rgba16:
-		pixel_size = 2 * 4;
-		data_type = STBIR_TYPE_UINT16;
-		pixel_layout = STBIR_RGBA;
-		break;
-	case reshadefx::texture_format::rgba16f:
-		pixel_size = 2 * 4;
-		data_type = STBIR_TYPE_HALF_FLOAT;
-		pixel_layout = STBIR_RGBA;
-		break;
-	case reshadefx::texture_format::rgba32f:
-		pixel_size = 4 * 4;
-		data_type = STBIR_TYPE_FLOAT;
-		pixel_layout = STBIR_RGBA;
-		break;
-	default:
+	if (!get_texture_data_layout(tex.format, pixel_size, data_type, pixel_layout))
 		return;
-	}
 
 	void *upload_data = const_cast<void *>(pixels);
 
@@ -4573,6 +6238,7 @@ void reshade::runtime::reset_uniform_value(uniform &variable)
 	if (variable.special != reshade::special_uniform::none)
 	{
 		std::memset(_effects[variable.effect_index].uniform_data_storage.data() + variable.offset, 0, variable.size);
+		_effects[variable.effect_index].mark_uniform_data_modified(variable.offset, variable.size);
 		return;
 	}
 
@@ -4714,13 +6380,18 @@ void reshade::runtime::set_uniform_value_data(uniform &variable, const uint8_t *
 	size = std::min(size, static_cast<size_t>(variable.size));
 	assert(data != nullptr && (size % 4) == 0);
 
-	std::vector<uint8_t> &data_storage = _effects[variable.effect_index].uniform_data_storage;
+	effect &effect = _effects[variable.effect_index];
+	std::vector<uint8_t> &data_storage = effect.uniform_data_storage;
 	assert(variable.offset + size <= data_storage.size());
 
 	const size_t array_length = (variable.type.is_array() ? variable.type.array_length : 1u);
 	if (assert(base_index < array_length); base_index >= array_length)
 		return;
 
+	// Keep the previous value around to detect whether it actually changed, so that constants are only uploaded again when necessary
+	temp_mem<uint8_t, 64> previous_data(variable.size);
+	std::memcpy(previous_data.p, data_storage.data() + variable.offset, variable.size);
+
 	if (variable.type.is_matrix())
 	{
 		for (size_t a = base_index, i = 0; a < array_length; ++a)
@@ -4744,6 +6415,9 @@ void reshade::runtime::set_uniform_value_data(uniform &variable, const uint8_t *
 	{
 		std::memcpy(data_storage.data() + variable.offset, data, size);
 	}
+
+	if (std::memcmp(previous_data.p, data_storage.data() + variable.offset, variable.size) != 0)
+		effect.mark_uniform_data_modified(variable.offset, variable.size);
 }
 
 template <> void reshade::runtime::set_uniform_value<bool>(uniform &variable, const bool *values, size_t count, size_t array_index)
@@ -4930,7 +6604,7 @@ void reshade::runtime::save_screenshot(const std::string_view postfix)
 	});
 
 	screenshot_name += postfix;
-	screenshot_name += (_screenshot_format == 0 ? ".bmp" : _screenshot_format == 1 ? ".png" : ".jpg");
+	screenshot_name += (_screenshot_format == 0 ? ".bmp" : _screenshot_format == 2 ? ".jpg" : _screenshot_format == 4 ? ".hdr" : ".png");
 
 	const std::filesystem::path screenshot_path = g_reshade_base_path / _screenshot_path / std::filesystem::u8path(screenshot_name);
 
@@ -4938,26 +6612,38 @@ void reshade::runtime::save_screenshot(const std::string_view postfix)
 
 	_last_screenshot_save_successful = true;
 
-	if (std::vector<uint8_t> pixels(static_cast<size_t>(_width) * static_cast<size_t>(_height) * 4);
-		capture_screenshot(pixels.data()))
-	{
 #if RESHADE_FX
-		const bool include_preset = _screenshot_include_preset && postfix.empty() && ini_file::flush_cache(_current_preset_path);
+	const bool include_preset = _screenshot_include_preset && postfix.empty() && ini_file::flush_cache(_current_preset_path);
 #else
-		const bool include_preset = false;
+	const bool include_preset = false;
 #endif
-		// Play screenshot sound
-		if (!_screenshot_sound_path.empty())
-			utils::play_sound_async(g_reshade_base_path / _screenshot_sound_path);
 
-		_worker_threads.emplace_back([this, screenshot_count, screenshot_path, pixels = std::move(pixels), include_preset]() mutable {
+	const api::resource back_buffer_resource = _back_buffer_resolved != 0 ? _back_buffer_resolved : _swapchain->get_current_back_buffer();
+
+	// Formats 3 and 4 are high dynamic range formats, which are written from floating-point data
+	const bool hdr = _screenshot_format >= 3;
+	const bool linear = api::format_to_default_typed(_device->get_resource_desc(back_buffer_resource).texture.format, 0) == api::format::r16g16b16a16_float;
+
+	// Copy the back buffer now, but only map and save it once the GPU has finished with the copy a few frames later
+	const bool requested = request_texture_data(
+		back_buffer_resource,
+		_back_buffer_resolved != 0 ? api::resource_usage::render_target : api::resource_usage::present,
+		[this, screenshot_count, screenshot_path, include_preset, hdr, linear](std::vector<uint8_t> &&pixels, uint32_t width, uint32_t height) {
+		if (pixels.empty())
+		{
+			LOG(ERROR) << "Failed to read back screenshot data!";
+			return;
+		}
+
+		queue_screenshot_job([this, screenshot_count, screenshot_path, pixels = std::move(pixels), width, height, include_preset, hdr, linear]() mutable {
 			// Remove alpha channel
 			int comp = 4;
 			if (_screenshot_clear_alpha)
 			{
 				comp = 3;
-				for (size_t i = 0; i < static_cast<size_t>(_width) * static_cast<size_t>(_height); ++i)
-					*reinterpret_cast<uint32_t *>(pixels.data() + 3 * i) = *reinterpret_cast<const uint32_t *>(pixels.data() + 4 * i);
+				// Floating-point data is packed while writing the file instead
+				if (!hdr)
+					utils::pack_rgba8_to_rgb8(pixels.data(), width, height);
 			}
 
 			// Create screenshot directory if it does not exist
@@ -4967,39 +6653,9 @@ void reshade::runtime::save_screenshot(const std::string_view postfix)
 				if (!(_screenshot_directory_creation_successful = std::filesystem::create_directories(screenshot_path.parent_path(), ec)))
 					LOG(ERROR) << "Failed to create screenshot directory " << screenshot_path.parent_path() << " with error code " << ec.value() << '!';
 
-			// Default to a save failure unless it is reported to succeed below
-			bool save_success = false;
-
-			if (auto file = std::ofstream(screenshot_path, std::ios::binary | std::ios::trunc))
-			{
-				const auto write_callback = [](void *context, void *data, int size) {
-					static_cast<std::ofstream *>(context)->write(static_cast<const char *>(data), size);
-				};
-
-				switch (_screenshot_format)
-				{
-				case 0:
-					save_success = stbi_write_bmp_to_func(write_callback, &file, _width, _height, comp, pixels.data()) != 0;
-					break;
-				case 1:
-				{
-#if 1
-					std::vector<uint8_t> encoded_data;
-					save_success = fpng::fpng_encode_image_to_memory(pixels.data(), _width, _height, comp, encoded_data);
-					write_callback(&file, encoded_data.data(), static_cast<int>(encoded_data.size()));
-#else
-					save_success = stbi_write_png_to_func(write_callback, &file, _width, _height, comp, pixels.data(), 0) != 0;
-#endif
-					break;
-				}
-				case 2:
-					save_success = stbi_write_jpg_to_func(write_callback, &file, _width, _height, comp, pixels.data(), _screenshot_jpeg_quality) != 0;
-					break;
-				}
-
-				if (!file)
-					save_success = false;
-			}
+			const bool save_success = hdr ?
+				write_hdr_image_file(screenshot_path, _screenshot_format, reinterpret_cast<const float *>(pixels.data()), width, height, comp, linear) :
+				write_image_file(screenshot_path, _screenshot_format, _screenshot_jpeg_quality, pixels.data(), width, height, comp);
 
 			if (save_success)
 			{
@@ -5033,8 +6689,289 @@ void reshade::runtime::save_screenshot(const std::string_view postfix)
 				_last_screenshot_save_successful = save_success;
 			}
 		});
+	}, hdr ? api::format::r32g32b32a32_float : api::format::r8g8b8a8_unorm);
+
+	if (!requested)
+		return;
+
+	// Play screenshot sound
+	if (!_screenshot_sound_path.empty())
+		utils::play_sound_async(g_reshade_base_path / _screenshot_sound_path);
+}
+void reshade::runtime::queue_screenshot_job(std::function<void()> &&job)
+{
+	// Limit the number of pending jobs, since each one holds on to the pixel data of an entire image
+	constexpr size_t max_pending_jobs = 4;
+
+	std::unique_lock<std::mutex> lock(_screenshot_job_mutex);
+
+	// Start worker threads on first use, they then stay around until the runtime is reset
+	if (_screenshot_job_threads.empty())
+	{
+		_screenshot_job_threads_exit = false;
+
+		const unsigned int num_threads = std::max(1u, std::min(std::thread::hardware_concurrency() / 4, 4u));
+		for (unsigned int i = 0; i < num_threads; ++i)
+		{
+			_screenshot_job_threads.emplace_back([this]() {
+				std::unique_lock<std::mutex> lock(_screenshot_job_mutex);
+
+				while (true)
+				{
+					_screenshot_job_added.wait(lock, [this]() { return _screenshot_job_threads_exit || !_screenshot_jobs.empty(); });
+
+					// Only exit once all queued jobs were processed
+					if (_screenshot_jobs.empty())
+						break;
+
+					const std::function<void()> job = std::move(_screenshot_jobs.front());
+					_screenshot_jobs.pop_front();
+
+					lock.unlock();
+					_screenshot_job_removed.notify_all();
+
+					job();
+
+					lock.lock();
+				}
+			});
+		}
+	}
+
+	// Apply back-pressure by blocking the caller until there is space in the queue again
+	_screenshot_job_removed.wait(lock, [this]() { return _screenshot_jobs.size() < max_pending_jobs; });
+
+	_screenshot_jobs.push_back(std::move(job));
+
+	lock.unlock();
+	_screenshot_job_added.notify_one();
+}
+void reshade::runtime::finish_screenshot_jobs()
+{
+	{
+		const std::unique_lock<std::mutex> lock(_screenshot_job_mutex);
+		_screenshot_job_threads_exit = true;
+	}
+
+	_screenshot_job_added.notify_all();
+
+	for (std::thread &thread : _screenshot_job_threads)
+		thread.join();
+	_screenshot_job_threads.clear();
+}
+
+// Raw frame sequence container that burst capture stages frames in until they are encoded (a header, followed by the frames as tightly packed 8-bit RGBA pixels at a fixed stride)
+struct frame_sequence_header
+{
+	uint32_t magic; // 'RSFS'
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t frame_count; // Number of frames that were written so far
+	uint32_t frame_capacity;
+	uint64_t frame_stride;
+	uint64_t data_offset;
+};
+
+struct reshade::runtime::screenshot_burst
+{
+	~screenshot_burst()
+	{
+		close();
+	}
+
+	void close()
+	{
+		if (data != nullptr)
+			UnmapViewOfFile(data);
+		data = nullptr;
+		if (mapping != nullptr)
+			CloseHandle(mapping);
+		mapping = nullptr;
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+
+	frame_sequence_header &header() const { return *reinterpret_cast<frame_sequence_header *>(data); }
+	uint8_t *frame_data(uint32_t index) const { return data + header().data_offset + index * header().frame_stride; }
+
+	std::filesystem::path path;
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+	uint8_t *data = nullptr;
+	uint32_t frames_requested = 0;
+	uint32_t frames_completed = 0;
+	bool stopped = false;
+};
+
+void reshade::runtime::begin_screenshot_burst()
+{
+	if (_screenshot_burst != nullptr || _screenshot_burst_frame_count == 0)
+		return;
+
+	_screenshot_count++;
+
+	std::string screenshot_name = expand_macro_string(_screenshot_name, {
+		{ "AppName", g_target_executable_path.stem().u8string() },
+#if RESHADE_FX
+		{ "PresetName",  _current_preset_path.stem().u8string() },
+		{ "Count", std::to_string(_screenshot_count) }
+#endif
+	});
+
+	screenshot_name += " burst.rsfs";
+
+	const auto burst = std::make_shared<screenshot_burst>();
+	burst->path = g_reshade_base_path / _screenshot_path / std::filesystem::u8path(screenshot_name);
+
+	std::error_code ec;
+	_screenshot_directory_creation_successful = true;
+	if (!std::filesystem::exists(burst->path.parent_path(), ec))
+		if (!(_screenshot_directory_creation_successful = std::filesystem::create_directories(burst->path.parent_path(), ec)))
+			LOG(ERROR) << "Failed to create screenshot directory " << burst->path.parent_path() << " with error code " << ec.value() << '!';
+
+	// Preallocate the whole file up front, so that capturing frames only has to copy into the mapped memory
+	const uint64_t data_offset = 4096;
+	const uint64_t frame_stride = static_cast<uint64_t>(_width) * static_cast<uint64_t>(_height) * 4;
+	const uint64_t file_size = data_offset + frame_stride * _screenshot_burst_frame_count;
+
+	burst->file = CreateFileW(burst->path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (burst->file != INVALID_HANDLE_VALUE)
+		burst->mapping = CreateFileMappingW(burst->file, nullptr, PAGE_READWRITE, static_cast<DWORD>(file_size >> 32), static_cast<DWORD>(file_size & 0xFFFFFFFF), nullptr);
+	if (burst->mapping != nullptr)
+		burst->data = static_cast<uint8_t *>(MapViewOfFile(burst->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+
+	if (burst->data == nullptr)
+	{
+		LOG(ERROR) << "Failed to create frame sequence file " << burst->path << " with size " << file_size << " for burst capture with error code " << GetLastError() << '!';
+		_last_screenshot_save_successful = false;
+
+		burst->close();
+		std::filesystem::remove(burst->path, ec);
+		return;
+	}
+
+	frame_sequence_header &header = burst->header();
+	header.magic = 0x53465352; // 'RSFS'
+	header.version = 1;
+	header.width = _width;
+	header.height = _height;
+	header.frame_count = 0;
+	header.frame_capacity = _screenshot_burst_frame_count;
+	header.frame_stride = frame_stride;
+	header.data_offset = data_offset;
+
+	LOG(INFO) << "Capturing " << _screenshot_burst_frame_count << " frames to " << burst->path << '.';
+
+	_screenshot_burst = burst;
+
+	// Play screenshot sound
+	if (!_screenshot_sound_path.empty())
+		utils::play_sound_async(g_reshade_base_path / _screenshot_sound_path);
+}
+void reshade::runtime::capture_screenshot_burst_frame()
+{
+	const std::shared_ptr<screenshot_burst> burst = _screenshot_burst;
+	const uint32_t frame_index = burst->frames_requested;
+
+	// Frames are copied into the mapped file as their readbacks complete a few frames later, so this does not stall the render thread
+	if (!request_texture_data(
+			_back_buffer_resolved != 0 ? _back_buffer_resolved : _swapchain->get_current_back_buffer(),
+			_back_buffer_resolved != 0 ? api::resource_usage::render_target : api::resource_usage::present,
+			[this, burst, frame_index](std::vector<uint8_t> &&pixels, uint32_t width, uint32_t height) {
+			frame_sequence_header &header = burst->header();
+			if (width == header.width && height == header.height && pixels.size() == header.frame_stride)
+			{
+				std::memcpy(burst->frame_data(frame_index), pixels.data(), pixels.size());
+				// Readbacks complete in order, so the written frames are always a contiguous range starting at the first one
+				header.frame_count = frame_index + 1;
+			}
+
+			if (++burst->frames_completed == burst->frames_requested && burst->stopped)
+				finish_screenshot_burst(burst);
+		}))
+	{
+		end_screenshot_burst();
+		return;
 	}
+
+	if (++burst->frames_requested == burst->header().frame_capacity)
+		end_screenshot_burst();
+}
+void reshade::runtime::end_screenshot_burst()
+{
+	const std::shared_ptr<screenshot_burst> burst = std::move(_screenshot_burst);
+	_screenshot_burst = nullptr;
+
+	burst->stopped = true;
+
+	// Finish right away if there are no outstanding readbacks, otherwise the last one to complete does so
+	if (burst->frames_completed == burst->frames_requested)
+		finish_screenshot_burst(burst);
+}
+void reshade::runtime::finish_screenshot_burst(const std::shared_ptr<screenshot_burst> &burst)
+{
+	const uint32_t frame_count = burst->header().frame_count;
+
+	LOG(INFO) << "Captured " << frame_count << " frames to " << burst->path << '.';
+
+	// Encode all frames in a single job on the screenshot worker threads, so that the render thread does not run into back-pressure for every frame
+	// Frames are only stored with 8-bit precision, so use the 8-bit PNG format in place of the high dynamic range formats
+	queue_screenshot_job([this, burst, frame_count, format = _screenshot_format >= 3 ? 1u : _screenshot_format, jpeg_quality = _screenshot_jpeg_quality, clear_alpha = _screenshot_clear_alpha]() {
+		const frame_sequence_header &header = burst->header();
+
+		std::filesystem::path base_path = burst->path;
+		base_path.replace_extension();
+
+		bool save_success = true;
+		std::filesystem::path frame_path;
+		std::vector<uint8_t> pixels;
+
+		for (uint32_t i = 0; i < frame_count && save_success; ++i)
+		{
+			pixels.assign(burst->frame_data(i), burst->frame_data(i) + header.frame_stride);
+
+			// Remove alpha channel
+			int comp = 4;
+			if (clear_alpha)
+			{
+				comp = 3;
+				utils::pack_rgba8_to_rgb8(pixels.data(), header.width, header.height);
+			}
+
+			std::string frame_index = std::to_string(i);
+			if (frame_index.size() < 4)
+				frame_index.insert(0, 4 - frame_index.size(), '0');
+
+			frame_path = base_path;
+			frame_path += ' ' + frame_index + (format == 0 ? ".bmp" : format == 1 ? ".png" : ".jpg");
+
+			if (!write_image_file(frame_path, format, jpeg_quality, pixels.data(), header.width, header.height, comp))
+			{
+				LOG(ERROR) << "Failed to write burst frame to " << frame_path << '!';
+				save_success = false;
+			}
+		}
+
+		// Raw frame data is no longer needed after encoding, and nothing else can read it, so always delete it (even if some frames failed to be written)
+		burst->close();
+
+		std::error_code ec;
+		std::filesystem::remove(burst->path, ec);
+
+		if (save_success)
+			LOG(INFO) << "Encoded " << frame_count << " burst frames to " << base_path.parent_path() << '.';
+
+		if (_last_screenshot_save_successful)
+		{
+			_last_screenshot_time = std::chrono::high_resolution_clock::now();
+			_last_screenshot_file = frame_path;
+			_last_screenshot_save_successful = save_success;
+		}
+	});
 }
+
 bool reshade::runtime::execute_screenshot_post_save_command(const std::filesystem::path &screenshot_path, unsigned int screenshot_count)
 {
 	if (_screenshot_post_save_command.empty() || _screenshot_post_save_command.extension() != L".exe")
@@ -5071,111 +7008,150 @@ bool reshade::runtime::execute_screenshot_post_save_command(const std::filesyste
 	return true;
 }
 
-bool reshade::runtime::get_texture_data(api::resource resource, api::resource_usage state, uint8_t *pixels)
+bool reshade::runtime::request_texture_data(api::resource resource, api::resource_usage state, std::function<void(std::vector<uint8_t> &&pixels, uint32_t width, uint32_t height)> &&callback, api::format output_format)
 {
+	assert(output_format == api::format::r8g8b8a8_unorm || output_format == api::format::r32g32b32a32_float);
+
 	const api::resource_desc desc = _device->get_resource_desc(resource);
 	const api::format view_format = api::format_to_default_typed(desc.texture.format, 0);
 
-	if (view_format != api::format::r8_unorm &&
-		view_format != api::format::r8g8_unorm &&
-		view_format != api::format::r8g8b8a8_unorm &&
-		view_format != api::format::b8g8r8a8_unorm &&
-		view_format != api::format::r8g8b8x8_unorm &&
-		view_format != api::format::b8g8r8x8_unorm &&
-		view_format != api::format::r10g10b10a2_unorm &&
-		view_format != api::format::b10g10r10a2_unorm)
+	if (output_format == api::format::r32g32b32a32_float ?
+			utils::find_convert_row_to_rgba32f(view_format) == nullptr :
+			utils::find_convert_row_to_rgba8(view_format) == nullptr)
 	{
 		LOG(ERROR) << "Screenshots are not supported for format " << static_cast<uint32_t>(desc.texture.format) << '!';
 		return false;
 	}
 
-	// Copy back buffer data into system memory buffer
-	api::resource intermediate;
-	if (!_device->create_resource(api::resource_desc(desc.texture.width, desc.texture.height, 1, 1, view_format, 1, api::memory_heap::gpu_to_cpu, api::resource_usage::copy_dest), nullptr, api::resource_usage::copy_dest, &intermediate))
+	if (_readback_fence == 0 && !_device->create_fence(0, api::fence_flags::none, &_readback_fence))
+		_readback_fence = {}; // Fall back to waiting for idle below
+
+	texture_readback &slot = _readback_slots[_readback_next_slot];
+
+	// Complete the oldest readback first if all slots are still in use
+	if (slot.fence_value != 0)
+		process_texture_readbacks(true);
+	assert(slot.fence_value == 0);
+
+	const api::resource_desc intermediate_desc(desc.texture.width, desc.texture.height, 1, 1, view_format, 1, api::memory_heap::gpu_to_cpu, api::resource_usage::copy_dest);
+
+	// Reuse the intermediate texture of this slot if it matches
+	if (slot.intermediate != 0 && (slot.desc.texture.width != intermediate_desc.texture.width || slot.desc.texture.height != intermediate_desc.texture.height || slot.desc.texture.format != intermediate_desc.texture.format))
 	{
-		LOG(ERROR) << "Failed to create system memory texture for screenshot capture!";
-		return false;
+		_device->destroy_resource(slot.intermediate);
+		slot.intermediate = {};
 	}
 
-	_device->set_resource_name(intermediate, "ReShade screenshot texture");
+	if (slot.intermediate == 0)
+	{
+		// Copy back buffer data into system memory buffer
+		if (!_device->create_resource(intermediate_desc, nullptr, api::resource_usage::copy_dest, &slot.intermediate))
+		{
+			LOG(ERROR) << "Failed to create system memory texture for screenshot capture!";
+			return false;
+		}
+
+		_device->set_resource_name(slot.intermediate, "ReShade screenshot texture");
+
+		slot.desc = intermediate_desc;
+	}
 
 	api::command_list *const cmd_list = _graphics_queue->get_immediate_command_list();
 	cmd_list->barrier(resource, state, api::resource_usage::copy_source);
-	cmd_list->copy_texture_region(resource, 0, nullptr, intermediate, 0, nullptr);
+	cmd_list->copy_texture_region(resource, 0, nullptr, slot.intermediate, 0, nullptr);
 	cmd_list->barrier(resource, api::resource_usage::copy_source, state);
 
-	api::fence copy_sync_fence = {};
-	if (!_device->create_fence(0, api::fence_flags::none, &copy_sync_fence) || !_graphics_queue->signal(copy_sync_fence, 1) || !_device->wait(copy_sync_fence, 1))
+	if (_readback_fence == 0 || !_graphics_queue->signal(_readback_fence, _readback_fence_value + 1))
+	{
 		_graphics_queue->wait_idle();
-	_device->destroy_fence(copy_sync_fence);
+		slot.fence_value = std::numeric_limits<uint64_t>::max(); // Treat as completed
+	}
+	else
+	{
+		slot.fence_value = ++_readback_fence_value;
+	}
+
+	slot.callback = std::move(callback);
+	slot.output_format = output_format;
+
+	_readback_next_slot = (_readback_next_slot + 1) % std::size(_readback_slots);
+
+	return true;
+}
 
-	// Copy data from intermediate image into output buffer
-	api::subresource_data mapped_data = {};
-	if (_device->map_texture_region(intermediate, 0, nullptr, api::map_access::read_only, &mapped_data))
+void reshade::runtime::process_texture_readbacks(bool wait)
+{
+	// Process slots from oldest to newest, so that callbacks are invoked in the order the readbacks were requested
+	for (size_t i = 0; i < std::size(_readback_slots); ++i)
 	{
-		auto mapped_pixels = static_cast<const uint8_t *>(mapped_data.data);
-		const uint32_t pixels_row_pitch = desc.texture.width * 4;
+		texture_readback &slot = _readback_slots[(_readback_next_slot + i) % std::size(_readback_slots)];
+		if (slot.fence_value == 0)
+			continue;
+
+		if (slot.fence_value != std::numeric_limits<uint64_t>::max() && _device->get_completed_fence_value(_readback_fence) < slot.fence_value)
+		{
+			if (!wait)
+				break; // Later slots cannot have completed before this one either
+			if (!_device->wait(_readback_fence, slot.fence_value))
+				_graphics_queue->wait_idle();
+		}
+
+		slot.fence_value = 0;
 
-		for (size_t y = 0; y < desc.texture.height; ++y, pixels += pixels_row_pitch, mapped_pixels += mapped_data.row_pitch)
+		// Copy data from intermediate image into output buffer
+		std::vector<uint8_t> pixels;
+		if (api::subresource_data mapped_data = {};
+			_device->map_texture_region(slot.intermediate, 0, nullptr, api::map_access::read_only, &mapped_data))
 		{
-			switch (view_format)
+			const size_t width = slot.desc.texture.width;
+
+			if (slot.output_format == api::format::r32g32b32a32_float)
 			{
-			case api::format::r8_unorm:
-				for (size_t x = 0; x < desc.texture.width; ++x)
-				{
-					pixels[x * 4 + 0] = mapped_pixels[x];
-					pixels[x * 4 + 1] = 0;
-					pixels[x * 4 + 2] = 0;
-					pixels[x * 4 + 3] = 0xFF;
-				}
-				break;
-			case api::format::r8g8_unorm:
-				for (size_t x = 0; x < desc.texture.width; ++x)
-				{
-					pixels[x * 4 + 0] = mapped_pixels[x * 2 + 0];
-					pixels[x * 4 + 1] = mapped_pixels[x * 2 + 1];
-					pixels[x * 4 + 2] = 0;
-					pixels[x * 4 + 3] = 0xFF;
-				}
-				break;
-			case api::format::r8g8b8a8_unorm:
-			case api::format::r8g8b8x8_unorm:
-				std::memcpy(pixels, mapped_pixels, pixels_row_pitch);
-				if (view_format == api::format::r8g8b8x8_unorm)
-					for (size_t x = 0; x < pixels_row_pitch; x += 4)
-						pixels[x + 3] = 0xFF;
-				break;
-			case api::format::b8g8r8a8_unorm:
-			case api::format::b8g8r8x8_unorm:
-				std::memcpy(pixels, mapped_pixels, pixels_row_pitch);
-				// Format is BGRA, but output should be RGBA, so flip channels
-				for (size_t x = 0; x < pixels_row_pitch; x += 4)
-					std::swap(pixels[x + 0], pixels[x + 2]);
-				if (view_format == api::format::b8g8r8x8_unorm)
-					for (size_t x = 0; x < pixels_row_pitch; x += 4)
-						pixels[x + 3] = 0xFF;
-				break;
-			case api::format::r10g10b10a2_unorm:
-			case api::format::b10g10r10a2_unorm:
-				for (size_t x = 0; x < pixels_row_pitch; x += 4)
-				{
-					const uint32_t rgba = *reinterpret_cast<const uint32_t *>(mapped_pixels + x);
-					// Divide by 4 to get 10-bit range (0-1023) into 8-bit range (0-255)
-					pixels[x + 0] = (( rgba & 0x000003FF)        /  4) & 0xFF;
-					pixels[x + 1] = (((rgba & 0x000FFC00) >> 10) /  4) & 0xFF;
-					pixels[x + 2] = (((rgba & 0x3FF00000) >> 20) /  4) & 0xFF;
-					pixels[x + 3] = (((rgba & 0xC0000000) >> 30) * 85) & 0xFF;
-					if (view_format == api::format::b10g10r10a2_unorm)
-						std::swap(pixels[x + 0], pixels[x + 2]);
-				}
-				break;
+				pixels.resize(width * slot.desc.texture.height * 4 * sizeof(float));
+
+				const utils::convert_row_float_func convert_row = utils::find_convert_row_to_rgba32f(slot.desc.texture.format);
+				assert(convert_row != nullptr);
+
+				for (size_t y = 0; y < slot.desc.texture.height; ++y)
+					convert_row(static_cast<const uint8_t *>(mapped_data.data) + y * mapped_data.row_pitch, reinterpret_cast<float *>(pixels.data()) + y * width * 4, width);
+			}
+			else
+			{
+				pixels.resize(width * slot.desc.texture.height * 4);
+
+				const utils::convert_row_func convert_row = utils::find_convert_row_to_rgba8(slot.desc.texture.format);
+				assert(convert_row != nullptr);
+
+				for (size_t y = 0; y < slot.desc.texture.height; ++y)
+					convert_row(static_cast<const uint8_t *>(mapped_data.data) + y * mapped_data.row_pitch, pixels.data() + y * width * 4, width);
 			}
+
+			_device->unmap_texture_region(slot.intermediate, 0);
 		}
 
-		_device->unmap_texture_region(intermediate, 0);
+		// Empty pixel data signals a failed readback to the callback
+		const std::function<void(std::vector<uint8_t> &&pixels, uint32_t width, uint32_t height)> callback = std::move(slot.callback);
+		slot.callback = nullptr;
+		if (callback)
+			callback(std::move(pixels), slot.desc.texture.width, slot.desc.texture.height);
 	}
+}
+
+bool reshade::runtime::get_texture_data(api::resource resource, api::resource_usage state, uint8_t *pixels, api::format output_format)
+{
+	bool success = false;
+
+	if (!request_texture_data(resource, state,
+			[pixels, &success](std::vector<uint8_t> &&data, uint32_t, uint32_t) {
+				if (data.empty())
+					return;
+				std::memcpy(pixels, data.data(), data.size());
+				success = true;
+			}, output_format))
+		return false;
 
-	_device->destroy_resource(intermediate);
+	// Wait for this readback (and all the ones requested before it) to complete
+	process_texture_readbacks(true);
 
-	return mapped_data.data != nullptr;
+	return success;
 }
@@ -12,7 +12,11 @@
 #include <memory>
 #include <filesystem>
 #include <atomic>
+#include <deque>
+#include <functional>
+#include <condition_variable>
 #include <shared_mutex>
+#include <limits>
 
 class ini_file;
 namespace reshadefx { struct sampler_info; }
@@ -20,9 +24,11 @@ namespace reshadefx { struct sampler_info; }
 namespace reshade
 {
 	struct effect;
+	struct effect_permutation;
 	struct uniform;
 	struct texture;
 	struct technique;
+	struct transient_resource;
 
 	/// <summary>
 	/// The main ReShade post-processing effect runtime.
@@ -71,6 +77,10 @@ namespace reshade
 		/// Captures a screenshot of the current back buffer resource and writes it to an image file on disk.
 		/// </summary>
 		void save_screenshot(const std::string_view postfix = std::string_view());
+		/// <summary>
+		/// Starts capturing a sequence of consecutive frames into a raw memory-mapped frame sequence file on disk, which is encoded to image files once complete.
+		/// </summary>
+		void begin_screenshot_burst();
 		bool capture_screenshot(void *pixels) final { return get_texture_data(_back_buffer_resolved != 0 ? _back_buffer_resolved : _swapchain->get_current_back_buffer(), _back_buffer_resolved != 0 ? api::resource_usage::render_target : api::resource_usage::present, static_cast<uint8_t *>(pixels)); }
 
 		void get_screenshot_width_and_height(uint32_t *out_width, uint32_t *out_height) const final { *out_width = _width; *out_height = _height; }
@@ -151,6 +161,9 @@ namespace reshade
 		bool get_technique_state(api::effect_technique technique) const final;
 		void set_technique_state(api::effect_technique technique, bool enabled) final;
 
+		bool get_technique_pass_timings(api::effect_technique technique, size_t pass_index, uint64_t *out_cpu_duration, uint64_t *out_gpu_duration, uint64_t *out_gpu_transition_duration) final;
+		bool capture_technique_timings(uint32_t frame_count, const char *path) final;
+
 		bool get_preprocessor_definition(const char *name, char *value, size_t *value_size) const final;
 		bool get_preprocessor_definition_for_effect(const char *effect_name, const char *name, char *value, size_t *value_size) const final;
 		void set_preprocessor_definition(const char *name, const char *value) final;
@@ -178,14 +191,21 @@ namespace reshade
 		void load_current_preset();
 		void save_current_preset() const final;
 
+		struct preset_snapshot;
+		const preset_snapshot &get_preset_snapshot(const ini_file &preset);
+
 		bool switch_to_next_preset(std::filesystem::path filter_path, bool reversed = false);
 
+		std::vector<std::pair<std::string, std::string>> get_effect_preprocessor_definitions(const std::string &effect_name) const;
 		bool load_effect(const std::filesystem::path &source_file, const ini_file &preset, size_t effect_index, bool force_load = false, bool preprocess_required = false);
+		bool compile_effect(size_t effect_index, const std::string &code_preamble, bool skip_optimization, effect_assembly &output);
+		void compile_effect_async(size_t effect_index);
 		bool create_effect(size_t effect_index);
 		bool create_effect_sampler_state(const reshadefx::sampler_info &info, api::sampler &sampler);
 		void destroy_effect(size_t effect_index);
 
 		void load_textures();
+		bool load_texture_data(const texture &texture, const std::filesystem::path &source_path, std::vector<uint8_t> &data) const;
 		bool create_texture(texture &texture);
 		void destroy_texture(texture &texture);
 
@@ -195,19 +215,27 @@ namespace reshade
 		void reorder_techniques(std::vector<size_t> &&technique_indices);
 
 		void load_effects(bool force_load_all = false);
+		void load_effects_async(std::vector<std::pair<std::filesystem::path, size_t>> &&effect_files, bool force_load_all);
 		bool reload_effect(size_t effect_index);
+		bool reload_changed_effects();
 		void reload_effects(bool force_load_all = false);
+		void wait_for_effect_compilation(size_t effect_index);
 		void destroy_effects();
 
 		bool load_effect_cache(const std::string &id, const std::string &type, std::string &data) const;
 		bool save_effect_cache(const std::string &id, const std::string &type, const std::string &data) const;
+		bool load_effect_metadata(const std::string &id, effect &effect, std::string &code_preamble, bool &skip_optimization) const;
+		bool save_effect_metadata(const std::string &id, const effect &effect, const std::string &code_preamble, bool skip_optimization) const;
 		void clear_effect_cache();
 
 		bool update_effect_color_and_stencil_tex(uint32_t width, uint32_t height, api::format color_format, api::format stencil_format);
 
 		void update_effects();
+		void update_performance_governor();
 		void render_technique(technique &technique, api::command_list *cmd_list, api::resource back_buffer_resource, api::resource_view back_buffer_rtv, api::resource_view back_buffer_rtv_srgb);
 
+		void save_timing_capture();
+
 		void save_texture(const texture &texture);
 		void update_texture(texture &texture, uint32_t width, uint32_t height, uint32_t depth, const void *pixels);
 
@@ -235,7 +263,17 @@ namespace reshade
 		void save_current_preset() const final {}
 #endif
 
-		bool get_texture_data(api::resource resource, api::resource_usage state, uint8_t *pixels);
+		bool get_texture_data(api::resource resource, api::resource_usage state, uint8_t *pixels, api::format output_format = api::format::r8g8b8a8_unorm);
+		bool request_texture_data(api::resource resource, api::resource_usage state, std::function<void(std::vector<uint8_t> &&pixels, uint32_t width, uint32_t height)> &&callback, api::format output_format = api::format::r8g8b8a8_unorm);
+		void process_texture_readbacks(bool wait = false);
+
+		void queue_screenshot_job(std::function<void()> &&job);
+		void finish_screenshot_jobs();
+
+		struct screenshot_burst;
+		void capture_screenshot_burst_frame();
+		void end_screenshot_burst();
+		void finish_screenshot_burst(const std::shared_ptr<screenshot_burst> &burst);
 
 		bool execute_screenshot_post_save_command(const std::filesystem::path &screenshot_path, unsigned int screenshot_count);
 
@@ -286,13 +324,17 @@ namespace reshade
 		bool _no_effect_cache = false;
 		bool _no_reload_on_init = false;
 		bool _performance_mode = false;
+		unsigned int _effect_permutation_cache_size = 8;
 		bool _effect_load_skipping = false;
+		bool _effect_load_lazy = false;
+		bool _alias_transient_textures = false;
 		unsigned int _reload_key_data[4] = {};
 		unsigned int _performance_mode_key_data[4] = {};
 
 		std::vector<std::pair<std::string, std::string>> _global_preprocessor_definitions;
 		std::unordered_map<std::string, std::vector<std::pair<std::string, std::string>>> _preset_preprocessor_definitions;
 		size_t _should_reload_effect = std::numeric_limits<size_t>::max();
+		bool _should_reload_affected_effects = false;
 		bool _block_effect_reload_this_frame = false;
 
 		std::filesystem::path _effect_cache_path;
@@ -304,6 +346,11 @@ namespace reshade
 		std::shared_mutex _reload_mutex;
 		std::vector<size_t> _reload_create_queue;
 		std::atomic<size_t> _reload_remaining_effects = std::numeric_limits<size_t>::max();
+		std::mutex _lazy_compile_mutex;
+		std::vector<std::pair<size_t, effect_assembly>> _lazy_compile_finished;
+		std::vector<std::pair<size_t, std::thread>> _lazy_compile_threads;
+		std::mutex _effect_permutation_cache_mutex;
+		std::vector<effect_permutation> _effect_permutation_cache; // Ordered from most to least recently used
 		void *_d3d_compiler_module = nullptr;
 
 		std::vector<effect> _effects;
@@ -328,6 +375,45 @@ namespace reshade
 		api::resource _effect_stencil_tex = {};
 		api::resource_view _effect_stencil_dsv = {};
 
+		std::vector<transient_resource> _transient_resources;
+		size_t _uniform_push_effect_index = std::numeric_limits<size_t>::max(); // Effect whose uniform data was last pushed as constants (D3D9)
+
+		// State bound on the command list by 'render_technique', so that binds which would not change anything can be skipped between passes and techniques
+		struct effect_bind_state
+		{
+			api::pipeline pipeline[2]; // Graphics and compute
+			api::pipeline_layout layout[2];
+			api::descriptor_table tables[2][2]; // Constant buffer and sampler tables (texture and storage tables are not tracked, since binding render targets or storages can implicitly unbind them)
+			uint32_t viewport_width, viewport_height;
+		} _effect_bind_state = {};
+		uint32_t _effect_bind_calls[2] = {}; // Number of binds issued and skipped in the current frame
+		uint32_t _last_effect_bind_calls[2] = {};
+
+		float _frame_time_budget = 0.0f; // In milliseconds, zero disables the performance governor
+		float _governor_frame_time = 0.0f; // Smoothed frame time in milliseconds
+		uint64_t _governor_next_frame = 0;
+		bool _governor_active = false;
+
+		uint64_t _timestamp_frequency = 0;
+		uint64_t _timings_requested_until_frame = 0; // GPU timings are gathered until this frame after they were queried through the API
+
+		struct timing_capture_event
+		{
+			uint64_t frame;
+			const char *category;
+			std::string name;
+			bool gpu;
+			uint64_t start; // In nanoseconds since the capture started (on the CPU or GPU timeline)
+			uint64_t duration;
+		};
+
+		std::filesystem::path _timing_capture_path;
+		uint64_t _timing_capture_first_frame = 0;
+		uint64_t _timing_capture_last_frame = 0; // Exclusive, capture is not in progress if this is zero
+		uint64_t _timing_capture_gpu_base = 0;
+		std::chrono::high_resolution_clock::time_point _timing_capture_cpu_base;
+		std::vector<timing_capture_event> _timing_capture_events;
+
 		std::unordered_map<size_t, api::sampler> _effect_sampler_states;
 		std::unordered_map<std::string, std::pair<api::resource_view, api::resource_view>> _texture_semantic_bindings;
 #if RESHADE_ADDON == 1
@@ -346,6 +432,21 @@ namespace reshade
 
 		api::fence _queue_sync_fence = {};
 		uint64_t _queue_sync_value = 0;
+
+		// Ring of host-visible textures that texture data is copied into, so that it can be read back a few frames later without waiting for the GPU
+		struct texture_readback
+		{
+			api::resource intermediate = {};
+			api::resource_desc desc;
+			uint64_t fence_value = 0; // Value of '_readback_fence' once the copy into 'intermediate' finished, or zero if no readback is pending
+			std::function<void(std::vector<uint8_t> &&pixels, uint32_t width, uint32_t height)> callback;
+			api::format output_format = api::format::r8g8b8a8_unorm; // Either 8-bit RGBA or 32-bit floating-point RGBA
+		};
+
+		api::fence _readback_fence = {};
+		uint64_t _readback_fence_value = 0;
+		texture_readback _readback_slots[3];
+		size_t _readback_next_slot = 0;
 		#pragma endregion
 
 		#pragma region Screenshot
@@ -374,6 +475,18 @@ namespace reshade
 		bool _screenshot_directory_creation_successful = true;
 		std::filesystem::path _last_screenshot_file;
 		std::chrono::high_resolution_clock::time_point _last_screenshot_time;
+
+		// Bounded queue of encoding jobs processed by a persistent pool of threads, so that burst screenshots do not pile up threads and pixel data
+		std::mutex _screenshot_job_mutex;
+		std::condition_variable _screenshot_job_added;
+		std::condition_variable _screenshot_job_removed;
+		std::deque<std::function<void()>> _screenshot_jobs;
+		std::vector<std::thread> _screenshot_job_threads;
+		bool _screenshot_job_threads_exit = false;
+
+		unsigned int _screenshot_burst_key_data[4] = {};
+		unsigned int _screenshot_burst_frame_count = 120;
+		std::shared_ptr<screenshot_burst> _screenshot_burst;
 		#pragma endregion
 
 		#pragma region Preset Switching
@@ -387,6 +500,34 @@ namespace reshade
 		bool _is_in_preset_transition = false;
 		std::chrono::high_resolution_clock::time_point _last_preset_switching_time;
 
+		// Values of a preset resolved against the currently loaded effects, so that switching to a preset again does not have to look up and convert every value in the INI
+		struct preset_snapshot_value
+		{
+			size_t effect_index;
+			size_t uniform_index;
+			bool has_value;
+			bool has_toggle_key;
+			union
+			{
+				int as_int[16];
+				unsigned int as_uint[16];
+				float as_float[16];
+			} value;
+			unsigned int toggle_key_data[4];
+		};
+		struct preset_snapshot
+		{
+			std::filesystem::path preset_path;
+			uint64_t preset_version = std::numeric_limits<uint64_t>::max();
+			std::vector<preset_snapshot_value> values;
+		};
+		std::vector<preset_snapshot> _preset_snapshots; // Ordered from most to least recently used
+		// Incremented whenever the uniform variables of an effect are recreated, which invalidates the indices stored in all preset snapshots
+		std::atomic<uint64_t> _effect_uniforms_version = 0;
+		uint64_t _preset_snapshots_uniforms_version = 0;
+		// Value of '_last_preset_switching_time' when the uniform data of the current transition was captured
+		std::chrono::high_resolution_clock::time_point _preset_transition_start_time;
+
 		struct preset_shortcut
 		{
 			std::filesystem::path preset_path;
@@ -518,7 +659,8 @@ namespace reshade
 		bool _gather_gpu_statistics = false;
 		api::resource_view _preview_texture = {};
 		unsigned int _preview_size[3] = { 0, 0, 0xFFFFFFFF };
-		uint64_t _timestamp_frequency = 0;
+		int _timing_capture_frame_count = 10;
+		int _timing_capture_format = 0;
 #endif
 		#pragma endregion
 
@@ -1055,6 +1055,68 @@ void reshade::runtime::set_technique_state([[maybe_unused]] api::effect_techniqu
 #endif
 }
 
+bool reshade::runtime::get_technique_pass_timings([[maybe_unused]] api::effect_technique handle, [[maybe_unused]] size_t pass_index, uint64_t *out_cpu_duration, uint64_t *out_gpu_duration, uint64_t *out_gpu_transition_duration)
+{
+#if RESHADE_FX
+	const auto tech = reinterpret_cast<const technique *>(handle.handle);
+	if (tech != nullptr && (pass_index == std::numeric_limits<size_t>::max() || pass_index < tech->passes_data.size()))
+	{
+		// Keep gathering GPU timings for a while, as long as add-ons keep querying them
+		_timings_requested_until_frame = _frame_count + 60;
+
+		if (pass_index == std::numeric_limits<size_t>::max())
+		{
+			if (out_cpu_duration != nullptr)
+				*out_cpu_duration = tech->average_cpu_duration;
+			if (out_gpu_duration != nullptr)
+				*out_gpu_duration = tech->average_gpu_duration;
+			if (out_gpu_transition_duration != nullptr)
+				*out_gpu_transition_duration = tech->average_gpu_transition_duration;
+		}
+		else
+		{
+			const technique::pass_data &pass_data = tech->passes_data[pass_index];
+
+			if (out_cpu_duration != nullptr)
+				*out_cpu_duration = pass_data.average_cpu_duration;
+			if (out_gpu_duration != nullptr)
+				*out_gpu_duration = pass_data.average_gpu_duration;
+			if (out_gpu_transition_duration != nullptr)
+				*out_gpu_transition_duration = pass_data.average_gpu_transition_duration;
+		}
+
+		return true;
+	}
+#endif
+
+	if (out_cpu_duration != nullptr)
+		*out_cpu_duration = 0;
+	if (out_gpu_duration != nullptr)
+		*out_gpu_duration = 0;
+	if (out_gpu_transition_duration != nullptr)
+		*out_gpu_transition_duration = 0;
+	return false;
+}
+
+bool reshade::runtime::capture_technique_timings([[maybe_unused]] uint32_t frame_count, [[maybe_unused]] const char *path)
+{
+#if RESHADE_FX
+	if (_timing_capture_last_frame != 0 || frame_count == 0 || path == nullptr)
+		return false;
+
+	_timing_capture_path = std::filesystem::u8path(path);
+	_timing_capture_first_frame = _frame_count;
+	_timing_capture_last_frame = _frame_count + frame_count;
+	_timing_capture_gpu_base = 0;
+	_timing_capture_cpu_base = std::chrono::high_resolution_clock::now();
+	_timing_capture_events.clear();
+
+	return true;
+#else
+	return false;
+#endif
+}
+
 constexpr int EFFECT_SCOPE_FLAG = 0b001;
 constexpr int PRESET_SCOPE_FLAG = 0b010;
 constexpr int GLOBAL_SCOPE_FLAG = 0b100;
@@ -1211,7 +1273,7 @@ void reshade::runtime::set_preprocessor_definition_for_effect([[maybe_unused]] c
 
 		if ((scope_mask_updated & (GLOBAL_SCOPE_FLAG | PRESET_SCOPE_FLAG)) != 0)
 		{
-			_should_reload_effect = _effects.size();
+			_should_reload_affected_effects = true;
 		}
 		else
 		{
@@ -1408,6 +1470,10 @@ void reshade::runtime::render_technique(api::effect_technique handle, api::comma
 	_is_in_api_call = true;
 #endif
 
+	// Application may have modified constant registers and bound state since effects were last rendered
+	_uniform_push_effect_index = std::numeric_limits<size_t>::max();
+	_effect_bind_state = {};
+
 	render_technique(*tech, cmd_list, back_buffer_resource, rtv, rtv_srgb);
 
 #if RESHADE_ADDON
@@ -2156,6 +2156,25 @@ void reshade::runtime::draw_gui_settings()
 			reload_effects(!_effect_load_skipping);
 		}
 
+		if (ImGui::Checkbox(_("Compile effects on demand"), &_effect_load_lazy))
+		{
+			modified = true;
+
+			reload_effects(!_effect_load_skipping && !_effect_load_lazy);
+		}
+		ImGui::SetItemTooltip(_("List all effects, but only compile them once one of their techniques is enabled.\nThis speeds up loading of large effect collections."));
+
+		if (ImGui::Checkbox(_("Share memory of transient textures"), &_alias_transient_textures))
+		{
+			modified = true;
+
+			reload_effects(!_effect_load_skipping && !_effect_load_lazy);
+		}
+		ImGui::SetItemTooltip(_("Let render targets that are only used as intermediate results within a single technique share memory with those of other techniques.\nThis reduces video memory usage of large effect collections."));
+
+		modified |= ImGui::SliderFloat(_("Frame time budget"), &_frame_time_budget, 0.0f, 50.0f, _frame_time_budget > 0.0f ? "%.1f ms" : _("Off"), ImGuiSliderFlags_AlwaysClamp);
+		ImGui::SetItemTooltip(_("When the frame time exceeds this budget, lower the render scale of the most expensive effects that support it (via a uniform with the \"render_scale\" source) and then skip techniques, starting with those of the lowest \"priority\" annotation.\nQuality is restored once the frame time drops sufficiently below the budget again."));
+
 		if (ImGui::Button(_("Clear effect cache"), ImVec2(ImGui::CalcItemWidth(), 0)))
 			clear_effect_cache();
 		ImGui::SetItemTooltip(_("Clear effect cache located in \"%s\"."), _effect_cache_path.u8string().c_str());
@@ -2167,6 +2186,8 @@ void reshade::runtime::draw_gui_settings()
 		if (_input != nullptr)
 		{
 			modified |= imgui::key_input_box(_("Screenshot key"), _screenshot_key_data, *_input);
+			modified |= imgui::key_input_box(_("Burst capture key"), _screenshot_burst_key_data, *_input);
+			ImGui::SetItemTooltip(_("Captures a sequence of consecutive frames into a raw frame sequence file in the screenshot path."));
 		}
 
 		modified |= imgui::directory_input_box(_("Screenshot path"), _screenshot_path, _file_selection_path);
@@ -2205,7 +2226,7 @@ void reshade::runtime::draw_gui_settings()
 				"HH-mm-ss");
 		}
 
-		modified |= ImGui::Combo(_("Screenshot format"), reinterpret_cast<int *>(&_screenshot_format), "Bitmap (*.bmp)\0Portable Network Graphics (*.png)\0JPEG (*.jpeg)\0");
+		modified |= ImGui::Combo(_("Screenshot format"), reinterpret_cast<int *>(&_screenshot_format), "Bitmap (*.bmp)\0Portable Network Graphics (*.png)\0JPEG (*.jpeg)\0Portable Network Graphics, 16-bit (*.png)\0Radiance HDR (*.hdr)\0");
 
 		if (_screenshot_format == 2)
 			modified |= ImGui::SliderInt(_("JPEG quality"), reinterpret_cast<int *>(&_screenshot_jpeg_quality), 1, 100, "%d", ImGuiSliderFlags_AlwaysClamp);
@@ -2218,6 +2239,8 @@ void reshade::runtime::draw_gui_settings()
 #endif
 		modified |= ImGui::Checkbox(_("Save separate image with the overlay visible"), &_screenshot_save_gui);
 
+		modified |= ImGui::SliderInt(_("Burst frame count"), reinterpret_cast<int *>(&_screenshot_burst_frame_count), 1, 1000, "%d", ImGuiSliderFlags_AlwaysClamp);
+
 		modified |= imgui::file_input_box(_("Screenshot sound"), "sound.wav", _screenshot_sound_path, _file_selection_path, { L".wav" });
 		ImGui::SetItemTooltip(_("Audio file that is played when taking a screenshot."));
 
@@ -2236,7 +2259,7 @@ void reshade::runtime::draw_gui_settings()
 
 		if (ImGui::IsItemHovered(ImGuiHoveredFlags_ForTooltip))
 		{
-			const std::string extension = _screenshot_format == 0 ? ".bmp" : _screenshot_format == 1 ? ".png" : ".jpg";
+			const std::string extension = _screenshot_format == 0 ? ".bmp" : _screenshot_format == 2 ? ".jpg" : _screenshot_format == 4 ? ".hdr" : ".png";
 
 			ImGui::SetTooltip(_(
 				"Macros you can add that are resolved during command execution:\n"
@@ -2576,6 +2599,7 @@ void reshade::runtime::draw_gui_statistics()
 #if RESHADE_FX
 		ImGui::TextUnformatted(_("Resolution:"));
 		ImGui::TextUnformatted(_("Post-Processing:"));
+		ImGui::TextUnformatted(_("State binds:"));
 #endif
 
 		ImGui::EndGroup();
@@ -2616,6 +2640,7 @@ void reshade::runtime::draw_gui_statistics()
 #if RESHADE_FX
 		ImGui::Text("%ux%u", _effect_width, _effect_height);
 		ImGui::Text("%*.3f ms CPU", cpu_digits + 4, post_processing_time_cpu * 1e-6f);
+		ImGui::Text(_("%u issued"), _last_effect_bind_calls[0]);
 #endif
 
 		ImGui::EndGroup();
@@ -2634,6 +2659,9 @@ void reshade::runtime::draw_gui_statistics()
 		ImGui::Text("format %u", _effect_color_format);
 		if (_gather_gpu_statistics && post_processing_time_gpu != 0)
 			ImGui::Text("%*.3f ms GPU", gpu_digits + 4, (post_processing_time_gpu * 1e-6f));
+		else
+			ImGui::NewLine();
+		ImGui::Text(_("%u skipped"), _last_effect_bind_calls[1]);
 #endif
 
 		ImGui::EndGroup();
@@ -2660,6 +2688,28 @@ void reshade::runtime::draw_gui_statistics()
 			else
 				ImGui::TextUnformatted(tech.name.c_str(), tech.name.c_str() + tech.name.size());
 
+			if (tech.passes.size() > 1 && tech.passes_data.size() == tech.passes.size() && ImGui::IsItemHovered())
+			{
+				ImGui::BeginTooltip();
+				for (size_t pass_index = 0; pass_index < tech.passes.size(); ++pass_index)
+				{
+					const reshade::technique::pass_data &pass_data = tech.passes_data[pass_index];
+
+					if (tech.passes[pass_index].name.empty())
+						ImGui::Text(_("Pass %zu"), pass_index);
+					else
+						ImGui::TextUnformatted(tech.passes[pass_index].name.c_str(), tech.passes[pass_index].name.c_str() + tech.passes[pass_index].name.size());
+					ImGui::SameLine(ImGui::GetFontSize() * 12);
+					ImGui::Text("%*.3f ms CPU", cpu_digits + 4, pass_data.average_cpu_duration * 1e-6f);
+					if (_gather_gpu_statistics && pass_data.average_gpu_duration != 0)
+					{
+						ImGui::SameLine();
+						ImGui::Text(_("%*.3f ms GPU (%.3f ms transitions)"), gpu_digits + 4, pass_data.average_gpu_duration * 1e-6f, pass_data.average_gpu_transition_duration * 1e-6f);
+					}
+				}
+				ImGui::EndTooltip();
+			}
+
 			long_technique_name[technique_index] = (ImGui::GetItemRectSize().x + 10.0f) > (ImGui::GetWindowWidth() * 0.33333333f);
 			if (long_technique_name[technique_index])
 				ImGui::NewLine();
@@ -2707,6 +2757,29 @@ void reshade::runtime::draw_gui_statistics()
 		}
 
 		ImGui::EndGroup();
+
+		ImGui::Spacing();
+
+		// Capture per-pass timings of multiple frames to a file for offline analysis
+		ImGui::BeginDisabled(_timing_capture_last_frame != 0);
+		ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6);
+		if (ImGui::InputInt(_("Frames"), &_timing_capture_frame_count))
+			_timing_capture_frame_count = std::min(std::max(_timing_capture_frame_count, 1), 1000);
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+		ImGui::Combo("##format", &_timing_capture_format, "Chrome Trace\0CSV\0");
+		ImGui::SameLine();
+		if (ImGui::Button(_timing_capture_last_frame != 0 ? _("Capturing ...") : _("Capture timings")))
+		{
+			const std::time_t t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+			struct tm tm; localtime_s(&tm, &t);
+
+			char capture_name[64];
+			ImFormatString(capture_name, sizeof(capture_name), "ReShade_Timings_%.4d-%.2d-%.2d_%.2d-%.2d-%.2d%s", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, _timing_capture_format == 1 ? ".csv" : ".json");
+
+			capture_technique_timings(static_cast<uint32_t>(_timing_capture_frame_count), (_screenshot_path / capture_name).u8string().c_str());
+		}
+		ImGui::EndDisabled();
 	}
 
 	if (ImGui::CollapsingHeader(_("Render Targets & Textures"), ImGuiTreeNodeFlags_DefaultOpen) && !is_loading())
@@ -2730,6 +2803,8 @@ void reshade::runtime::draw_gui_statistics()
 		// Variables used to calculate memory size of textures
 		lldiv_t memory_view;
 		int64_t post_processing_memory_size = 0;
+		int64_t transient_memory_size_saved = 0;
+		std::vector<api::resource> transient_resources;
 		const char *memory_size_unit;
 
 		for (const texture &tex : _textures)
@@ -2744,6 +2819,15 @@ void reshade::runtime::draw_gui_statistics()
 			for (uint32_t level = 0, width = tex.width, height = tex.height, depth = tex.depth; level < tex.levels; ++level, width /= 2, height /= 2, depth /= 2)
 				memory_size += static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(depth) * pixel_sizes[static_cast<int>(tex.format)];
 
+			// Transient textures may share their resource with others, in which case the memory is only used once
+			if (!tex.transient_technique.empty())
+			{
+				if (std::find(transient_resources.cbegin(), transient_resources.cend(), tex.resource) != transient_resources.cend())
+					transient_memory_size_saved += memory_size;
+				else
+					transient_resources.push_back(tex.resource);
+			}
+
 			post_processing_memory_size += memory_size;
 
 			if (memory_size >= 1024 * 1024)
@@ -2758,7 +2842,7 @@ void reshade::runtime::draw_gui_statistics()
 				memory_size_unit = "KiB";
 			}
 
-			ImGui::TextColored(ImVec4(1, 1, 1, 1), "%s%s", tex.unique_name.c_str(), tex.shared.size() > 1 ? " (pooled)" : "");
+			ImGui::TextColored(ImVec4(1, 1, 1, 1), "%s%s", tex.unique_name.c_str(), tex.shared.size() > 1 ? " (pooled)" : !tex.transient_technique.empty() ? " (transient)" : "");
 			switch (tex.type)
 			{
 			case reshadefx::texture_type::texture_1d:
@@ -2948,6 +3032,8 @@ void reshade::runtime::draw_gui_statistics()
 
 		ImGui::Separator();
 
+		post_processing_memory_size -= transient_memory_size_saved;
+
 		if (post_processing_memory_size >= 1024 * 1024)
 		{
 			memory_view = std::lldiv(post_processing_memory_size, 1024 * 1024);
@@ -2961,14 +3047,32 @@ void reshade::runtime::draw_gui_statistics()
 		}
 
 		ImGui::Text(_("Total memory usage: %lld.%03lld %s"), memory_view.quot, memory_view.rem, memory_size_unit);
+
+		if (transient_memory_size_saved != 0)
+		{
+			if (transient_memory_size_saved >= 1024 * 1024)
+			{
+				memory_view = std::lldiv(transient_memory_size_saved, 1024 * 1024);
+				memory_view.rem /= 1000;
+				memory_size_unit = "MiB";
+			}
+			else
+			{
+				memory_view = std::lldiv(transient_memory_size_saved, 1024);
+				memory_size_unit = "KiB";
+			}
+
+			ImGui::Text(_("Memory saved by sharing transient textures: %lld.%03lld %s"), memory_view.quot, memory_view.rem, memory_size_unit);
+		}
 	}
 #endif
 }
 void reshade::runtime::draw_gui_log()
 {
 	std::error_code ec;
+	const bool binary_log = log::is_binary();
 	std::filesystem::path log_path = global_config().path();
-	log_path.replace_extension(L".log");
+	log_path.replace_extension(binary_log ? L".rslog" : L".log");
 
 	const bool filter_changed = imgui::search_input_box(_log_filter, sizeof(_log_filter), -(16.0f * _font_size + 2 * _imgui_context->Style.ItemSpacing.x));
 
@@ -2980,7 +3084,7 @@ void reshade::runtime::draw_gui_log()
 
 	if (ImGui::Button(_("Clear Log"), ImVec2(8.0f * _font_size, 0.0f)))
 		// Close and open the stream again, which will clear the file too
-		log::open_log_file(log_path, ec);
+		log::open_log_file(log_path, ec, binary_log);
 
 	ImGui::Spacing();
 
@@ -2990,7 +3094,11 @@ void reshade::runtime::draw_gui_log()
 		constexpr size_t LINE_LIMIT = 1000;
 
 		const uintmax_t file_size = std::filesystem::file_size(log_path, ec);
-		if (filter_changed || _last_log_size != file_size)
+		if (binary_log)
+		{
+			_log_lines.assign(1, _("Log is written in binary format. Use the \"logconv\" tool to convert it to text."));
+		}
+		else if (filter_changed || _last_log_size != file_size)
 		{
 			_log_lines.clear();
 			std::ifstream log_file(log_path);
@@ -3392,7 +3500,7 @@ void reshade::runtime::draw_variable_editor()
 	}
 	else if (_was_preprocessor_popup_edited)
 	{
-		reload_effects();
+		_should_reload_affected_effects = true;
 		_was_preprocessor_popup_edited = false;
 	}
 
@@ -4259,6 +4367,7 @@ void reshade::runtime::draw_technique_editor()
 				}
 
 				if (_renderer_id < 0x20000 && // Hide if using SPIR-V, since that cannot easily be shown here
+					!effect.skipped && // Hide while shader modules are not compiled yet
 					imgui::popup_button(_("Show compiled results"), 18.0f * _font_size))
 				{
 					const bool open_generated_code = ImGui::MenuItem(_("Generated code"));
@@ -4420,8 +4529,10 @@ void reshade::runtime::open_code_editor(editor_instance &instance) const
 	{
 		if (instance.entry_point_name.empty())
 			instance.editor.set_text(std::string_view(effect.module.code.data(), effect.module.code.size()));
+		else if (const auto assembly_it = effect.assembly_text.find(instance.entry_point_name); assembly_it != effect.assembly_text.end())
+			instance.editor.set_text(assembly_it->second);
 		else
-			instance.editor.set_text(effect.assembly_text.at(instance.entry_point_name));
+			instance.editor.clear_text();
 		instance.editor.set_readonly(true);
 		return; // Errors only apply to the effect source, not generated code
 	}
@@ -28,6 +28,7 @@ namespace reshade
 		overlay_active,
 		overlay_hovered,
 		screenshot,
+		render_scale,
 		unknown
 	};
 
@@ -73,6 +74,7 @@ namespace reshade
 
 		std::vector<size_t> shared;
 		bool loaded = false;
+		std::string transient_technique; // Texture is only used as an intermediate render target in this technique, so its resource may be shared with textures of other techniques
 
 		api::resource resource = {};
 		api::resource_view srv[2] = {};
@@ -129,6 +131,30 @@ namespace reshade
 		special_uniform special = special_uniform::none;
 	};
 
+	/// <summary>
+	/// List of uniform variables with a 'source' annotation that are updated every frame, with all their annotation parameters resolved.
+	/// </summary>
+	struct special_uniform_updates
+	{
+		enum class key_mode : uint8_t
+		{
+			down,
+			press,
+			toggle
+		};
+
+		size_t size() const { return uniform_index.size(); }
+
+		std::vector<uint32_t> uniform_index; // Index into 'effect::uniforms'
+		std::vector<special_uniform> type;
+		std::vector<int> keycode; // 'key' and 'mouse_button'
+		std::vector<key_mode> mode; // 'key' and 'mouse_button'
+		std::vector<int> int_min, int_max; // 'random'
+		std::vector<float> min, max; // 'ping_pong' and 'mouse_wheel'
+		std::vector<float> step_min, step_max; // 'ping_pong' and 'mouse_wheel' (only uses 'step_min')
+		std::vector<float> smoothing; // 'ping_pong'
+	};
+
 	struct technique final : reshadefx::technique_info
 	{
 		technique(const reshadefx::technique_info &init) : technique_info(init) {}
@@ -169,6 +195,7 @@ namespace reshade
 		bool enabled = false;
 		bool enabled_in_screenshot = true;
 		int64_t time_left = 0;
+		uint64_t governor_skipped_frame = 0; // Frame at which the performance governor started skipping this technique, or zero if it is rendered normally
 
 		struct pass_data
 		{
@@ -177,13 +204,29 @@ namespace reshade
 			api::descriptor_table texture_table = {};
 			api::descriptor_table storage_table = {};
 			std::vector<api::resource> modified_resources;
-			std::vector<api::resource_view> generate_mipmap_views;
+			std::vector<api::resource> sampled_resources;
+			std::vector<std::pair<api::resource, api::resource_view>> generate_mipmap_views;
+			moving_average<uint64_t, 60> average_cpu_duration;
+			moving_average<uint64_t, 60> average_gpu_duration; // Draw or dispatch
+			moving_average<uint64_t, 60> average_gpu_transition_duration; // Copies, barriers and mipmap generation before the pass
 		};
 
+		// Each technique uses a timestamp query at its start and end, plus two per pass (after the transitions before the pass and after the pass itself)
+		uint32_t query_count() const { return static_cast<uint32_t>(2 + passes.size() * 2); }
+
 		std::vector<pass_data> passes_data;
 		uint32_t query_base_index = 0;
 		moving_average<uint64_t, 60> average_cpu_duration;
 		moving_average<uint64_t, 60> average_gpu_duration;
+		moving_average<uint64_t, 60> average_gpu_transition_duration; // Copies, barriers and mipmap generation after the last pass
+	};
+
+	struct effect_assembly
+	{
+		bool compiled = true;
+		std::string errors;
+		std::unordered_map<std::string, std::string> assembly;
+		std::unordered_map<std::string, std::string> assembly_text;
 	};
 
 	struct effect
@@ -199,17 +242,54 @@ namespace reshade
 		std::filesystem::path source_file;
 		std::vector<std::filesystem::path> included_files;
 		std::vector<std::pair<std::string, std::string>> definitions;
+		std::vector<std::pair<std::string, std::string>> preprocessor_definitions; // External definitions the effect was loaded with
+		std::vector<std::string> referenced_macros; // Macro names that can influence the preprocessor output
+		bool referenced_macros_known = false;
 		std::unordered_map<std::string, std::string> assembly;
 		std::unordered_map<std::string, std::string> assembly_text;
+		std::string code_preamble; // Kept for effects with deferred shader compilation
+		bool skip_optimization = false;
+		size_t spec_constant_hash = 0; // Hash of the preset values that were used for the specialization constants in performance mode
 
 		std::vector<uniform> uniforms;
 		std::vector<uint8_t> uniform_data_storage;
+		special_uniform_updates special_uniforms;
+		float render_scale = 1.0f; // Set by the performance governor and passed to uniform variables with the 'render_scale' source
+		uint32_t uniform_data_version = 1; // Incremented whenever the contents of 'uniform_data_storage' change
+		uint32_t uniform_data_dirty_begin = 0; // Byte range of 'uniform_data_storage' that changed since it was last pushed as constants (D3D9)
+		uint32_t uniform_data_dirty_end = 0;
+
+		// Copies of 'uniform_data_storage' at the start of a preset transition and with all values of the target preset applied, which are blended over the byte ranges that differ
+		std::vector<uint8_t> preset_transition_start_data;
+		std::vector<uint8_t> preset_transition_target_data;
+		std::vector<std::pair<uint32_t, uint32_t>> preset_transition_ranges;
+
+		void mark_uniform_data_modified(uint32_t offset, uint32_t size)
+		{
+			uniform_data_version++;
+
+			if (uniform_data_dirty_begin >= uniform_data_dirty_end)
+			{
+				uniform_data_dirty_begin = offset;
+				uniform_data_dirty_end = offset + size;
+			}
+			else
+			{
+				uniform_data_dirty_begin = std::min(uniform_data_dirty_begin, offset);
+				uniform_data_dirty_end = std::max(uniform_data_dirty_end, offset + size);
+			}
+		}
 
 		api::query_heap query_heap = {};
 		api::resource cb = {};
 		api::pipeline_layout layout = {};
 
-		api::descriptor_table cb_table = {};
+		// The constant buffer is split into one slice per frame in flight when it can stay mapped persistently (D3D12 and Vulkan), so that it can be updated without waiting for the GPU
+		uint8_t *cb_mapped_data = nullptr;
+		uint32_t cb_slice_size = 0;
+		uint32_t cb_slice_versions[4] = {}; // Value of 'uniform_data_version' that was last uploaded to each slice
+
+		api::descriptor_table cb_table[4] = {};
 		api::descriptor_table sampler_table = {};
 
 		struct binding_data
@@ -222,5 +302,20 @@ namespace reshade
 		};
 		std::vector<binding_data> texture_semantic_to_binding;
 	};
+
+	struct transient_resource
+	{
+		api::resource_desc desc;
+		api::resource resource = {};
+		std::vector<std::pair<size_t, std::string>> techniques; // Techniques (effect index and name) the textures sharing this resource are used in
+	};
+
+	struct effect_permutation
+	{
+		std::filesystem::path source_file;
+		size_t hash = 0;
+		std::unordered_map<std::string, std::string> assembly;
+		std::unordered_map<std::string, std::string> assembly_text;
+	};
 #endif
 }
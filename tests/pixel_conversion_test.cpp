@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2014 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "pixel_conversion.hpp"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <random>
+
+using namespace reshade;
+
+// Formats the row conversion functions support, each of which has a scalar reference implementation
+static const api::format s_convert_formats[] = {
+	api::format::r8_unorm,
+	api::format::r8g8_unorm,
+	api::format::r8g8b8a8_unorm,
+	api::format::r8g8b8x8_unorm,
+	api::format::b8g8r8a8_unorm,
+	api::format::b8g8r8x8_unorm,
+	api::format::r10g10b10a2_unorm,
+	api::format::b10g10r10a2_unorm,
+	api::format::r16g16b16a16_unorm,
+	api::format::r16g16b16a16_float,
+};
+
+// Half-precision values that need special handling: zero, negative zero, one, negative one, largest finite value, smallest and largest denormals (positive and negative), infinity, negative infinity, quiet and signaling NaN (positive and negative)
+static const uint16_t s_special_halfs[] = {
+	0x0000, 0x8000, 0x3C00, 0xBC00, 0x7BFF, 0xFBFF,
+	0x0001, 0x03FF, 0x8001, 0x83FF,
+	0x7C00, 0xFC00,
+	0x7E00, 0x7C01, 0xFE00, 0xFC01,
+};
+
+// Rows are padded with guard bytes, so that writes past the end of a row are detected
+constexpr size_t guard_size = 64;
+constexpr uint8_t guard_value = 0xCD;
+
+static unsigned int s_num_failures = 0;
+
+static void report_failure(const char *test, api::format format, size_t width, const char *message)
+{
+	std::printf("FAILED: %s (format %u, width %zu): %s\n", test, static_cast<unsigned int>(format), width, message);
+	s_num_failures++;
+}
+
+static bool check_guard(const uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < guard_size; ++i)
+		if (data[size + i] != guard_value)
+			return false;
+	return true;
+}
+
+static size_t bytes_per_pixel(api::format format)
+{
+	// Cannot use 'api::format_row_pitch', since it does not know about all the formats listed above (e.g. 'b10g10r10a2_unorm')
+	switch (format)
+	{
+	case api::format::r8_unorm:
+		return 1;
+	case api::format::r8g8_unorm:
+		return 2;
+	case api::format::r16g16b16a16_unorm:
+	case api::format::r16g16b16a16_float:
+		return 8;
+	default:
+		return 4;
+	}
+}
+
+static std::vector<std::vector<uint8_t>> generate_rows(api::format format, size_t width, std::mt19937 &rng)
+{
+	const size_t row_size = width * bytes_per_pixel(format);
+
+	std::vector<std::vector<uint8_t>> rows;
+
+	// Random bits cover all bit patterns of integer formats (and random exponents of floating-point formats)
+	for (int i = 0; i < 4; ++i)
+	{
+		std::vector<uint8_t> &row = rows.emplace_back(row_size);
+		for (uint8_t &value : row)
+			value = static_cast<uint8_t>(rng());
+	}
+
+	// Extreme values
+	rows.emplace_back(row_size, static_cast<uint8_t>(0x00));
+	rows.emplace_back(row_size, static_cast<uint8_t>(0xFF));
+
+	if (format == api::format::r16g16b16a16_float)
+	{
+		// Rotate special values through all channels and pixel positions, so that each of them hits every SIMD lane
+		const size_t num_channels = width * 4;
+		const size_t num_special = sizeof(s_special_halfs) / sizeof(*s_special_halfs);
+		for (size_t offset = 0; offset < num_special; ++offset)
+		{
+			std::vector<uint8_t> &row = rows.emplace_back(row_size);
+			for (size_t c = 0; c < num_channels; ++c)
+				std::memcpy(row.data() + c * 2, &s_special_halfs[(c + offset) % num_special], 2);
+		}
+
+		// Random finite values in a range around [0, 1], including negative values and values above one
+		std::uniform_int_distribution<int> exponent_dist(0, 16);
+		std::vector<uint8_t> &row = rows.emplace_back(row_size);
+		for (size_t c = 0; c < num_channels; ++c)
+		{
+			const uint16_t value = static_cast<uint16_t>((rng() & 0x8000) | (exponent_dist(rng) << 10) | (rng() & 0x3FF));
+			std::memcpy(row.data() + c * 2, &value, 2);
+		}
+	}
+
+	return rows;
+}
+
+static void test_convert_row_to_rgba8(api::format format, size_t width, const std::vector<uint8_t> &src)
+{
+	const utils::convert_row_func convert_scalar = utils::find_convert_row_to_rgba8(format, false);
+	const utils::convert_row_func convert_simd = utils::find_convert_row_to_rgba8(format, true);
+	if (convert_scalar == nullptr || convert_simd == nullptr)
+		return report_failure("convert_row_to_rgba8", format, width, "format is not supported");
+
+	std::vector<uint8_t> dst_scalar(width * 4 + guard_size, guard_value);
+	std::vector<uint8_t> dst_simd(width * 4 + guard_size, guard_value);
+
+	convert_scalar(src.data(), dst_scalar.data(), width);
+	convert_simd(src.data(), dst_simd.data(), width);
+
+	if (!check_guard(dst_simd.data(), width * 4) || !check_guard(dst_scalar.data(), width * 4))
+		return report_failure("convert_row_to_rgba8", format, width, "wrote past the end of the row");
+	if (std::memcmp(dst_scalar.data(), dst_simd.data(), width * 4) != 0)
+		return report_failure("convert_row_to_rgba8", format, width, "SIMD output differs from scalar output");
+}
+
+static void test_convert_row_to_rgba32f(api::format format, size_t width, const std::vector<uint8_t> &src)
+{
+	const utils::convert_row_float_func convert_scalar = utils::find_convert_row_to_rgba32f(format, false);
+	const utils::convert_row_float_func convert_simd = utils::find_convert_row_to_rgba32f(format, true);
+	if (convert_scalar == nullptr || convert_simd == nullptr)
+		return report_failure("convert_row_to_rgba32f", format, width, "format is not supported");
+
+	// Compare bit patterns rather than values, so that NaN is compared too and the sign of zero matters
+	std::vector<float> dst_scalar(width * 4 + guard_size / sizeof(float));
+	std::vector<float> dst_simd(width * 4 + guard_size / sizeof(float));
+	std::memset(dst_scalar.data(), guard_value, dst_scalar.size() * sizeof(float));
+	std::memset(dst_simd.data(), guard_value, dst_simd.size() * sizeof(float));
+
+	convert_scalar(src.data(), dst_scalar.data(), width);
+	convert_simd(src.data(), dst_simd.data(), width);
+
+	if (!check_guard(reinterpret_cast<const uint8_t *>(dst_simd.data()), width * 4 * sizeof(float)) || !check_guard(reinterpret_cast<const uint8_t *>(dst_scalar.data()), width * 4 * sizeof(float)))
+		return report_failure("convert_row_to_rgba32f", format, width, "wrote past the end of the row");
+	if (std::memcmp(dst_scalar.data(), dst_simd.data(), width * 4 * sizeof(float)) != 0)
+		return report_failure("convert_row_to_rgba32f", format, width, "SIMD output differs from scalar output");
+}
+
+static void test_pack_row_to_rgb8(api::format format, size_t width, const std::vector<uint8_t> &src)
+{
+	const utils::convert_row_func pack_scalar = utils::find_pack_row_to_rgb8(format, false);
+	const utils::convert_row_func pack_simd = utils::find_pack_row_to_rgb8(format, true);
+	if (pack_scalar == nullptr || pack_simd == nullptr)
+		return report_failure("pack_row_to_rgb8", format, width, "format is not supported");
+
+	std::vector<uint8_t> dst_scalar(width * 3 + guard_size, guard_value);
+	std::vector<uint8_t> dst_simd(width * 3 + guard_size, guard_value);
+
+	pack_scalar(src.data(), dst_scalar.data(), width);
+	pack_simd(src.data(), dst_simd.data(), width);
+
+	// Check the scalar implementation against the definition too, since the other packing tests only compare against it
+	const bool swap_rb = format == api::format::b8g8r8a8_unorm || format == api::format::b8g8r8x8_unorm;
+	for (size_t x = 0; x < width; ++x)
+	{
+		if (dst_scalar[x * 3 + 0] != src[x * 4 + (swap_rb ? 2 : 0)] ||
+			dst_scalar[x * 3 + 1] != src[x * 4 + 1] ||
+			dst_scalar[x * 3 + 2] != src[x * 4 + (swap_rb ? 0 : 2)])
+			return report_failure("pack_row_to_rgb8", format, width, "scalar output does not match source pixels");
+	}
+
+	if (!check_guard(dst_simd.data(), width * 3) || !check_guard(dst_scalar.data(), width * 3))
+		return report_failure("pack_row_to_rgb8", format, width, "wrote past the end of the row");
+	if (std::memcmp(dst_scalar.data(), dst_simd.data(), width * 3) != 0)
+		return report_failure("pack_row_to_rgb8", format, width, "SIMD output differs from scalar output");
+
+	// Packing in place has to give the same result, since stores must never overwrite source pixels that were not read yet
+	for (const utils::convert_row_func pack : { pack_scalar, pack_simd })
+	{
+		std::vector<uint8_t> pixels(src);
+		pack(pixels.data(), pixels.data(), width);
+
+		if (std::memcmp(dst_scalar.data(), pixels.data(), width * 3) != 0)
+			return report_failure("pack_row_to_rgb8", format, width, pack == pack_simd ? "SIMD output differs from scalar output when packing in place" : "scalar output differs when packing in place");
+	}
+}
+
+static void test_pack_rgba8_to_rgb8(size_t width, size_t height, std::mt19937 &rng)
+{
+	std::vector<uint8_t> pixels(width * height * 4);
+	for (uint8_t &value : pixels)
+		value = static_cast<uint8_t>(rng());
+
+	// Rows are tightly packed, so the whole image can be packed as a single row for reference
+	std::vector<uint8_t> reference(width * height * 3);
+	utils::find_pack_row_to_rgb8(api::format::r8g8b8a8_unorm, false)(pixels.data(), reference.data(), width * height);
+
+	utils::pack_rgba8_to_rgb8(pixels.data(), width, height);
+
+	if (std::memcmp(reference.data(), pixels.data(), reference.size()) != 0)
+	{
+		std::printf("FAILED: pack_rgba8_to_rgb8 (%zux%zu): output differs from scalar output\n", width, height);
+		s_num_failures++;
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(42);
+
+	// Cover every width up to more than two full SIMD iterations of the widest kernel, so that all possible remainders are processed by the scalar tail
+	for (const api::format format : s_convert_formats)
+	{
+		for (size_t width = 1; width <= 17; ++width)
+		{
+			// Source rows are allocated with exactly their size, so that reads past their end are caught by address sanitizers
+			for (const std::vector<uint8_t> &src : generate_rows(format, width, rng))
+			{
+				test_convert_row_to_rgba8(format, width, src);
+				test_convert_row_to_rgba32f(format, width, src);
+			}
+		}
+	}
+
+	for (const api::format format : { api::format::r8g8b8a8_unorm, api::format::r8g8b8x8_unorm, api::format::b8g8r8a8_unorm, api::format::b8g8r8x8_unorm })
+	{
+		// SIMD packing processes four pixels per iteration, but only while at least six are left (to not store past the end of the row), so short rows are handled by the scalar tail entirely
+		for (size_t width = 1; width <= 17; ++width)
+		{
+			for (const std::vector<uint8_t> &src : generate_rows(format, width, rng))
+				test_pack_row_to_rgb8(format, width, src);
+		}
+	}
+
+	// Images are split across threads once they have at least 2M pixels (one split per 1M pixels, limited by the number of hardware threads), smaller ones are packed on the calling thread only
+	test_pack_rgba8_to_rgb8(1, 1, rng);
+	test_pack_rgba8_to_rgb8(7, 5, rng);
+	test_pack_rgba8_to_rgb8(1920, 1080, rng); // Just too few pixels to be split
+	test_pack_rgba8_to_rgb8(2049, 1025, rng); // Just enough pixels for two splits
+	test_pack_rgba8_to_rgb8(3001, 1999, rng);
+	test_pack_rgba8_to_rgb8(7680, 4320, rng);
+
+	if (s_num_failures != 0)
+	{
+		std::printf("%u test(s) failed\n", s_num_failures);
+		return 1;
+	}
+
+	std::printf("All tests passed\n");
+	return 0;
+}
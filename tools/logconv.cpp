@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2014 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "dll_log_format.hpp"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+
+using namespace reshade::log::binary_format;
+
+struct record_reader
+{
+	const char *p;
+	const char *end;
+
+	template <typename T>
+	bool read(T &value)
+	{
+		if (static_cast<size_t>(end - p) < sizeof(value))
+			return false;
+		std::memcpy(&value, p, sizeof(value));
+		p += sizeof(value);
+		return true;
+	}
+
+	bool read(std::string &value, uint32_t length)
+	{
+		if (static_cast<size_t>(end - p) < length)
+			return false;
+		value.assign(p, length);
+		p += length;
+		return true;
+	}
+};
+
+static void append_padded(std::string &line, const std::string &value, uint8_t width)
+{
+	line += value;
+	// Messages are formatted left-aligned, so pad on the right
+	if (value.size() < width)
+		line.append(width - value.size(), ' ');
+}
+
+static std::string format_integer(uint8_t flags, uint64_t value)
+{
+	const unsigned int size = flags & integer_size_mask;
+	if (size != 0 && size < 8)
+	{
+		// Restore the original value, which was extended to 64-bit
+		const uint64_t mask = (1ull << (size * 8)) - 1;
+		if ((flags & integer_signed) && !(flags & integer_hex))
+			value = static_cast<uint64_t>(static_cast<int64_t>(value << (64 - size * 8)) >> (64 - size * 8));
+		else
+			value &= mask;
+	}
+
+	char buffer[32];
+	if (flags & integer_hex)
+		// Zero is printed without a base prefix, same as with standard streams
+		std::snprintf(buffer, sizeof(buffer), (flags & integer_showbase) && value != 0 ? "0x%llx" : "%llx", static_cast<unsigned long long>(value));
+	else if (flags & integer_signed)
+		std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+	else
+		std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(value));
+	return buffer;
+}
+
+static std::string format_float(double value)
+{
+	char buffer[64];
+	std::snprintf(buffer, sizeof(buffer), "%g", value);
+	return buffer;
+}
+
+static void format_timestamp(uint64_t timestamp, char (&buffer)[48])
+{
+	// Convert from 100-nanosecond intervals since January 1, 1601 to a civil date (see https://howardhinnant.github.io/date_algorithms.html)
+	const uint64_t milliseconds_total = timestamp / 10000;
+	const unsigned int milliseconds = static_cast<unsigned int>(milliseconds_total % 1000);
+	const uint64_t seconds_total = milliseconds_total / 1000;
+	const unsigned int seconds = static_cast<unsigned int>(seconds_total % 60);
+	const unsigned int minutes = static_cast<unsigned int>((seconds_total / 60) % 60);
+	const unsigned int hours = static_cast<unsigned int>((seconds_total / 3600) % 24);
+
+	const int64_t days = static_cast<int64_t>(seconds_total / 86400) - 134774 + 719468; // Days since 1601-01-01, shifted to days since 0000-03-01
+	const int64_t era = days / 146097;
+	const unsigned int day_of_era = static_cast<unsigned int>(days - era * 146097);
+	const unsigned int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+	const unsigned int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+	const unsigned int month_index = (5 * day_of_year + 2) / 153;
+	const unsigned int day = day_of_year - (153 * month_index + 2) / 5 + 1;
+	const unsigned int month = month_index < 10 ? month_index + 3 : month_index - 9;
+	const long long year = static_cast<long long>(year_of_era) + era * 400 + (month <= 2);
+
+	std::snprintf(buffer, sizeof(buffer), "%04lld-%02u-%02uT%02u:%02u:%02u:%03u", year, month, day, hours, minutes, seconds, milliseconds);
+}
+
+static std::string escape_json(const std::string &value)
+{
+	std::string result;
+	result.reserve(value.size());
+	for (const char c : value)
+	{
+		switch (c)
+		{
+		case '\"':
+			result += "\\\"";
+			break;
+		case '\\':
+			result += "\\\\";
+			break;
+		case '\n':
+			result += "\\n";
+			break;
+		case '\r':
+			result += "\\r";
+			break;
+		case '\t':
+			result += "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+			{
+				char buffer[8];
+				std::snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned int>(c));
+				result += buffer;
+			}
+			else
+			{
+				result += c;
+			}
+			break;
+		}
+	}
+	return result;
+}
+
+int main(int argc, char *argv[])
+{
+	bool json = false;
+	const char *input_path = nullptr;
+	const char *output_path = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--json") == 0)
+			json = true;
+		else if (input_path == nullptr)
+			input_path = argv[i];
+		else if (output_path == nullptr)
+			output_path = argv[i];
+	}
+
+	if (input_path == nullptr)
+	{
+		std::printf("usage: logconv [--json] <input file> [<output file>]\n\n  Converts a binary ReShade log file to text (or JSON lines with \"--json\").\n  Output is written to the console if no output file is specified.\n");
+		return 0;
+	}
+
+	std::ifstream input(input_path, std::ios::binary);
+	if (!input)
+	{
+		std::printf("error: could not open input file \"%s\"\n", input_path);
+		return 1;
+	}
+
+	const std::vector<char> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+	uint32_t file_header[2] = {};
+	if (data.size() < sizeof(file_header) || (std::memcpy(file_header, data.data(), sizeof(file_header)), file_header[0] != magic))
+	{
+		std::printf("error: \"%s\" is not a binary ReShade log file\n", input_path);
+		return 1;
+	}
+	if (file_header[1] != version)
+	{
+		std::printf("error: unsupported binary log version %u\n", file_header[1]);
+		return 1;
+	}
+
+	FILE *output = stdout;
+	if (output_path != nullptr)
+	{
+		output = std::fopen(output_path, "wb");
+		if (output == nullptr)
+		{
+			std::printf("error: could not open output file \"%s\"\n", output_path);
+			return 1;
+		}
+	}
+
+	// Collect all string definitions first, since messages from different threads may refer to strings that are only defined in a later record
+	std::unordered_map<uint32_t, std::string> strings;
+	std::vector<std::pair<message_header, record_reader>> messages;
+
+	bool truncated = false;
+	for (record_reader reader = { data.data() + sizeof(file_header), data.data() + data.size() }; reader.p != reader.end;)
+	{
+		message_header header;
+		if (!reader.read(header) || static_cast<size_t>(reader.end - reader.p) < header.size)
+		{
+			truncated = true;
+			break;
+		}
+
+		record_reader arguments = { reader.p, reader.p + header.size };
+		reader.p += header.size;
+
+		messages.emplace_back(header, arguments);
+
+		for (argument_type type; arguments.read(type);)
+		{
+			uint8_t width = 0;
+			uint32_t id = 0, length = 0;
+			uint8_t flags = 0;
+			uint64_t value = 0;
+			std::string text;
+
+			if (!arguments.read(width))
+				break;
+
+			if (type == argument_type::string_definition)
+			{
+				if (!arguments.read(id) || !arguments.read(length) || !arguments.read(text, length))
+					break;
+				strings[id] = std::move(text);
+			}
+			else if (type == argument_type::string_reference)
+			{
+				if (!arguments.read(id))
+					break;
+			}
+			else if (type == argument_type::string)
+			{
+				if (!arguments.read(length) || !arguments.read(text, length))
+					break;
+			}
+			else if (type == argument_type::integer)
+			{
+				if (!arguments.read(flags) || !arguments.read(value))
+					break;
+			}
+			else if (type == argument_type::floating_point)
+			{
+				if (!arguments.read(value))
+					break;
+			}
+			else
+			{
+				break;
+			}
+		}
+	}
+
+	static constexpr char level_names[][6] = { "ERROR", "WARN ", "INFO ", "DEBUG" };
+
+	std::string line;
+	for (auto &[header, arguments] : messages)
+	{
+		line.clear();
+
+		for (argument_type type; arguments.read(type);)
+		{
+			uint8_t width = 0;
+			arguments.read(width);
+
+			uint32_t id = 0, length = 0;
+			std::string text;
+
+			switch (type)
+			{
+			case argument_type::string_definition:
+				arguments.read(id);
+				arguments.read(length);
+				arguments.read(text, length);
+				append_padded(line, text, width);
+				break;
+			case argument_type::string_reference:
+				arguments.read(id);
+				if (const auto it = strings.find(id); it != strings.end())
+					append_padded(line, it->second, width);
+				else
+					append_padded(line, "<unknown string " + std::to_string(id) + '>', width);
+				break;
+			case argument_type::string:
+				arguments.read(length);
+				arguments.read(text, length);
+				append_padded(line, text, width);
+				break;
+			case argument_type::integer:
+			{
+				uint8_t flags = 0;
+				uint64_t value = 0;
+				arguments.read(flags);
+				arguments.read(value);
+				append_padded(line, format_integer(flags, value), width);
+				break;
+			}
+			case argument_type::floating_point:
+			{
+				double value = 0;
+				arguments.read(value);
+				append_padded(line, format_float(value), width);
+				break;
+			}
+			default:
+				arguments.p = arguments.end;
+				break;
+			}
+		}
+
+		char timestamp[48];
+		format_timestamp(header.timestamp, timestamp);
+		const char *const level_name = level_names[(header.level >= 1 && header.level <= 4 ? header.level : 4) - 1];
+
+		if (json)
+		{
+			std::string level(level_name);
+			level.erase(level.find_last_not_of(' ') + 1);
+
+			std::fprintf(output, "{\"time\":\"%s\",\"thread\":%u,\"level\":\"%s\",\"message\":\"%s\"}\n", timestamp, header.thread_id, level.c_str(), escape_json(line).c_str());
+		}
+		else
+		{
+			// Same layout as text log files
+			std::fprintf(output, "%s [%05u] | %s | %s\n", timestamp, header.thread_id, level_name, line.c_str());
+		}
+	}
+
+	if (output != stdout)
+		std::fclose(output);
+
+	if (truncated)
+	{
+		std::printf("warning: log file ends with an incomplete record\n");
+		return 2;
+	}
+
+	return 0;
+}